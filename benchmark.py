@@ -0,0 +1,233 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+
+# Scaling benchmark of the LoRaWAN and Wi-Fi ad hoc scenarios.
+#
+# Runs every configuration with fixed seeds through waf, collects the JSON
+# profile that the scenarios write with --profile and stores setup time,
+# events per second, wall time per simulated hour and peak RSS in a stable
+# JSON file. With --compare the results are checked against a baseline file
+# and the script exits with status 1 if some metric got worse than the
+# tolerance allows.
+#
+# With --schedulers every LoRaWAN configuration is run once per event
+# scheduler and a table compares their events per second.
+#
+# The scenarios are expected in the scratch directory of ns-3:
+#   scratch/loraSimulation/             -> program loraSimulation
+#   scratch/wifi-adhoc-multiple-nodes.cc -> program wifi-adhoc-multiple-nodes
+
+import argparse
+import glob
+import json
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+import time
+
+FORMAT_VERSION = 1
+
+# name, program, fixed arguments, size argument, sizes
+#
+# The fixed arguments also turn off every trace, capture and log file the
+# scenarios can write, so the runs measure the simulation alone
+SUITES = [
+    ("lorawan", "loraSimulation",
+     {"distribution": "exponential", "simulationTime": 3600, "radius": 6400,
+      "print": "false", "verbose": "false", "binaryLog": 0},
+     "nDevices", [100, 1000, 10000, 100000]),
+    # The lite end devices have no node to put in a building
+    ("lorawan-lite", "loraSimulation",
+     {"distribution": "exponential", "simulationTime": 3600, "radius": 6400,
+      "liteEndDevices": "true", "realisticChannelModel": "false",
+      "print": "false", "verbose": "false", "binaryLog": 0},
+     "nDevices", [1000, 100000, 1000000]),
+    ("wifi-adhoc", "wifi-adhoc-multiple-nodes",
+     {"traffic": "calls", "stopTime": 60, "radius": 100,
+      "fullTrace": "false", "flightRecorder": "false", "flowStats": "", "flowMonitorXml": "false"},
+     "nodes", [20, 200, 2000]),
+]
+
+# Suites whose program selects its event scheduler with --scheduler
+SCHEDULER_SUITES = ["lorawan", "lorawan-lite"]
+
+# metric -> True if higher is better
+METRICS = {
+    "setup_wall_s": False,
+    "events_per_s": True,
+    "wall_s_per_sim_hour": False,
+    "peak_rss_kb": False,
+}
+
+parser = argparse.ArgumentParser(description='Scaling benchmark of the LoRaWAN and Wi-Fi scenarios')
+parser.add_argument('--ns3-dir',
+                    type=str,
+                    default='.',
+                    help='Root of the ns-3 tree where waf is run, Default: .')
+parser.add_argument('--suite',
+                    type=str,
+                    default='all',
+                    choices=['all'] + [s[0] for s in SUITES],
+                    help='Scenario to benchmark, Default: all')
+parser.add_argument('--max-size',
+                    type=int,
+                    default=0,
+                    help='Skip the configurations larger than this, 0 runs all, Default: 0')
+parser.add_argument('--repeat',
+                    type=int,
+                    default=1,
+                    help='Runs of each configuration, the best one is kept, Default: 1')
+parser.add_argument('--seed',
+                    type=int,
+                    default=1,
+                    help='RngSeed and RngRun of every run, Default: 1')
+parser.add_argument('--output',
+                    type=str,
+                    default='benchmark-results.json',
+                    help='File where the results are written, Default: benchmark-results.json')
+parser.add_argument('--schedulers',
+                    type=str,
+                    default='',
+                    help='Comma separated schedulers to compare on the LoRaWAN configurations '
+                         '(map, list, heap, calendar, priority, ladder), Default: the default one')
+parser.add_argument('--compare',
+                    type=str,
+                    default='',
+                    help='Baseline results to compare against, Default: none')
+parser.add_argument('--tolerance',
+                    type=float,
+                    default=0.10,
+                    help='Allowed relative regression of each metric, Default: 0.10')
+args = parser.parse_args()
+
+
+def run_configuration(program, arguments, seed):
+    """Run one configuration and return the metrics of its profile"""
+    workdir = tempfile.mkdtemp(prefix='benchmark-')
+    prefix = os.path.join(workdir, 'profile')
+    cmdArgs = ["--RngSeed=%d" % seed, "--RngRun=%d" % seed, "--profile=%s" % prefix]
+    cmdArgs += ["--%s=%s" % (k, v) for k, v in sorted(arguments.items())]
+    command = ["./waf", "--run", "%s %s" % (program, " ".join(cmdArgs))]
+
+    # No log component may be enabled from the environment either
+    environment = dict(os.environ)
+    environment.pop("NS_LOG", None)
+
+    start = time.time()
+    result = subprocess.run(command, cwd=args.ns3_dir, env=environment, stdout=subprocess.DEVNULL,
+                            stderr=subprocess.PIPE, universal_newlines=True)
+    elapsed = time.time() - start
+    try:
+        if result.returncode != 0:
+            print(result.stderr, file=sys.stderr)
+            raise RuntimeError("%s failed with status %d" % (program, result.returncode))
+        profiles = sorted(glob.glob(prefix + "-*.json"))
+        if len(profiles) != 1:
+            raise RuntimeError("%s wrote %d profiles, expected 1" % (program, len(profiles)))
+        with open(profiles[0]) as f:
+            profile = json.load(f)
+    finally:
+        shutil.rmtree(workdir, ignore_errors=True)
+
+    simulated = profile["simulated_s"]
+    return {
+        "setup_wall_s": profile["setup_wall_s"],
+        "events_per_s": profile["events_per_s"],
+        "wall_s_per_sim_hour": profile["run_wall_s"] * 3600.0 / simulated if simulated > 0 else 0.0,
+        "peak_rss_kb": profile["peak_rss_kb"],
+        "events": profile["events"],
+        "simulated_s": simulated,
+        "process_wall_s": elapsed,
+    }
+
+
+def best_of(runs):
+    """Keep the best value of every metric over the repetitions"""
+    best = dict(runs[0])
+    for run in runs[1:]:
+        for metric, higherIsBetter in METRICS.items():
+            pick = max if higherIsBetter else min
+            best[metric] = pick(best[metric], run[metric])
+    return best
+
+
+def compare(results, baseline, tolerance):
+    """Print the relative change of every metric and return the regressions"""
+    regressions = []
+    for key in sorted(results["configurations"]):
+        if key not in baseline["configurations"]:
+            print("%-32s not in the baseline" % key)
+            continue
+        current = results["configurations"][key]
+        reference = baseline["configurations"][key]
+        for metric, higherIsBetter in sorted(METRICS.items()):
+            old = reference["metrics"][metric]
+            new = current["metrics"][metric]
+            if old == 0:
+                continue
+            change = (new - old) / old
+            worse = -change if higherIsBetter else change
+            flag = ""
+            if worse > tolerance:
+                flag = "  REGRESSION"
+                regressions.append((key, metric, change))
+            print("%-32s %-20s %14.4g -> %14.4g  %+7.1f%%%s" % (key, metric, old, new, 100 * change, flag))
+    return regressions
+
+
+def report_schedulers(results, schedulers):
+    """Print the events per second of every scheduler, and relative to the first one"""
+    print("%-32s" % "events/s" + "".join("%20s" % scheduler for scheduler in schedulers))
+    rows = sorted(set(key.rsplit("/scheduler=", 1)[0] for key in results["configurations"]
+                      if "/scheduler=" in key))
+    for row in rows:
+        rates = [results["configurations"]["%s/scheduler=%s" % (row, scheduler)]["metrics"]["events_per_s"]
+                 for scheduler in schedulers]
+        cells = ["%12.4g (%4.2fx)" % (rate, rate / rates[0] if rates[0] > 0 else 0) for rate in rates]
+        print("%-32s" % row + "".join("%20s" % cell for cell in cells))
+
+
+schedulers = [s for s in args.schedulers.split(",") if s]
+results = {"format_version": FORMAT_VERSION, "seed": args.seed, "configurations": {}}
+for name, program, fixedArgs, sizeArg, sizes in SUITES:
+    if args.suite not in ("all", name):
+        continue
+    for size in sizes:
+        if args.max_size and size > args.max_size:
+            continue
+        for scheduler in (schedulers if name in SCHEDULER_SUITES else []) or [None]:
+            arguments = dict(fixedArgs)
+            arguments[sizeArg] = size
+            key = "%s/%s=%d" % (name, sizeArg, size)
+            if scheduler:
+                arguments["scheduler"] = scheduler
+                key += "/scheduler=%s" % scheduler
+            print("Running %s" % key)
+            runs = [run_configuration(program, arguments, args.seed) for i in range(args.repeat)]
+            results["configurations"][key] = {
+                "scenario": name,
+                "arguments": {k: str(v) for k, v in arguments.items()},
+                "metrics": best_of(runs),
+            }
+
+with open(args.output, "w") as f:
+    json.dump(results, f, indent=2, sort_keys=True)
+    f.write("\n")
+print("Results written to %s" % args.output)
+
+if schedulers and any("/scheduler=" in key for key in results["configurations"]):
+    report_schedulers(results, schedulers)
+
+if args.compare:
+    with open(args.compare) as f:
+        baseline = json.load(f)
+    if baseline.get("format_version") != FORMAT_VERSION:
+        sys.exit("Baseline %s has format version %s, expected %d" %
+                 (args.compare, baseline.get("format_version"), FORMAT_VERSION))
+    regressions = compare(results, baseline, args.tolerance)
+    if regressions:
+        print("%d metrics regressed more than %.0f%%" % (len(regressions), 100 * args.tolerance))
+        sys.exit(1)
+    print("No regressions over %.0f%%" % (100 * args.tolerance))
@@ -0,0 +1,392 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+  Binary ring-buffer log for the LoRaWAN scenarios. Log statements store a
+  fixed-size record and the text is only written when the buffer is dumped.
+ */
+
+#ifndef BINARY_LOG_H
+#define BINARY_LOG_H
+
+#include "ns3/simulator.h"
+#include "ns3/fatal-error.h"
+#include <algorithm>
+#include <atomic>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <ostream>
+#include <string>
+#include <type_traits>
+#include <unistd.h>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * A log statement as stored in the ring buffer
+ */
+struct BinaryLogRecord
+{
+  int64_t time;       //!< Simulation time in time steps
+  uint32_t context;   //!< Context of the event that logged it
+  uint16_t component; //!< Index of the component name
+  uint16_t format;    //!< Index of the format string
+  uint64_t args[4];   //!< Arguments, interpreted with the types of the format
+};
+
+/**
+ * Ring buffer of BinaryLogRecord.
+ *
+ * Writers reserve a slot with a single atomic increment of the head, so the
+ * log never takes a lock. Once the buffer is full the oldest records are
+ * overwritten. Every log statement registers its format string, its
+ * component and the types of its arguments once; the format uses {} as the
+ * placeholder of each argument. Only numbers and pointers can be logged,
+ * because the arguments may be formatted long after the statement ran.
+ */
+class BinaryLog
+{
+public:
+  static BinaryLog &Get (void)
+  {
+    static BinaryLog log;
+    return log;
+  }
+
+  /**
+   * Start logging into a buffer of the given number of records, rounded up
+   * to a power of two
+   */
+  void Enable (uint32_t capacity)
+  {
+    uint64_t size = 1;
+    while (size < capacity)
+      {
+        size <<= 1;
+      }
+    m_records.assign (size, BinaryLogRecord ());
+    m_mask = size - 1;
+    m_head.store (0);
+    Enabled () = true;
+  }
+
+  static bool &Enabled (void)
+  {
+    static bool enabled = false;
+    return enabled;
+  }
+
+  /**
+   * \returns the id of a format, registering it with its component and the
+   * types of its arguments
+   */
+  template <typename... Args>
+  uint16_t RegisterFormat (const char *component, const char *format)
+  {
+    static_assert (sizeof... (Args) <= 4, "A binary log statement takes at most four arguments");
+    Format entry;
+    entry.component = RegisterComponent (component);
+    entry.text = format;
+    char types[] = { TypeCode<typename std::decay<Args>::type> ()..., 0 };
+    entry.types = types;
+    if (m_formats.size () >= 0xffff)
+      {
+        NS_FATAL_ERROR ("Too many binary log formats");
+      }
+    m_formats.push_back (entry);
+    return m_formats.size () - 1;
+  }
+
+  /**
+   * Same as RegisterFormat, with the types of the arguments deduced from
+   * sample values
+   */
+  template <typename... Args>
+  static uint16_t RegisterFormatOf (BinaryLog &log, const char *component, const char *format, Args...)
+  {
+    return log.RegisterFormat<Args...> (component, format);
+  }
+
+  template <typename... Args>
+  void Write (uint16_t format, Args... args)
+  {
+    uint64_t slot = m_head.fetch_add (1, std::memory_order_relaxed) & m_mask;
+    BinaryLogRecord &record = m_records[slot];
+    record.time = Simulator::Now ().GetTimeStep ();
+    record.context = Simulator::GetContext ();
+    record.component = m_formats[format].component;
+    record.format = format;
+    uint64_t packed[] = { Pack (args)..., 0 };
+    std::memcpy (record.args, packed, sizeof (uint64_t) * sizeof... (Args));
+  }
+
+  /**
+   * Forget every record, keeping the formats
+   */
+  void Clear (void)
+  {
+    m_head.store (0);
+  }
+
+  /**
+   * \returns the number of records written since Enable, including the
+   * overwritten ones
+   */
+  uint64_t GetWritten (void) const
+  {
+    return m_head.load ();
+  }
+
+  /**
+   * Format the records still in the buffer, oldest first
+   */
+  void Dump (std::ostream &os) const
+  {
+    uint64_t head = m_head.load ();
+    uint64_t first = head > m_records.size () ? head - m_records.size () : 0;
+    if (first > 0)
+      {
+        os << "# " << first << " older records were overwritten\n";
+      }
+    for (uint64_t i = first; i < head; i++)
+      {
+        FormatRecord (os, m_records[i & m_mask]);
+        os << "\n";
+      }
+  }
+
+  /**
+   * Format the records into a file, after its current content if append is
+   * true
+   */
+  void DumpToFile (std::string filename, bool append) const
+  {
+    std::ofstream out (filename.c_str (), append ? std::ios::app : std::ios::trunc);
+    if (!out)
+      {
+        NS_FATAL_ERROR ("Can't write the binary log to " << filename);
+      }
+    Dump (out);
+  }
+
+  /**
+   * On SIGSEGV, SIGABRT, SIGFPE and SIGBUS, write the raw buffer together
+   * with the formats to the given file before dying. The handler only calls
+   * write(2); the file is turned into text with binary-log.py.
+   */
+  void InstallCrashHandler (std::string filename)
+  {
+    m_crashFile = filename;
+    int signals[] = { SIGSEGV, SIGABRT, SIGFPE, SIGBUS };
+    for (uint32_t i = 0; i < sizeof (signals) / sizeof (signals[0]); i++)
+      {
+        struct sigaction action;
+        std::memset (&action, 0, sizeof (action));
+        action.sa_handler = &BinaryLog::CrashHandler;
+        action.sa_flags = SA_RESETHAND;
+        sigaction (signals[i], &action, 0);
+      }
+  }
+
+  /**
+   * Write the raw buffer: the magic "NS3BLOG1", the number of components,
+   * their names, the number of formats, each one as its component index,
+   * argument types and text, the number of records and the records, oldest
+   * first. Strings are NUL terminated and numbers are in host byte order.
+   */
+  void WriteRaw (int fd) const
+  {
+    WriteAll (fd, "NS3BLOG1", 8);
+    uint32_t components = m_components.size ();
+    WriteAll (fd, &components, sizeof (components));
+    for (uint32_t i = 0; i < components; i++)
+      {
+        WriteAll (fd, m_components[i].c_str (), m_components[i].size () + 1);
+      }
+    uint32_t formats = m_formats.size ();
+    WriteAll (fd, &formats, sizeof (formats));
+    for (uint32_t i = 0; i < formats; i++)
+      {
+        WriteAll (fd, &m_formats[i].component, sizeof (uint16_t));
+        WriteAll (fd, m_formats[i].types.c_str (), m_formats[i].types.size () + 1);
+        WriteAll (fd, m_formats[i].text, std::strlen (m_formats[i].text) + 1);
+      }
+    uint64_t head = m_head.load ();
+    uint64_t first = head > m_records.size () ? head - m_records.size () : 0;
+    uint64_t count = head - first;
+    WriteAll (fd, &count, sizeof (count));
+    uint64_t start = first & m_mask;
+    uint64_t tail = std::min<uint64_t> (count, m_records.size () - start);
+    WriteAll (fd, &m_records[start], tail * sizeof (BinaryLogRecord));
+    WriteAll (fd, &m_records[0], (count - tail) * sizeof (BinaryLogRecord));
+  }
+
+private:
+  struct Format
+  {
+    uint16_t component;
+    std::string types;  //!< One character per argument: i, u, d or p
+    const char *text;
+  };
+
+  BinaryLog ()
+    : m_mask (0),
+      m_head (0)
+  {
+  }
+
+  uint16_t RegisterComponent (const char *component)
+  {
+    for (uint32_t i = 0; i < m_components.size (); i++)
+      {
+        if (m_components[i] == component)
+          {
+            return i;
+          }
+      }
+    m_components.push_back (component);
+    return m_components.size () - 1;
+  }
+
+  template <typename T>
+  static char TypeCode (void)
+  {
+    static_assert (std::is_arithmetic<T>::value || std::is_pointer<T>::value,
+                   "Only numbers and pointers can be written to the binary log");
+    return std::is_pointer<T>::value ? 'p'
+      : std::is_floating_point<T>::value ? 'd'
+      : std::is_signed<T>::value ? 'i' : 'u';
+  }
+
+  template <typename T>
+  static typename std::enable_if<std::is_floating_point<T>::value, uint64_t>::type
+  Pack (T value)
+  {
+    double d = value;
+    uint64_t bits;
+    std::memcpy (&bits, &d, sizeof (bits));
+    return bits;
+  }
+
+  template <typename T>
+  static typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value, uint64_t>::type
+  Pack (T value)
+  {
+    return static_cast<uint64_t> (static_cast<int64_t> (value));
+  }
+
+  template <typename T>
+  static typename std::enable_if<std::is_integral<T>::value && !std::is_signed<T>::value, uint64_t>::type
+  Pack (T value)
+  {
+    return static_cast<uint64_t> (value);
+  }
+
+  template <typename T>
+  static uint64_t Pack (T *value)
+  {
+    return reinterpret_cast<uint64_t> (value);
+  }
+
+  void FormatRecord (std::ostream &os, const BinaryLogRecord &record) const
+  {
+    const Format &format = m_formats[record.format];
+    os << "+" << TimeStep (record.time).GetSeconds () << "s ";
+    if (record.context != Simulator::NO_CONTEXT)
+      {
+        os << record.context << " ";
+      }
+    os << m_components[record.component] << ": ";
+
+    uint32_t arg = 0;
+    for (const char *c = format.text; *c; c++)
+      {
+        if (c[0] == '{' && c[1] == '}' && arg < format.types.size ())
+          {
+            uint64_t bits = record.args[arg];
+            switch (format.types[arg])
+              {
+              case 'i':
+                os << static_cast<int64_t> (bits);
+                break;
+              case 'u':
+                os << bits;
+                break;
+              case 'd':
+                {
+                  double d;
+                  std::memcpy (&d, &bits, sizeof (d));
+                  os << d;
+                  break;
+                }
+              default:
+                os << reinterpret_cast<void *> (bits);
+              }
+            arg++;
+            c++;
+          }
+        else
+          {
+            os << *c;
+          }
+      }
+  }
+
+  static void WriteAll (int fd, const void *data, size_t size)
+  {
+    const char *p = static_cast<const char *> (data);
+    while (size > 0)
+      {
+        ssize_t written = write (fd, p, size);
+        if (written <= 0)
+          {
+            return;
+          }
+        p += written;
+        size -= written;
+      }
+  }
+
+  static void CrashHandler (int signal)
+  {
+    BinaryLog &log = Get ();
+    int fd = open (log.m_crashFile.c_str (), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd >= 0)
+      {
+        log.WriteRaw (fd);
+        close (fd);
+      }
+    raise (signal);
+  }
+
+  std::vector<BinaryLogRecord> m_records;
+  uint64_t m_mask;
+  std::atomic<uint64_t> m_head;
+  std::vector<std::string> m_components;
+  std::vector<Format> m_formats;
+  std::string m_crashFile;
+};
+
+} // namespace ns3
+
+/**
+ * Log a message with up to four numeric arguments, replacing each {} of the
+ * format. The format is registered the first time the statement runs and
+ * costs nothing while the binary log is disabled.
+ */
+#define BINARY_LOG(component, format, ...)                                         \
+  do                                                                               \
+    {                                                                              \
+      if (ns3::BinaryLog::Enabled ())                                              \
+        {                                                                          \
+          ns3::BinaryLog &binaryLog = ns3::BinaryLog::Get ();                      \
+          static const uint16_t binaryLogFormat =                                  \
+            ns3::BinaryLog::RegisterFormatOf (binaryLog, component, format, ##__VA_ARGS__); \
+          binaryLog.Write (binaryLogFormat, ##__VA_ARGS__);                        \
+        }                                                                          \
+    }                                                                              \
+  while (false)
+
+#endif /* BINARY_LOG_H */
@@ -0,0 +1,86 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+
+# Turns the raw dump written by BinaryLog (binary-log.h) when a scenario
+# crashes into the same text the scenario writes with --binaryLogFile.
+
+import argparse
+import struct
+import sys
+
+RECORD = struct.Struct("=qIHH4Q")
+STEPS_PER_SECOND = 1e9  # ns-3 default time resolution
+NO_CONTEXT = 0xffffffff
+
+parser = argparse.ArgumentParser(description='Format a raw binary log dump')
+parser.add_argument('dump',
+                    type=str,
+                    help='File written by the crash handler of the binary log')
+parser.add_argument('--last',
+                    type=int,
+                    default=0,
+                    help='Only print the last records, 0 prints all, Default: 0')
+args = parser.parse_args()
+
+
+def read_string(data, offset):
+    end = data.index(b"\0", offset)
+    return data[offset:end].decode("utf-8", "replace"), end + 1
+
+
+def format_argument(kind, bits):
+    if kind == "i":
+        return str(struct.unpack("=q", struct.pack("=Q", bits))[0])
+    if kind == "u":
+        return str(bits)
+    if kind == "d":
+        return "%g" % struct.unpack("=d", struct.pack("=Q", bits))[0]
+    return hex(bits)
+
+
+def format_record(components, formats, record):
+    time, context, component, formatId, a0, a1, a2, a3 = record
+    _, types, text = formats[formatId]
+    values = [format_argument(kind, bits) for kind, bits in zip(types, (a0, a1, a2, a3))]
+    pieces = text.split("{}")
+    message = pieces[0]
+    for i, piece in enumerate(pieces[1:]):
+        message += (values[i] if i < len(values) else "{}") + piece
+    prefix = "+%gs " % (time / STEPS_PER_SECOND)
+    if context != NO_CONTEXT:
+        prefix += "%d " % context
+    return "%s%s: %s" % (prefix, components[component], message)
+
+
+with open(args.dump, "rb") as f:
+    data = f.read()
+if data[:8] != b"NS3BLOG1":
+    sys.exit("%s is not a binary log dump" % args.dump)
+
+offset = 8
+(nComponents,) = struct.unpack_from("=I", data, offset)
+offset += 4
+components = []
+for i in range(nComponents):
+    name, offset = read_string(data, offset)
+    components.append(name)
+
+(nFormats,) = struct.unpack_from("=I", data, offset)
+offset += 4
+formats = []
+for i in range(nFormats):
+    (component,) = struct.unpack_from("=H", data, offset)
+    offset += 2
+    types, offset = read_string(data, offset)
+    text, offset = read_string(data, offset)
+    formats.append((component, types, text))
+
+(nRecords,) = struct.unpack_from("=Q", data, offset)
+offset += 8
+available = min(nRecords, (len(data) - offset) // RECORD.size)
+first = max(0, available - args.last) if args.last else 0
+for i in range(first, available):
+    record = RECORD.unpack_from(data, offset + i * RECORD.size)
+    print(format_record(components, formats, record))
+if available < nRecords:
+    print("# dump truncated after %d of %d records" % (available, nRecords))
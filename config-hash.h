@@ -0,0 +1,128 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+  Stable hash of the parameters of a scenario, used to name the files shared
+  by the runs with the same configuration.
+ */
+
+#ifndef CONFIG_HASH_H
+#define CONFIG_HASH_H
+
+#include "ns3/object.h"
+#include "ns3/type-id.h"
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+namespace ns3 {
+
+/**
+ * 64-bit FNV-1a hash of a list of named parameters.
+ *
+ * Every parameter is added as the text "name=value;", with doubles printed
+ * with 17 significant digits, so the hash only depends on the values and on
+ * the order they are added in, and not on the platform. The text is kept as
+ * a readable description of what was hashed.
+ */
+class ConfigHash
+{
+public:
+  ConfigHash ()
+    : m_hash (14695981039346656037ULL)
+  {
+  }
+
+  template <typename T>
+  ConfigHash &Add (std::string name, const T &value)
+  {
+    std::ostringstream text;
+    text.precision (17);
+    text << name << '=' << value << ';';
+    std::string entry = text.str ();
+    Mix (entry);
+    m_text += entry;
+    return *this;
+  }
+
+  /**
+   * Add the type and the readable attributes of an object, such as the
+   * parameters of a random variable
+   */
+  ConfigHash &AddAttributes (std::string name, Ptr<const Object> object)
+  {
+    TypeId type = object->GetInstanceTypeId ();
+    Add (name, type.GetName ());
+    for (TypeId tid = type; tid != Object::GetTypeId (); tid = tid.GetParent ())
+      {
+        for (uint32_t i = 0; i < tid.GetAttributeN (); i++)
+          {
+            struct TypeId::AttributeInformation info = tid.GetAttribute (i);
+            if (!(info.flags & TypeId::ATTR_GET))
+              {
+                continue;
+              }
+            Ptr<AttributeValue> value = info.checker->Create ();
+            object->GetAttribute (info.name, *value);
+            Add (name + "." + info.name, value->SerializeToString (info.checker));
+          }
+      }
+    return *this;
+  }
+
+  /**
+   * Add the contents of a file, or only its name if it can't be read
+   */
+  ConfigHash &AddFile (std::string name, std::string filename)
+  {
+    Add (name, filename);
+    std::ifstream in (filename.c_str (), std::ios::binary);
+    if (in)
+      {
+        std::ostringstream contents;
+        contents << in.rdbuf ();
+        Mix (contents.str ());
+        m_text += name + ".contents;";
+      }
+    return *this;
+  }
+
+  uint64_t Get (void) const
+  {
+    return m_hash;
+  }
+
+  /**
+   * \returns the hash as 16 hexadecimal digits, to put in file names
+   */
+  std::string GetHex (void) const
+  {
+    char hex[17];
+    std::snprintf (hex, sizeof (hex), "%016llx", static_cast<unsigned long long> (m_hash));
+    return hex;
+  }
+
+  /**
+   * \returns the parameters that were hashed
+   */
+  std::string GetText (void) const
+  {
+    return m_text;
+  }
+
+private:
+  void Mix (const std::string &bytes)
+  {
+    for (std::string::size_type i = 0; i < bytes.size (); i++)
+      {
+        m_hash ^= static_cast<unsigned char> (bytes[i]);
+        m_hash *= 1099511628211ULL;
+      }
+  }
+
+  uint64_t m_hash;
+  std::string m_text;
+};
+
+} // namespace ns3
+
+#endif /* CONFIG_HASH_H */
@@ -0,0 +1,452 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+  Flight recorder for the Wi-Fi scenario. Each device keeps its last frames in
+  memory and a pcapng file is only written around the moments a trigger fires.
+ */
+
+#ifndef FLIGHT_RECORDER_H
+#define FLIGHT_RECORDER_H
+
+#include "ns3/simulator.h"
+#include "ns3/packet.h"
+#include "ns3/callback.h"
+#include "ns3/fatal-error.h"
+#include "ns3/net-device-container.h"
+#include "ns3/wifi-net-device.h"
+#include "ns3/wifi-phy.h"
+#include "ns3/simple-ref-count.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * In-memory capture of the frames of a set of Wi-Fi devices.
+ *
+ * Memory is bounded by devices * slots * snapLen and nothing is written
+ * unless a trigger fires. A trigger at time t writes the frames of every
+ * device between t - pre and t + post once t + post is reached, so the
+ * rings must be large enough to hold pre + post of traffic, which
+ * GetSlotsFor sizes from the frame rate a device sees. Triggers that
+ * fire while a window is still open are merged into it. All the windows
+ * go to the same pcapng file, with one interface per device, link type
+ * IEEE 802.11 (105) with FCS and nanosecond time stamps.
+ */
+class FlightRecorder : public SimpleRefCount<FlightRecorder>
+{
+public:
+  FlightRecorder (std::string filename, uint32_t snapLen, uint32_t slotsPerDevice)
+    : m_filename (filename),
+      m_snapLen (snapLen),
+      m_slots (slotsPerDevice),
+      m_pre (Seconds (2)),
+      m_post (Seconds (1)),
+      m_lastWritten (-1),
+      m_lastRxBytes (0),
+      m_lastTxBytes (0),
+      m_throughputSamples (0),
+      m_throughputAverage (0),
+      m_dropFraction (0),
+      m_delaySamples (0),
+      m_delayAverage (0),
+      m_spikeFactor (0),
+      m_written (0)
+  {
+  }
+
+  /**
+   * Start capturing the frames sent and received by the PHY of each device
+   */
+  void Install (NetDeviceContainer devices)
+  {
+    for (NetDeviceContainer::Iterator i = devices.Begin (); i != devices.End (); ++i)
+      {
+        Ptr<WifiNetDevice> device = DynamicCast<WifiNetDevice> (*i);
+        NS_ASSERT (device != 0);
+        uint32_t index = m_rings.size ();
+        m_rings.push_back (Ring ());
+        Ring &ring = m_rings.back ();
+        ring.nodeId = device->GetNode ()->GetId ();
+        ring.head = 0;
+        ring.slots.resize (m_slots);
+        ring.data.resize (uint64_t (m_slots) * m_snapLen);
+        device->GetPhy ()->TraceConnectWithoutContext ("PhyTxBegin",
+                                                       MakeBoundCallback (&FlightRecorder::TxTrace, this, index));
+        device->GetPhy ()->TraceConnectWithoutContext ("PhyRxEnd",
+                                                       MakeBoundCallback (&FlightRecorder::RxTrace, this, index));
+      }
+  }
+
+  /**
+   * Set how much traffic before and after a trigger is written
+   */
+  void SetWindow (Time pre, Time post)
+  {
+    m_pre = pre;
+    m_post = post;
+  }
+
+  /**
+   * Write everything captured between start and stop
+   */
+  void AddCaptureWindow (Time start, Time stop)
+  {
+    OpenWindow (start, stop, "window");
+  }
+
+  /**
+   * \returns the slots a device needs to keep pre + post of traffic when it
+   * sees up to framesPerSecond frames, with a quarter of headroom
+   */
+  static uint32_t GetSlotsFor (double framesPerSecond, Time pre, Time post)
+  {
+    return std::ceil (1.25 * framesPerSecond * (pre + post).GetSeconds ()) + 1;
+  }
+
+  /**
+   * Sample the sent and received bytes every interval and trigger when the
+   * fraction of the sent bytes received over an interval falls below
+   * dropFraction times its moving average. The intervals in which nothing
+   * is sent, the off periods of the sources, are skipped rather than taken
+   * for drops.
+   */
+  void MonitorThroughput (Callback<uint64_t> rxBytes, Callback<uint64_t> txBytes, Time interval, double dropFraction)
+  {
+    m_rxBytesSource = rxBytes;
+    m_txBytesSource = txBytes;
+    m_throughputInterval = interval;
+    m_dropFraction = dropFraction;
+    Simulator::Schedule (interval, &FlightRecorder::SampleThroughput, this);
+  }
+
+  /**
+   * Trigger when a delay passed to NotifyDelay exceeds spikeFactor times the
+   * moving average of the previous ones
+   */
+  void MonitorDelay (double spikeFactor)
+  {
+    m_spikeFactor = spikeFactor;
+  }
+
+  void NotifyDelay (Time delay)
+  {
+    if (m_spikeFactor <= 0)
+      {
+        return;
+      }
+    double seconds = delay.GetSeconds ();
+    if (m_delaySamples >= WARMUP_SAMPLES && seconds > m_spikeFactor * m_delayAverage)
+      {
+        Trigger ("delay spike");
+      }
+    m_delayAverage = m_delaySamples ? (1 - EWMA_WEIGHT) * m_delayAverage + EWMA_WEIGHT * seconds : seconds;
+    m_delaySamples++;
+  }
+
+  /**
+   * Write the frames around now
+   */
+  void Trigger (std::string reason)
+  {
+    Time now = Simulator::Now ();
+    for (std::vector<Window>::iterator w = m_pending.begin (); w != m_pending.end (); ++w)
+      {
+        if (w->start <= now && w->stop >= now)
+          {
+            return;
+          }
+      }
+    OpenWindow (now - m_pre, now + m_post, reason);
+  }
+
+  /**
+   * Write the windows that are still open, up to now. To be called after
+   * Simulator::Run.
+   */
+  void Flush (void)
+  {
+    while (!m_pending.empty ())
+      {
+        WriteWindow (m_pending.front ());
+        m_pending.erase (m_pending.begin ());
+      }
+    if (m_file.is_open ())
+      {
+        m_file.close ();
+      }
+  }
+
+  /**
+   * \returns the time and reason of every trigger
+   */
+  const std::vector<std::pair<Time, std::string> > &GetTriggers (void) const
+  {
+    return m_triggers;
+  }
+
+  /**
+   * \returns the number of frames written to the file
+   */
+  uint64_t GetWrittenFrames (void) const
+  {
+    return m_written;
+  }
+
+private:
+  static const uint32_t WARMUP_SAMPLES = 5;
+  static constexpr double EWMA_WEIGHT = 0.2;
+
+  enum Direction
+  {
+    INBOUND = 1,
+    OUTBOUND = 2
+  };
+
+  struct Slot
+  {
+    int64_t time;     //!< Time step of the capture
+    uint32_t length;  //!< Length of the frame
+    uint32_t caplen;  //!< Bytes kept, at most the snap length
+    uint8_t direction;
+  };
+
+  struct Ring
+  {
+    uint32_t nodeId;
+    uint64_t head;            //!< Frames captured so far
+    std::vector<Slot> slots;
+    std::vector<uint8_t> data;
+  };
+
+  struct Window
+  {
+    Time start;
+    Time stop;
+    std::string reason;
+  };
+
+  static void TxTrace (FlightRecorder *recorder, uint32_t index, Ptr<const Packet> packet, double txPowerW)
+  {
+    recorder->Capture (index, packet, OUTBOUND);
+  }
+
+  static void RxTrace (FlightRecorder *recorder, uint32_t index, Ptr<const Packet> packet)
+  {
+    recorder->Capture (index, packet, INBOUND);
+  }
+
+  void Capture (uint32_t index, Ptr<const Packet> packet, uint8_t direction)
+  {
+    Ring &ring = m_rings[index];
+    uint32_t slot = ring.head % m_slots;
+    ring.head++;
+    Slot &s = ring.slots[slot];
+    s.time = Simulator::Now ().GetTimeStep ();
+    s.length = packet->GetSize ();
+    s.caplen = packet->CopyData (&ring.data[uint64_t (slot) * m_snapLen], m_snapLen);
+    s.direction = direction;
+  }
+
+  void SampleThroughput (void)
+  {
+    uint64_t rxBytes = m_rxBytesSource ();
+    uint64_t txBytes = m_txBytesSource ();
+    uint64_t sent = txBytes - m_lastTxBytes;
+    uint64_t received = rxBytes - m_lastRxBytes;
+    m_lastRxBytes = rxBytes;
+    m_lastTxBytes = txBytes;
+    if (sent > 0)
+      {
+        // The frames in flight at the edges of the interval may push it over 1
+        double delivered = std::min (double (received) / sent, 1.0);
+        if (m_throughputSamples >= WARMUP_SAMPLES && delivered < m_dropFraction * m_throughputAverage)
+          {
+            Trigger ("throughput drop");
+          }
+        m_throughputAverage = m_throughputSamples
+          ? (1 - EWMA_WEIGHT) * m_throughputAverage + EWMA_WEIGHT * delivered : delivered;
+        m_throughputSamples++;
+      }
+    Simulator::Schedule (m_throughputInterval, &FlightRecorder::SampleThroughput, this);
+  }
+
+  void OpenWindow (Time start, Time stop, std::string reason)
+  {
+    Window window;
+    window.start = start;
+    window.stop = stop;
+    window.reason = reason;
+    m_pending.push_back (window);
+    m_triggers.push_back (std::make_pair (Simulator::Now (), reason));
+    Simulator::Schedule (std::max (stop - Simulator::Now (), Time (0)), &FlightRecorder::WriteDue, this);
+  }
+
+  void WriteDue (void)
+  {
+    Time now = Simulator::Now ();
+    for (std::vector<Window>::iterator w = m_pending.begin (); w != m_pending.end ();)
+      {
+        if (w->stop <= now)
+          {
+            WriteWindow (*w);
+            w = m_pending.erase (w);
+          }
+        else
+          {
+            ++w;
+          }
+      }
+  }
+
+  void WriteWindow (const Window &window)
+  {
+    if (!m_file.is_open ())
+      {
+        OpenFile ();
+      }
+
+    // The frames of all the devices, in time order, that were not written by
+    // an earlier window
+    int64_t start = std::max (window.start.GetTimeStep (), m_lastWritten + 1);
+    int64_t stop = std::min (window.stop, Simulator::Now ()).GetTimeStep ();
+    std::vector<std::pair<int64_t, std::pair<uint32_t, uint32_t> > > frames;
+    for (uint32_t r = 0; r < m_rings.size (); r++)
+      {
+        const Ring &ring = m_rings[r];
+        uint64_t first = ring.head > m_slots ? ring.head - m_slots : 0;
+        for (uint64_t i = first; i < ring.head; i++)
+          {
+            const Slot &s = ring.slots[i % m_slots];
+            if (s.time >= start && s.time <= stop)
+              {
+                frames.push_back (std::make_pair (s.time, std::make_pair (r, uint32_t (i % m_slots))));
+              }
+          }
+      }
+    std::sort (frames.begin (), frames.end ());
+
+    for (size_t i = 0; i < frames.size (); i++)
+      {
+        WritePacketBlock (frames[i].second.first, frames[i].second.second);
+      }
+    m_lastWritten = std::max (m_lastWritten, stop);
+    m_written += frames.size ();
+    m_file.flush ();
+  }
+
+  void OpenFile (void)
+  {
+    m_file.open (m_filename.c_str (), std::ios::binary | std::ios::trunc);
+    if (!m_file)
+      {
+        NS_FATAL_ERROR ("Can't write the capture to " << m_filename);
+      }
+
+    // Section header block
+    WriteU32 (0x0A0D0D0A);
+    WriteU32 (28);
+    WriteU32 (0x1A2B3C4D);
+    WriteU16 (1);
+    WriteU16 (0);
+    WriteU32 (0xffffffff);
+    WriteU32 (0xffffffff);
+    WriteU32 (28);
+
+    for (uint32_t r = 0; r < m_rings.size (); r++)
+      {
+        std::string name = "node-" + std::to_string (m_rings[r].nodeId);
+        uint32_t namePadded = (name.size () + 3) & ~3u;
+        // Interface description block: if_name, if_tsresol (ns), if_fcslen, end
+        uint32_t length = 20 + (4 + namePadded) + 8 + 8 + 4;
+        WriteU32 (1);
+        WriteU32 (length);
+        WriteU16 (105);
+        WriteU16 (0);
+        WriteU32 (m_snapLen);
+        WriteU16 (2);
+        WriteU16 (name.size ());
+        WriteBytes (name.data (), name.size (), namePadded);
+        WriteU16 (9);
+        WriteU16 (1);
+        WriteBytes ("\x09", 1, 4);
+        WriteU16 (13);
+        WriteU16 (1);
+        WriteBytes ("\x04", 1, 4);
+        WriteU32 (0);
+        WriteU32 (length);
+      }
+  }
+
+  void WritePacketBlock (uint32_t ring, uint32_t slot)
+  {
+    const Slot &s = m_rings[ring].slots[slot];
+    uint32_t padded = (s.caplen + 3) & ~3u;
+    // Enhanced packet block with an epb_flags option for the direction
+    uint32_t length = 32 + padded + 8 + 4;
+    uint64_t ns = TimeStep (s.time).GetNanoSeconds ();
+    WriteU32 (6);
+    WriteU32 (length);
+    WriteU32 (ring);
+    WriteU32 (ns >> 32);
+    WriteU32 (ns & 0xffffffff);
+    WriteU32 (s.caplen);
+    WriteU32 (s.length);
+    WriteBytes (&m_rings[ring].data[uint64_t (slot) * m_snapLen], s.caplen, padded);
+    WriteU16 (2);
+    WriteU16 (4);
+    WriteU32 (s.direction);
+    WriteU32 (0);
+    WriteU32 (length);
+  }
+
+  void WriteU16 (uint16_t value)
+  {
+    m_file.write (reinterpret_cast<const char *> (&value), sizeof (value));
+  }
+
+  void WriteU32 (uint32_t value)
+  {
+    m_file.write (reinterpret_cast<const char *> (&value), sizeof (value));
+  }
+
+  void WriteBytes (const void *data, uint32_t size, uint32_t padded)
+  {
+    static const char zeros[4] = { 0, 0, 0, 0 };
+    m_file.write (static_cast<const char *> (data), size);
+    m_file.write (zeros, padded - size);
+  }
+
+  std::string m_filename;
+  uint32_t m_snapLen;
+  uint32_t m_slots;
+  Time m_pre;
+  Time m_post;
+  std::vector<Ring> m_rings;
+  std::vector<Window> m_pending;
+  std::vector<std::pair<Time, std::string> > m_triggers;
+  std::ofstream m_file;
+  int64_t m_lastWritten;  //!< Time step of the last frame that may have been written
+
+  Callback<uint64_t> m_rxBytesSource;
+  Callback<uint64_t> m_txBytesSource;
+  Time m_throughputInterval;
+  uint64_t m_lastRxBytes;
+  uint64_t m_lastTxBytes;
+  uint32_t m_throughputSamples;
+  double m_throughputAverage;     //!< Moving average of the fraction of the sent bytes received
+  double m_dropFraction;
+
+  uint32_t m_delaySamples;
+  double m_delayAverage;
+  double m_spikeFactor;
+
+  uint64_t m_written;
+};
+
+} // namespace ns3
+
+#endif /* FLIGHT_RECORDER_H */
@@ -0,0 +1,426 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+  Per-flow statistics for the Wi-Fi scenario without FlowMonitor. The tracked
+  flows are sampled at a fixed interval into a CSV or binary time series.
+ */
+
+#ifndef FLOW_STATS_EXPORTER_H
+#define FLOW_STATS_EXPORTER_H
+
+#include "ns3/simulator.h"
+#include "ns3/application.h"
+#include "ns3/packet.h"
+#include "ns3/packet-sink.h"
+#include "ns3/seq-ts-size-header.h"
+#include "ns3/inet-socket-address.h"
+#include "ns3/ipv4-address.h"
+#include "ns3/event-id.h"
+#include "ns3/callback.h"
+#include "ns3/fatal-error.h"
+#include "ns3/simple-ref-count.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <limits>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * Online statistics of a flow. Delays are accumulated with Welford's
+ * algorithm; the jitter is the mean of the absolute difference between
+ * consecutive delays, as in FlowMonitor.
+ */
+struct FlowAccumulator
+{
+  FlowAccumulator ()
+    : txPackets (0),
+      txBytes (0),
+      rxPackets (0),
+      rxBytes (0),
+      expected (0),
+      delayMean (0),
+      delayM2 (0),
+      delayMin (std::numeric_limits<double>::infinity ()),
+      delayMax (0),
+      jitterSum (0),
+      lastDelay (-1),
+      firstTx (-1),
+      lastTx (-1),
+      firstRx (-1),
+      lastRx (-1),
+      snapshotRxBytes (0)
+  {
+  }
+
+  uint64_t txPackets;
+  uint64_t txBytes;
+  uint64_t rxPackets;
+  uint64_t rxBytes;
+  uint64_t expected;   //!< Highest sequence number received plus one
+  double delayMean;    //!< Seconds
+  double delayM2;
+  double delayMin;
+  double delayMax;
+  double jitterSum;    //!< Seconds
+  double lastDelay;
+  double firstTx;      //!< Seconds, negative until the first packet
+  double lastTx;
+  double firstRx;
+  double lastRx;
+  uint64_t snapshotRxBytes;  //!< Received bytes at the last snapshot
+
+  /**
+   * \returns the packets that were overtaken by a later one and never
+   * arrived, so packets still in flight are not counted
+   */
+  uint64_t GetLostPackets (void) const
+  {
+    return expected > rxPackets ? expected - rxPackets : 0;
+  }
+
+  double GetDelayStdDev (void) const
+  {
+    return rxPackets > 1 ? std::sqrt (delayM2 / (rxPackets - 1)) : 0;
+  }
+
+  double GetMeanJitter (void) const
+  {
+    return rxPackets > 1 ? jitterSum / (rxPackets - 1) : 0;
+  }
+
+  double GetOfferedLoad (void) const
+  {
+    return lastTx > firstTx ? txBytes * 8.0 / (lastTx - firstTx) : 0;
+  }
+
+  double GetThroughput (void) const
+  {
+    return lastRx > firstRx ? rxBytes * 8.0 / (lastRx - firstRx) : 0;
+  }
+};
+
+/**
+ * Streams the statistics of selected application flows.
+ *
+ * A flow goes from an application that sends with a SeqTsSizeHeader (an
+ * OnOffApplication with EnableSeqTsSizeHeader) to a PacketSink with
+ * EnableSeqTsSizeHeader; the header carries the sequence number and the
+ * send time, so no packet tag or per-packet state is needed and the memory
+ * taken does not depend on the traffic. Flows are numbered from 1 in the
+ * order they are added, like the flow ids of FlowMonitor, and flows that
+ * are not tracked are not even connected.
+ *
+ * Every interval one row per tracked flow is appended to the output: time,
+ * flow, tx packets, rx packets, lost packets, rx bytes, throughput of the
+ * interval (bps), delay mean, standard deviation, minimum and maximum (s)
+ * and mean jitter (s). The CSV output has a header line with these names.
+ * The binary output starts with the magic "NS3FLOW1" followed by the
+ * comma-separated names, NUL terminated, and then holds a FlowSnapshot per
+ * row, in host byte order.
+ */
+class FlowStatsExporter : public SimpleRefCount<FlowStatsExporter>
+{
+public:
+  struct FlowSnapshot
+  {
+    double time;
+    uint32_t flow;
+    uint32_t padding;
+    uint64_t txPackets;
+    uint64_t rxPackets;
+    uint64_t lostPackets;
+    uint64_t rxBytes;
+    double throughput;
+    double delayMean;
+    double delayStdDev;
+    double delayMin;
+    double delayMax;
+    double jitter;
+  };
+
+  /**
+   * \param filename The file the snapshots are written to, empty to only
+   * keep the accumulators
+   * \param binary Whether to write binary records instead of CSV
+   */
+  FlowStatsExporter (std::string filename, bool binary)
+    : m_filename (filename),
+      m_binary (binary),
+      m_flows (0),
+      m_lastSnapshot (0)
+  {
+  }
+
+  /**
+   * Only track the given flow ids; all the flows are tracked while the set
+   * is empty. Must be called before the flows are added.
+   */
+  void SetTrackedFlows (std::set<uint32_t> flows)
+  {
+    m_tracked = flows;
+  }
+
+  /**
+   * \returns the flow ids in a comma-separated list, such as "1,3,4"
+   */
+  static std::set<uint32_t> ParseFlowList (std::string list)
+  {
+    std::set<uint32_t> flows;
+    std::stringstream ss (list);
+    std::string item;
+    while (std::getline (ss, item, ','))
+      {
+        if (item.empty ())
+          {
+            continue;
+          }
+        char *end;
+        unsigned long flow = std::strtoul (item.c_str (), &end, 10);
+        if (*end != '\0' || flow == 0)
+          {
+            NS_FATAL_ERROR ("Invalid flow id " << item << " in " << list);
+          }
+        flows.insert (flow);
+      }
+    return flows;
+  }
+
+  /**
+   * Add the flow from source to the sink, whose packets arrive from the
+   * given address
+   *
+   * \returns the id of the flow
+   */
+  uint32_t AddFlow (Ptr<Application> source, Ptr<PacketSink> sink, Ipv4Address from)
+  {
+    uint32_t id = ++m_flows;
+    if (!m_tracked.empty () && m_tracked.find (id) == m_tracked.end ())
+      {
+        return id;
+      }
+    uint32_t index = m_accumulators.size ();
+    m_accumulators.push_back (FlowAccumulator ());
+    m_ids.push_back (id);
+    source->TraceConnectWithoutContext ("TxWithSeqTsSize",
+                                        MakeBoundCallback (&FlowStatsExporter::TxTrace, this, index));
+
+    uint32_t sinkIndex = 0;
+    while (sinkIndex < m_sinks.size () && m_sinks[sinkIndex].sink != sink)
+      {
+        sinkIndex++;
+      }
+    if (sinkIndex == m_sinks.size ())
+      {
+        m_sinks.push_back (Sink ());
+        m_sinks.back ().sink = sink;
+        sink->TraceConnectWithoutContext ("RxWithSeqTsSize",
+                                          MakeBoundCallback (&FlowStatsExporter::RxTrace, this, sinkIndex));
+      }
+    m_sinks[sinkIndex].sources.push_back (std::make_pair (from, index));
+    return id;
+  }
+
+  /**
+   * Write a snapshot every interval, starting after the first one
+   */
+  void Start (Time interval)
+  {
+    m_interval = interval;
+    m_lastSnapshot = Simulator::Now ().GetSeconds ();
+    m_snapshotEvent = Simulator::Schedule (interval, &FlowStatsExporter::PeriodicSnapshot, this);
+  }
+
+  /**
+   * Write a last snapshot and close the output. To be called after
+   * Simulator::Run.
+   */
+  void Flush (void)
+  {
+    Simulator::Cancel (m_snapshotEvent);
+    Snapshot ();
+    if (m_file.is_open ())
+      {
+        m_file.close ();
+      }
+  }
+
+  /**
+   * \returns the statistics of a tracked flow, or 0 if it is not tracked
+   */
+  const FlowAccumulator *GetFlow (uint32_t id) const
+  {
+    for (uint32_t i = 0; i < m_ids.size (); i++)
+      {
+        if (m_ids[i] == id)
+          {
+            return &m_accumulators[i];
+          }
+      }
+    return 0;
+  }
+
+  uint32_t GetNTracked (void) const
+  {
+    return m_accumulators.size ();
+  }
+
+private:
+  struct Sink
+  {
+    Ptr<PacketSink> sink;
+    std::vector<std::pair<Ipv4Address, uint32_t> > sources;  //!< Address and flow index
+  };
+
+  static void TxTrace (FlowStatsExporter *exporter, uint32_t index, Ptr<const Packet> packet,
+                       const Address &from, const Address &to, const SeqTsSizeHeader &header)
+  {
+    FlowAccumulator &flow = exporter->m_accumulators[index];
+    double now = Simulator::Now ().GetSeconds ();
+    if (flow.firstTx < 0)
+      {
+        flow.firstTx = now;
+      }
+    flow.lastTx = now;
+    flow.txPackets++;
+    flow.txBytes += packet->GetSize ();
+  }
+
+  static void RxTrace (FlowStatsExporter *exporter, uint32_t sinkIndex, Ptr<const Packet> packet,
+                       const Address &from, const Address &to, const SeqTsSizeHeader &header)
+  {
+    if (!InetSocketAddress::IsMatchingType (from))
+      {
+        return;
+      }
+    Ipv4Address source = InetSocketAddress::ConvertFrom (from).GetIpv4 ();
+    const Sink &sink = exporter->m_sinks[sinkIndex];
+    for (uint32_t i = 0; i < sink.sources.size (); i++)
+      {
+        if (sink.sources[i].first == source)
+          {
+            exporter->Receive (exporter->m_accumulators[sink.sources[i].second], packet, header);
+            return;
+          }
+      }
+  }
+
+  void Receive (FlowAccumulator &flow, Ptr<const Packet> packet, const SeqTsSizeHeader &header)
+  {
+    double now = Simulator::Now ().GetSeconds ();
+    double delay = now - header.GetTs ().GetSeconds ();
+    if (flow.firstRx < 0)
+      {
+        flow.firstRx = now;
+      }
+    flow.lastRx = now;
+    flow.rxPackets++;
+    flow.rxBytes += packet->GetSize ();
+    flow.expected = std::max<uint64_t> (flow.expected, uint64_t (header.GetSeq ()) + 1);
+
+    double delta = delay - flow.delayMean;
+    flow.delayMean += delta / flow.rxPackets;
+    flow.delayM2 += delta * (delay - flow.delayMean);
+    flow.delayMin = std::min (flow.delayMin, delay);
+    flow.delayMax = std::max (flow.delayMax, delay);
+    if (flow.lastDelay >= 0)
+      {
+        flow.jitterSum += std::abs (delay - flow.lastDelay);
+      }
+    flow.lastDelay = delay;
+  }
+
+  void PeriodicSnapshot (void)
+  {
+    Snapshot ();
+    m_snapshotEvent = Simulator::Schedule (m_interval, &FlowStatsExporter::PeriodicSnapshot, this);
+  }
+
+  void Snapshot (void)
+  {
+    if (!m_file.is_open () && !m_filename.empty ())
+      {
+        OpenFile ();
+      }
+    double now = Simulator::Now ().GetSeconds ();
+    double elapsed = now - m_lastSnapshot;
+    for (uint32_t i = 0; i < m_accumulators.size (); i++)
+      {
+        FlowAccumulator &flow = m_accumulators[i];
+        FlowSnapshot row;
+        row.time = now;
+        row.flow = m_ids[i];
+        row.padding = 0;
+        row.txPackets = flow.txPackets;
+        row.rxPackets = flow.rxPackets;
+        row.lostPackets = flow.GetLostPackets ();
+        row.rxBytes = flow.rxBytes;
+        row.throughput = elapsed > 0 ? (flow.rxBytes - flow.snapshotRxBytes) * 8.0 / elapsed : 0;
+        row.delayMean = flow.delayMean;
+        row.delayStdDev = flow.GetDelayStdDev ();
+        row.delayMin = flow.rxPackets > 0 ? flow.delayMin : 0;
+        row.delayMax = flow.delayMax;
+        row.jitter = flow.GetMeanJitter ();
+        flow.snapshotRxBytes = flow.rxBytes;
+        WriteRow (row);
+      }
+    m_lastSnapshot = now;
+  }
+
+  void OpenFile (void)
+  {
+    const char *columns = "time,flow,txPackets,rxPackets,lostPackets,rxBytes,throughput,"
+      "delayMean,delayStdDev,delayMin,delayMax,jitter";
+    m_file.open (m_filename.c_str (), m_binary ? std::ios::binary | std::ios::trunc : std::ios::trunc);
+    if (!m_file)
+      {
+        NS_FATAL_ERROR ("Can't write the flow statistics to " << m_filename);
+      }
+    if (m_binary)
+      {
+        m_file.write ("NS3FLOW1", 8);
+        m_file.write (columns, std::char_traits<char>::length (columns) + 1);
+      }
+    else
+      {
+        m_file << columns << "\n";
+      }
+  }
+
+  void WriteRow (const FlowSnapshot &row)
+  {
+    if (!m_file.is_open ())
+      {
+        return;
+      }
+    if (m_binary)
+      {
+        m_file.write (reinterpret_cast<const char *> (&row), sizeof (row));
+        return;
+      }
+    m_file << row.time << "," << row.flow << "," << row.txPackets << "," << row.rxPackets << ","
+           << row.lostPackets << "," << row.rxBytes << "," << row.throughput << ","
+           << row.delayMean << "," << row.delayStdDev << "," << row.delayMin << ","
+           << row.delayMax << "," << row.jitter << "\n";
+  }
+
+  std::string m_filename;
+  bool m_binary;
+  std::ofstream m_file;
+  std::set<uint32_t> m_tracked;
+  uint32_t m_flows;                          //!< Flows added, tracked or not
+  std::vector<uint32_t> m_ids;               //!< Id of each tracked flow
+  std::vector<FlowAccumulator> m_accumulators;
+  std::vector<Sink> m_sinks;
+  Time m_interval;
+  EventId m_snapshotEvent;
+  double m_lastSnapshot;
+};
+
+} // namespace ns3
+
+#endif /* FLOW_STATS_EXPORTER_H */
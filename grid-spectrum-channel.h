@@ -0,0 +1,356 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+  Spectrum channel for the Wi-Fi scenario that only delivers a transmission to
+  the receivers of a spatial grid that can hear it.
+ */
+
+#ifndef GRID_SPECTRUM_CHANNEL_H
+#define GRID_SPECTRUM_CHANNEL_H
+
+#include "ns3/spectrum-channel.h"
+#include "ns3/spectrum-phy.h"
+#include "ns3/spectrum-signal-parameters.h"
+#include "ns3/spectrum-propagation-loss-model.h"
+#include "ns3/propagation-loss-model.h"
+#include "ns3/propagation-delay-model.h"
+#include "ns3/antenna-model.h"
+#include "ns3/angles.h"
+#include "ns3/mobility-model.h"
+#include "ns3/constant-position-mobility-model.h"
+#include "ns3/net-device.h"
+#include "ns3/node.h"
+#include "ns3/simulator.h"
+#include "ns3/double.h"
+#include "ns3/nstime.h"
+#include <cmath>
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * Single spectrum model channel with range culling.
+ *
+ * YansWifiChannel::Send is not virtual, so the Yans channel can't be
+ * extended; this channel is meant for SpectrumWifiPhy instead and follows
+ * SingleModelSpectrumChannel for everything but the choice of receivers.
+ *
+ * The range of a transmission is the distance at which the propagation
+ * loss model brings its total power down to the CullingThreshold. It is
+ * found by bisection and cached per transmit power, so the loss model must
+ * be deterministic and its loss must grow with the distance; random fading
+ * models would be cut at their mean. Receivers are hashed by their
+ * horizontal position into square cells, the grid is rebuilt at most every
+ * GridRefresh, and the cells within the range plus the distance two nodes
+ * moving at MaxSpeed can cover since the last rebuild are searched; the
+ * exact distance is then checked against the range. Receivers without a
+ * mobility model always receive.
+ *
+ * Signals below the threshold are dropped instead of being added to the
+ * interference of the receiver, so the threshold should be at or below
+ * the energy-detection threshold of the PHYs.
+ */
+class GridSpectrumChannel : public SpectrumChannel
+{
+public:
+  static TypeId GetTypeId (void)
+  {
+    static TypeId tid = TypeId ("ns3::GridSpectrumChannel")
+      .SetParent<SpectrumChannel> ()
+      .AddConstructor<GridSpectrumChannel> ()
+      .AddAttribute ("CullingThreshold", "Power (dBm) below which a signal is not delivered",
+                     DoubleValue (-101),
+                     MakeDoubleAccessor (&GridSpectrumChannel::m_thresholdDbm),
+                     MakeDoubleChecker<double> ())
+      .AddAttribute ("CellSize", "Side (m) of the cells of the grid, 0 to use the first range computed",
+                     DoubleValue (0),
+                     MakeDoubleAccessor (&GridSpectrumChannel::m_cellSize),
+                     MakeDoubleChecker<double> (0))
+      .AddAttribute ("GridRefresh", "Longest time between two rebuilds of the grid",
+                     TimeValue (MilliSeconds (100)),
+                     MakeTimeAccessor (&GridSpectrumChannel::m_refresh),
+                     MakeTimeChecker ())
+      .AddAttribute ("MaxSpeed", "Highest speed (m/s) of the nodes, used to widen the search",
+                     DoubleValue (20),
+                     MakeDoubleAccessor (&GridSpectrumChannel::m_maxSpeed),
+                     MakeDoubleChecker<double> (0));
+    return tid;
+  }
+
+  GridSpectrumChannel ()
+    : m_thresholdDbm (-101),
+      m_cellSize (0),
+      m_maxSpeed (20),
+      m_lastRebuild (-1),
+      m_candidates (0),
+      m_deliveries (0)
+  {
+  }
+
+  virtual void AddRx (Ptr<SpectrumPhy> phy)
+  {
+    m_phys.push_back (phy);
+    m_lastRebuild = -1;
+  }
+
+  virtual void RemoveRx (Ptr<SpectrumPhy> phy)
+  {
+    for (std::vector<Ptr<SpectrumPhy> >::iterator i = m_phys.begin (); i != m_phys.end (); ++i)
+      {
+        if (*i == phy)
+          {
+            m_phys.erase (i);
+            m_lastRebuild = -1;
+            return;
+          }
+      }
+  }
+
+  virtual void StartTx (Ptr<SpectrumSignalParameters> txParams)
+  {
+    NS_ASSERT (txParams->txPhy);
+    NS_ASSERT (txParams->psd);
+    m_txSigParamsTrace (txParams->Copy ());
+    Ptr<MobilityModel> senderMobility = txParams->txPhy->GetMobility ();
+
+    std::vector<uint32_t> receivers;
+    if (senderMobility && m_propagationLoss)
+      {
+        double range = GetRange (10 * std::log10 (Integral (*txParams->psd)) + 30);
+        RebuildIfStale ();
+        double reach = range + 2 * m_maxSpeed * (Simulator::Now () - m_lastRebuildTime).GetSeconds ();
+        Vector position = senderMobility->GetPosition ();
+        int64_t span = std::ceil (reach / m_cellSize);
+        int64_t cx = Cell (position.x);
+        int64_t cy = Cell (position.y);
+        for (int64_t x = cx - span; x <= cx + span; x++)
+          {
+            for (int64_t y = cy - span; y <= cy + span; y++)
+              {
+                std::unordered_map<uint64_t, std::vector<uint32_t> >::const_iterator cell = m_grid.find (Key (x, y));
+                if (cell == m_grid.end ())
+                  {
+                    continue;
+                  }
+                for (uint32_t k = 0; k < cell->second.size (); k++)
+                  {
+                    uint32_t index = cell->second[k];
+                    m_candidates++;
+                    Ptr<MobilityModel> mobility = m_phys[index]->GetMobility ();
+                    if (CalculateDistance (position, mobility->GetPosition ()) <= range)
+                      {
+                        receivers.push_back (index);
+                      }
+                  }
+              }
+          }
+        receivers.insert (receivers.end (), m_unplaced.begin (), m_unplaced.end ());
+      }
+    else
+      {
+        for (uint32_t i = 0; i < m_phys.size (); i++)
+          {
+            receivers.push_back (i);
+          }
+      }
+
+    for (uint32_t r = 0; r < receivers.size (); r++)
+      {
+        Ptr<SpectrumPhy> receiver = m_phys[receivers[r]];
+        if (receiver == txParams->txPhy)
+          {
+            continue;
+          }
+        Time delay = Seconds (0);
+        Ptr<MobilityModel> receiverMobility = receiver->GetMobility ();
+        Ptr<SpectrumSignalParameters> rxParams = txParams->Copy ();
+        if (senderMobility && receiverMobility)
+          {
+            double txAntennaGain = 0;
+            double rxAntennaGain = 0;
+            Ptr<AntennaModel> txAntenna = txParams->txAntenna;
+            Ptr<AntennaModel> rxAntenna = receiver->GetRxAntenna ();
+            if (txAntenna)
+              {
+                txAntennaGain = txAntenna->GetGainDb (Angles (receiverMobility->GetPosition (),
+                                                              senderMobility->GetPosition ()));
+              }
+            if (rxAntenna)
+              {
+                rxAntennaGain = rxAntenna->GetGainDb (Angles (senderMobility->GetPosition (),
+                                                              receiverMobility->GetPosition ()));
+              }
+            double propagationGainDb = 0;
+            if (m_propagationLoss)
+              {
+                propagationGainDb = m_propagationLoss->CalcRxPower (0, senderMobility, receiverMobility);
+              }
+            double pathLossDb = -(txAntennaGain + propagationGainDb + rxAntennaGain);
+            m_pathLossTrace (txParams->txPhy, receiver, pathLossDb);
+            if (pathLossDb > m_maxLossDb)
+              {
+                continue;
+              }
+            *(rxParams->psd) *= std::pow (10.0, -pathLossDb / 10.0);
+            if (m_spectrumPropagationLoss)
+              {
+                rxParams->psd = m_spectrumPropagationLoss->CalcRxPowerSpectralDensity (rxParams->psd, senderMobility,
+                                                                                      receiverMobility);
+              }
+            if (m_propagationDelay)
+              {
+                delay = m_propagationDelay->GetDelay (senderMobility, receiverMobility);
+              }
+          }
+        m_deliveries++;
+        Ptr<NetDevice> device = receiver->GetDevice ();
+        uint32_t context = device ? device->GetNode ()->GetId () : Simulator::NO_CONTEXT;
+        Simulator::ScheduleWithContext (context, delay, &GridSpectrumChannel::StartRx, rxParams, receiver);
+      }
+  }
+
+  virtual std::size_t GetNDevices (void) const
+  {
+    return m_phys.size ();
+  }
+
+  virtual Ptr<NetDevice> GetDevice (std::size_t i) const
+  {
+    return m_phys[i]->GetDevice ();
+  }
+
+  /**
+   * \returns the number of receivers examined in the searched cells
+   */
+  uint64_t GetCandidates (void) const
+  {
+    return m_candidates;
+  }
+
+  /**
+   * \returns the number of signals delivered to a receiver
+   */
+  uint64_t GetDeliveries (void) const
+  {
+    return m_deliveries;
+  }
+
+protected:
+  virtual void DoDispose (void)
+  {
+    m_phys.clear ();
+    m_unplaced.clear ();
+    m_grid.clear ();
+    SpectrumChannel::DoDispose ();
+  }
+
+private:
+  static void StartRx (Ptr<SpectrumSignalParameters> params, Ptr<SpectrumPhy> receiver)
+  {
+    receiver->StartRx (params);
+  }
+
+  /**
+   * \returns the distance at which a signal sent with the given power
+   * falls to the threshold
+   */
+  double GetRange (double txPowerDbm)
+  {
+    int64_t key = std::llround (txPowerDbm * 100);
+    std::map<int64_t, double>::const_iterator cached = m_ranges.find (key);
+    if (cached != m_ranges.end ())
+      {
+        return cached->second;
+      }
+    Ptr<ConstantPositionMobilityModel> a = CreateObject<ConstantPositionMobilityModel> ();
+    Ptr<ConstantPositionMobilityModel> b = CreateObject<ConstantPositionMobilityModel> ();
+    a->SetPosition (Vector (0, 0, 0));
+    double low = 0;
+    double high = 1;
+    while (high < 1e6 && RxPower (txPowerDbm, a, b, high) >= m_thresholdDbm)
+      {
+        low = high;
+        high *= 2;
+      }
+    for (uint32_t i = 0; i < 50 && high - low > 0.01; i++)
+      {
+        double middle = (low + high) / 2;
+        if (RxPower (txPowerDbm, a, b, middle) >= m_thresholdDbm)
+          {
+            low = middle;
+          }
+        else
+          {
+            high = middle;
+          }
+      }
+    m_ranges[key] = high;
+    if (m_cellSize <= 0)
+      {
+        m_cellSize = high;
+        m_lastRebuild = -1;
+      }
+    return high;
+  }
+
+  double RxPower (double txPowerDbm, Ptr<ConstantPositionMobilityModel> a,
+                  Ptr<ConstantPositionMobilityModel> b, double distance) const
+  {
+    b->SetPosition (Vector (distance, 0, 0));
+    return m_propagationLoss->CalcRxPower (txPowerDbm, a, b);
+  }
+
+  int64_t Cell (double coordinate) const
+  {
+    return std::floor (coordinate / m_cellSize);
+  }
+
+  static uint64_t Key (int64_t x, int64_t y)
+  {
+    return (uint64_t (x) << 32) ^ (uint64_t (y) & 0xffffffff);
+  }
+
+  void RebuildIfStale (void)
+  {
+    int64_t now = Simulator::Now ().GetTimeStep ();
+    if (m_lastRebuild >= 0 && now - m_lastRebuild < m_refresh.GetTimeStep ())
+      {
+        return;
+      }
+    m_lastRebuild = now;
+    m_lastRebuildTime = Simulator::Now ();
+    m_grid.clear ();
+    m_unplaced.clear ();
+    for (uint32_t i = 0; i < m_phys.size (); i++)
+      {
+        Ptr<MobilityModel> mobility = m_phys[i]->GetMobility ();
+        if (!mobility)
+          {
+            m_unplaced.push_back (i);
+            continue;
+          }
+        Vector position = mobility->GetPosition ();
+        m_grid[Key (Cell (position.x), Cell (position.y))].push_back (i);
+      }
+  }
+
+  double m_thresholdDbm;
+  double m_cellSize;
+  double m_maxSpeed;
+  Time m_refresh;
+  std::vector<Ptr<SpectrumPhy> > m_phys;
+  std::vector<uint32_t> m_unplaced;                             //!< Receivers without mobility
+  std::unordered_map<uint64_t, std::vector<uint32_t> > m_grid;  //!< Receivers of each cell
+  std::map<int64_t, double> m_ranges;                           //!< Range of each transmit power, in 0.01 dBm
+  int64_t m_lastRebuild;                                        //!< Time step of the last rebuild, -1 to force one
+  Time m_lastRebuildTime;
+  uint64_t m_candidates;
+  uint64_t m_deliveries;
+};
+
+NS_OBJECT_ENSURE_REGISTERED (GridSpectrumChannel);
+
+} // namespace ns3
+
+#endif /* GRID_SPECTRUM_CHANNEL_H */
@@ -0,0 +1,148 @@
+/*-*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+  Correlated shadowing whose memory doesn't grow with the positions the
+  mobile end devices visit: the values of a grid are drawn from a hash
+  whenever they are needed, so none of them is stored.
+ */
+#include "bounded-shadowing-loss-model.h"
+#include "ns3/log.h"
+#include "ns3/double.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace ns3
+{
+  namespace lorawan
+  {
+
+    NS_LOG_COMPONENT_DEFINE("BoundedShadowingPropagationLossModel");
+
+    NS_OBJECT_ENSURE_REGISTERED(BoundedShadowingPropagationLossModel);
+
+    TypeId
+    BoundedShadowingPropagationLossModel::GetTypeId(void)
+    {
+      static TypeId tid = TypeId("ns3::BoundedShadowingPropagationLossModel")
+        .SetParent<PropagationLossModel> ()
+        .AddConstructor<BoundedShadowingPropagationLossModel> ()
+        .SetGroupName("lorawan")
+        .AddAttribute("CorrelationDistance", "Step of the grid the shadowing is correlated over (m), more than 0",
+          DoubleValue(110),
+          MakeDoubleAccessor(&BoundedShadowingPropagationLossModel::m_correlationDistance),
+          MakeDoubleChecker<double> (std::numeric_limits<double>::min()))
+        .AddAttribute("Sigma", "Standard deviation of the shadowing (dB)",
+          DoubleValue(4),
+          MakeDoubleAccessor(&BoundedShadowingPropagationLossModel::m_sigma),
+          MakeDoubleChecker<double> (0));
+      return tid;
+    }
+
+    BoundedShadowingPropagationLossModel::BoundedShadowingPropagationLossModel(): m_correlationDistance(110),
+      m_sigma(4),
+      m_seeded(false),
+      m_seed(0)
+    {
+      NS_LOG_FUNCTION_NOARGS();
+      m_uniform = CreateObject<UniformRandomVariable> ();
+    }
+
+    BoundedShadowingPropagationLossModel::~BoundedShadowingPropagationLossModel()
+    {
+      NS_LOG_FUNCTION_NOARGS();
+    }
+
+    uint64_t
+    BoundedShadowingPropagationLossModel::Mix(uint64_t z)
+    {
+     	// Finalizer of splitmix64
+      z += 0x9e3779b97f4a7c15ULL;
+      z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+      z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+      return z ^ (z >> 31);
+    }
+
+    double
+    BoundedShadowingPropagationLossModel::GetVertexValue(Key key) const
+    {
+     	// The pair is unordered, so a link has the same loss both ways
+      if (key.bx < key.ax || (key.bx == key.ax && key.by < key.ay))
+      {
+        std::swap(key.ax, key.bx);
+        std::swap(key.ay, key.by);
+      }
+
+      uint64_t h = Mix(m_seed ^ Mix(uint64_t(uint32_t(key.ax)) << 32 | uint32_t(key.ay))
+        ^ Mix(~(uint64_t(uint32_t(key.bx)) << 32 | uint32_t(key.by))));
+      double u1 = ((Mix(h) >> 11) + 1) * (1.0 / 9007199254740992.0);
+      double u2 = (Mix(h + 1) >> 11) * (1.0 / 9007199254740992.0);
+     	// Box-Muller, u1 in (0, 1]
+      return std::sqrt(-2 * std::log(u1)) * std::cos(2 * M_PI * u2);
+    }
+
+    double
+    BoundedShadowingPropagationLossModel::DoCalcRxPower(double txPowerDbm, Ptr<MobilityModel> a,
+      Ptr<MobilityModel> b) const
+    {
+      if (!m_seeded)
+      {
+        m_seed = uint64_t(m_uniform->GetInteger(0, 0xffffffff)) << 32 | m_uniform->GetInteger(0, 0xffffffff);
+        m_seeded = true;
+      }
+
+      Vector positions[2] = { a->GetPosition(), b->GetPosition() };
+      int32_t cell[2][2];
+      double weights[2][4];
+      for (int end = 0; end < 2; end++)
+      {
+        double u = positions[end].x / m_correlationDistance;
+        double v = positions[end].y / m_correlationDistance;
+        cell[end][0] = int32_t(std::floor(u));
+        cell[end][1] = int32_t(std::floor(v));
+        double fx = u - cell[end][0];
+        double fy = v - cell[end][1];
+        weights[end][0] = (1 - fx) * (1 - fy);
+        weights[end][1] = fx * (1 - fy);
+        weights[end][2] = (1 - fx) * fy;
+        weights[end][3] = fx * fy;
+      }
+
+     	// Interpolating lowers the variance between the vertices, the norm
+     	// of the weights brings it back to sigma
+      double shadowing = 0;
+      double norm = 0;
+      for (int i = 0; i < 4; i++)
+      {
+        for (int j = 0; j < 4; j++)
+        {
+          double weight = weights[0][i] * weights[1][j];
+          if (weight == 0)
+          {
+            continue;
+          }
+          Key key;
+          key.ax = cell[0][0] + (i & 1);
+          key.ay = cell[0][1] + (i >> 1);
+          key.bx = cell[1][0] + (j & 1);
+          key.by = cell[1][1] + (j >> 1);
+          shadowing += weight * GetVertexValue(key);
+          norm += weight * weight;
+        }
+      }
+      shadowing *= m_sigma / std::sqrt(norm);
+
+      NS_LOG_DEBUG("Shadowing " << shadowing << " dB between " << positions[0] << " and " << positions[1]);
+      return txPowerDbm + shadowing;
+    }
+
+    int64_t
+    BoundedShadowingPropagationLossModel::DoAssignStreams(int64_t stream)
+    {
+      m_uniform->SetStream(stream);
+     	// The values drawn so far came from the old seed
+      m_seeded = false;
+      return 1;
+    }
+
+  }
+}
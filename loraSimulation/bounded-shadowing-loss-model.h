@@ -0,0 +1,70 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+  Correlated shadowing whose memory doesn't grow with the positions the
+  mobile end devices visit: the values of a grid are drawn from a hash
+  whenever they are needed, so none of them is stored.
+ */
+
+#ifndef BOUNDED_SHADOWING_LOSS_MODEL_H
+#define BOUNDED_SHADOWING_LOSS_MODEL_H
+
+#include "ns3/propagation-loss-model.h"
+#include "ns3/random-variable-stream.h"
+#include "ns3/mobility-model.h"
+
+namespace ns3 {
+namespace lorawan {
+
+/**
+ * Spatially correlated shadowing with bounded memory.
+ *
+ * Both ends of a link are placed on a grid of CorrelationDistance. Every
+ * pair of grid vertices, unordered so the loss of a link is the same both
+ * ways, has a standard normal value; the shadowing of a link is the
+ * bilinear interpolation over the four vertices around each end, scaled
+ * back to Sigma. Links whose ends are less than a grid step apart share
+ * vertices and are correlated; the correlation fades out over two steps,
+ * whichever end moves.
+ *
+ * The value of a vertex pair is a hash of the pair and of a seed drawn from
+ * the random stream of the model, so it never has to be stored: a value
+ * needed again is computed again, with a few multiplications, and comes
+ * back the same. The memory stays flat however far the devices travel.
+ */
+class BoundedShadowingPropagationLossModel : public PropagationLossModel
+{
+public:
+  static TypeId GetTypeId (void);
+
+  BoundedShadowingPropagationLossModel ();
+  virtual ~BoundedShadowingPropagationLossModel ();
+
+private:
+  struct Key
+  {
+    int32_t ax, ay, bx, by;
+  };
+
+  virtual double DoCalcRxPower (double txPowerDbm, Ptr<MobilityModel> a, Ptr<MobilityModel> b) const;
+
+  virtual int64_t DoAssignStreams (int64_t stream);
+
+  /**
+   * The standard normal value of a vertex pair, hashed from the seed
+   */
+  double GetVertexValue (Key key) const;
+
+  static uint64_t Mix (uint64_t z);
+
+  double m_correlationDistance;
+  double m_sigma;
+  Ptr<UniformRandomVariable> m_uniform;
+
+  mutable bool m_seeded;
+  mutable uint64_t m_seed;
+};
+
+} //namespace ns3
+
+}
+#endif /* BOUNDED_SHADOWING_LOSS_MODEL_H */
@@ -0,0 +1,223 @@
+/*-*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+  Generator of correlated bursts (alarm storms): when an event fires, every
+  end device inside a region sends an uplink shortly after it, with some
+  jitter and optional retries. Complements RandomPeriodicSender, which models
+  the independent background traffic.
+ */
+#include "burst-traffic-generator.h"
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+#include "ns3/uinteger.h"
+#include "ns3/double.h"
+#include "ns3/trace-source-accessor.h"
+#include "ns3/mobility-model.h"
+#include "ns3/lora-net-device.h"
+#include <algorithm>
+
+namespace ns3
+{
+  namespace lorawan
+  {
+
+    NS_LOG_COMPONENT_DEFINE("BurstTrafficGenerator");
+
+    NS_OBJECT_ENSURE_REGISTERED(BurstTrafficGenerator);
+
+    TypeId
+    BurstTrafficGenerator::GetTypeId(void)
+    {
+      static TypeId tid = TypeId("ns3::BurstTrafficGenerator")
+        .SetParent<Object> ()
+        .AddConstructor<BurstTrafficGenerator> ()
+        .SetGroupName("lorawan")
+        .AddAttribute("Jitter", "The sends of a burst are spread uniformly over this time",
+          TimeValue(Seconds(5)),
+          MakeTimeAccessor(&BurstTrafficGenerator::m_jitter),
+          MakeTimeChecker())
+        .AddAttribute("Retries", "How many times each device repeats its uplink",
+          UintegerValue(0),
+          MakeUintegerAccessor(&BurstTrafficGenerator::m_retries),
+          MakeUintegerChecker<uint32_t> ())
+        .AddAttribute("RetryInterval", "The time between the repetitions of a device",
+          TimeValue(Seconds(30)),
+          MakeTimeAccessor(&BurstTrafficGenerator::m_retryInterval),
+          MakeTimeChecker())
+        .AddAttribute("Granularity", "Sends due within this time are fired by the same dispatch event",
+          TimeValue(MilliSeconds(1)),
+          MakeTimeAccessor(&BurstTrafficGenerator::m_granularity),
+          MakeTimeChecker())
+        .AddTraceSource("Burst", "A burst started",
+          MakeTraceSourceAccessor(&BurstTrafficGenerator::m_burstTrace),
+          "ns3::lorawan::BurstTrafficGenerator::BurstTracedCallback");
+      return tid;
+    }
+
+    BurstTrafficGenerator::BurstTrafficGenerator(): m_center(Vector(0, 0, 0)),
+      m_radius(0),
+      m_pktSize(10),
+      m_bursts(0),
+      m_sent(0)
+    {
+      NS_LOG_FUNCTION_NOARGS();
+      m_jitterRV = CreateObject<UniformRandomVariable> ();
+      m_burstIntervalRV = CreateObject<ExponentialRandomVariable> ();
+    }
+
+    BurstTrafficGenerator::~BurstTrafficGenerator()
+    {
+      NS_LOG_FUNCTION_NOARGS();
+    }
+
+    void
+    BurstTrafficGenerator::SetDevices(NodeContainer devices)
+    {
+      m_devices = devices;
+      m_macs.clear();
+      for (NodeContainer::Iterator i = devices.Begin(); i != devices.End(); ++i)
+      {
+       	// Assumes there's only one device
+        Ptr<LoraNetDevice> loraNetDevice = (*i)->GetDevice(0)->GetObject<LoraNetDevice> ();
+        NS_ASSERT(loraNetDevice != 0);
+        m_macs.push_back(loraNetDevice->GetMac());
+      }
+    }
+
+    void
+    BurstTrafficGenerator::SetRegion(Vector center, double radius)
+    {
+      m_center = center;
+      m_radius = radius;
+    }
+
+    void
+    BurstTrafficGenerator::SetPacketSize(uint8_t size)
+    {
+      m_pktSize = size;
+    }
+
+    void
+    BurstTrafficGenerator::ScheduleBurst(Time at)
+    {
+      NS_LOG_FUNCTION(this << at);
+      Simulator::Schedule(at - Simulator::Now(), &BurstTrafficGenerator::Fire, this);
+    }
+
+    void
+    BurstTrafficGenerator::SchedulePoissonBursts(Time start, Time stop, Time meanInterval)
+    {
+      NS_LOG_FUNCTION(this << start << stop << meanInterval);
+      m_burstIntervalRV->SetAttribute("Mean", DoubleValue(meanInterval.GetSeconds()));
+      Time at = start + Seconds(m_burstIntervalRV->GetValue());
+      while (at < stop)
+      {
+        ScheduleBurst(at);
+        at += Seconds(m_burstIntervalRV->GetValue());
+      }
+    }
+
+    int64_t
+    BurstTrafficGenerator::AssignStreams(int64_t stream)
+    {
+      m_jitterRV->SetStream(stream);
+      m_burstIntervalRV->SetStream(stream + 1);
+      return 2;
+    }
+
+    uint32_t
+    BurstTrafficGenerator::GetBurstCount(void) const
+    {
+      return m_bursts;
+    }
+
+    uint64_t
+    BurstTrafficGenerator::GetSentPackets(void) const
+    {
+      return m_sent;
+    }
+
+    bool
+    BurstTrafficGenerator::HasPendingSends(void) const
+    {
+      return !m_pending.empty();
+    }
+
+    void
+    BurstTrafficGenerator::Fire(void)
+    {
+      NS_LOG_FUNCTION(this);
+
+      Time now = Simulator::Now();
+      uint32_t selected = 0;
+      for (uint32_t i = 0; i < m_devices.GetN(); i++)
+      {
+        if (m_radius > 0)
+        {
+          Vector position = m_devices.Get(i)->GetObject<MobilityModel> ()->GetPosition();
+          double dx = position.x - m_center.x;
+          double dy = position.y - m_center.y;
+          if (dx * dx + dy * dy > m_radius * m_radius)
+          {
+            continue;
+          }
+        }
+
+        selected++;
+        for (uint32_t attempt = 0; attempt <= m_retries; attempt++)
+        {
+          PendingSend send;
+          send.at = now + Seconds(attempt * m_retryInterval.GetSeconds() +
+            m_jitterRV->GetValue(0, m_jitter.GetSeconds()));
+          send.device = i;
+          m_pending.push_back(send);
+          std::push_heap(m_pending.begin(), m_pending.end(), LaterSend());
+        }
+      }
+
+      NS_LOG_DEBUG("Burst " << m_bursts << " involves " << selected << " devices");
+      m_burstTrace(m_bursts, selected);
+      m_bursts++;
+
+      UpdateDispatch();
+    }
+
+    void
+    BurstTrafficGenerator::Dispatch(void)
+    {
+      NS_LOG_FUNCTION(this);
+
+      Time horizon = Simulator::Now() + m_granularity;
+      while (!m_pending.empty() && m_pending.front().at <= horizon)
+      {
+        uint32_t device = m_pending.front().device;
+        std::pop_heap(m_pending.begin(), m_pending.end(), LaterSend());
+        m_pending.pop_back();
+
+        m_macs[device]->Send(Create<Packet> (m_pktSize));
+        m_sent++;
+      }
+
+      UpdateDispatch();
+    }
+
+    void
+    BurstTrafficGenerator::UpdateDispatch(void)
+    {
+      if (m_pending.empty())
+      {
+        return;
+      }
+
+      Time now = Simulator::Now();
+      Time next = std::max(m_pending.front().at, now);
+      if (m_dispatchEvent.IsRunning() && m_dispatchAt <= next)
+      {
+        return;
+      }
+
+      Simulator::Cancel(m_dispatchEvent);
+      m_dispatchAt = next;
+      m_dispatchEvent = Simulator::Schedule(next - now, &BurstTrafficGenerator::Dispatch, this);
+    }
+  }
+}
@@ -0,0 +1,155 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+  Generator of correlated bursts (alarm storms): when an event fires, every
+  end device inside a region sends an uplink shortly after it, with some
+  jitter and optional retries. Complements RandomPeriodicSender, which models
+  the independent background traffic.
+ */
+
+#ifndef BURST_TRAFFIC_GENERATOR_H
+#define BURST_TRAFFIC_GENERATOR_H
+
+#include "ns3/object.h"
+#include "ns3/nstime.h"
+#include "ns3/event-id.h"
+#include "ns3/vector.h"
+#include "ns3/node-container.h"
+#include "ns3/lorawan-mac.h"
+#include "ns3/random-variable-stream.h"
+#include "ns3/traced-callback.h"
+#include <vector>
+
+namespace ns3 {
+namespace lorawan {
+
+/**
+ * Fires correlated uplinks from the devices of a disc-shaped region.
+ *
+ * All the sends of all the bursts are kept in a single time-ordered heap and
+ * a single dispatch event is pending in the simulator at any time: a burst
+ * over thousands of devices costs one heap insertion per send instead of one
+ * Simulator::Schedule call per device, and the sends that fall in the same
+ * dispatch granularity are fired by the same event.
+ */
+class BurstTrafficGenerator : public Object
+{
+public:
+  BurstTrafficGenerator ();
+  ~BurstTrafficGenerator ();
+
+  static TypeId GetTypeId (void);
+
+  /**
+   * Set the devices that can take part in the bursts. Each node must have a
+   * LoraNetDevice as its first device.
+   */
+  void SetDevices (NodeContainer devices);
+
+  /**
+   * Restrict the bursts to the devices inside a disc. The positions are
+   * checked when each burst fires. A radius of zero selects every device.
+   */
+  void SetRegion (Vector center, double radius);
+
+  /**
+   * Set packet size
+   */
+  void SetPacketSize (uint8_t size);
+
+  /**
+   * Fire a burst at the given absolute time
+   */
+  void ScheduleBurst (Time at);
+
+  /**
+   * Fire bursts as a Poisson process between start and stop
+   */
+  void SchedulePoissonBursts (Time start, Time stop, Time meanInterval);
+
+  /**
+   * Use fixed streams for the random draws of this generator
+   *
+   * \returns the number of streams used
+   */
+  int64_t AssignStreams (int64_t stream);
+
+  uint32_t GetBurstCount (void) const;
+
+  uint64_t GetSentPackets (void) const;
+
+  /**
+   * \returns true if some send of a burst, or a retry, isn't made yet. The
+   * retries of a burst fired just before the senders stop come after them.
+   */
+  bool HasPendingSends (void) const;
+
+  /**
+   * TracedCallback signature for the start of a burst.
+   *
+   * \param [in] burstId The index of the burst
+   * \param [in] devices The number of devices taking part in it
+   */
+  typedef void (*BurstTracedCallback)(uint32_t burstId, uint32_t devices);
+
+private:
+  /**
+   * A send waiting in the dispatch heap
+   */
+  struct PendingSend
+  {
+    Time at;
+    uint32_t device;
+  };
+
+  struct LaterSend
+  {
+    bool operator() (const PendingSend &a, const PendingSend &b) const
+    {
+      return a.at > b.at;
+    }
+  };
+
+  /**
+   * Select the devices of the region and queue their sends
+   */
+  void Fire (void);
+
+  /**
+   * Send everything that is due and wait for the next send
+   */
+  void Dispatch (void);
+
+  /**
+   * Make sure the dispatch event fires for the earliest pending send
+   */
+  void UpdateDispatch (void);
+
+  NodeContainer m_devices;
+  std::vector<Ptr<LorawanMac> > m_macs;
+
+  Vector m_center;
+  double m_radius;
+
+  Time m_jitter;            //!< Sends are spread uniformly over this time
+  uint32_t m_retries;       //!< Extra sends of each device in a burst
+  Time m_retryInterval;     //!< Spacing between the sends of a device
+  Time m_granularity;       //!< Sends closer than this share a dispatch event
+  uint8_t m_pktSize;
+
+  std::vector<PendingSend> m_pending;
+  EventId m_dispatchEvent;
+  Time m_dispatchAt;
+
+  Ptr<UniformRandomVariable> m_jitterRV;
+  Ptr<ExponentialRandomVariable> m_burstIntervalRV;
+
+  uint32_t m_bursts;
+  uint64_t m_sent;
+
+  TracedCallback<uint32_t, uint32_t> m_burstTrace;
+};
+
+} //namespace ns3
+
+}
+#endif /* BURST_TRAFFIC_GENERATOR_H */
@@ -0,0 +1,162 @@
+/*-*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+  LoRa channel that doesn't deliver an uplink to the gateways that can't
+  decode it even in the best case, instead of scheduling a reception that
+  can only end under the sensitivity.
+ */
+#include "culled-lora-channel.h"
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+#include "ns3/double.h"
+#include "ns3/trace-source-accessor.h"
+#include "ns3/mobility-model.h"
+#include "ns3/node.h"
+#include "ns3/lora-net-device.h"
+#include "ns3/gateway-lora-phy.h"
+#include <algorithm>
+
+namespace ns3
+{
+  namespace lorawan
+  {
+
+    NS_LOG_COMPONENT_DEFINE("CulledLoraChannel");
+
+    NS_OBJECT_ENSURE_REGISTERED(CulledLoraChannel);
+
+    const double CulledLoraChannel::GATEWAY_SENSITIVITY[6] = { -130.0, -132.5, -135.0, -137.5, -140.0, -142.5 };
+
+    TypeId
+    CulledLoraChannel::GetTypeId(void)
+    {
+      static TypeId tid = TypeId("ns3::CulledLoraChannel")
+        .SetParent<LoraChannel> ()
+        .AddConstructor<CulledLoraChannel> ()
+        .SetGroupName("lorawan")
+        .AddAttribute("Margin", "Power (dB) added to the best-case power of a link before comparing "
+          "it with the sensitivity, for the gains of the random loss components",
+          DoubleValue(0),
+          MakeDoubleAccessor(&CulledLoraChannel::m_margin),
+          MakeDoubleChecker<double> ())
+        .AddTraceSource("CulledDeliveries",
+          "The number of gateways a packet was not delivered to",
+          MakeTraceSourceAccessor(&CulledLoraChannel::m_culledTrace),
+          "ns3::lorawan::CulledLoraChannel::CulledTracedCallback");
+      return tid;
+    }
+
+    CulledLoraChannel::CulledLoraChannel(): m_margin(0),
+      m_culled(0)
+    {
+      NS_LOG_FUNCTION_NOARGS();
+    }
+
+    CulledLoraChannel::CulledLoraChannel(Ptr<PropagationLossModel> loss, Ptr<PropagationDelayModel> delay):
+      LoraChannel(loss, delay),
+      m_delay(delay),
+      m_margin(0),
+      m_culled(0)
+    {
+      NS_LOG_FUNCTION(this << loss << delay);
+    }
+
+    CulledLoraChannel::~CulledLoraChannel()
+    {
+      NS_LOG_FUNCTION_NOARGS();
+    }
+
+    void
+    CulledLoraChannel::SetBestCaseLossModel(Ptr<PropagationLossModel> loss)
+    {
+      m_bestCaseLoss = loss;
+    }
+
+    uint64_t
+    CulledLoraChannel::GetCulledDeliveries(void) const
+    {
+      return m_culled;
+    }
+
+    void
+    CulledLoraChannel::UpdateReceivers(void) const
+    {
+      if (m_receivers.size() == GetNDevices())
+      {
+        return;
+      }
+      m_receivers.clear();
+      m_isGateway.clear();
+      for (uint32_t i = 0; i < GetNDevices(); i++)
+      {
+        Ptr<LoraNetDevice> device = GetDevice(i)->GetObject<LoraNetDevice> ();
+        m_receivers.push_back(device->GetPhy());
+        m_isGateway.push_back(DynamicCast<GatewayLoraPhy> (device->GetPhy()) != 0);
+      }
+    }
+
+    void
+    CulledLoraChannel::Send(Ptr<LoraPhy> sender, Ptr<Packet> packet, double txPowerDbm,
+      LoraTxParameters txParams, Time duration, double frequencyMHz) const
+    {
+      NS_LOG_FUNCTION(this << sender << packet << txPowerDbm << duration << frequencyMHz);
+
+      UpdateReceivers();
+      Ptr<MobilityModel> senderMobility = sender->GetMobility();
+      double sensitivity = GATEWAY_SENSITIVITY[std::min(std::max(int (txParams.sf), 7), 12) - 7];
+      uint32_t culled = 0;
+      for (uint32_t i = 0; i < m_receivers.size(); i++)
+      {
+        Ptr<LoraPhy> receiver = m_receivers[i];
+        if (receiver == sender)
+        {
+          continue;
+        }
+        Ptr<MobilityModel> receiverMobility = receiver->GetMobility();
+        if (m_isGateway[i] && m_bestCaseLoss
+          && m_bestCaseLoss->CalcRxPower(txPowerDbm, senderMobility, receiverMobility) + m_margin < sensitivity)
+        {
+          culled++;
+          continue;
+        }
+
+        // Same as LoraChannel from here
+        Time delay = m_delay->GetDelay(senderMobility, receiverMobility);
+        LoraChannelParameters parameters;
+        parameters.rxPowerDbm = GetRxPower(txPowerDbm, senderMobility, receiverMobility);
+        parameters.sf = txParams.sf;
+        parameters.duration = duration;
+        parameters.frequencyMHz = frequencyMHz;
+
+        uint32_t context = 0xffffffff;
+        Ptr<NetDevice> device = receiver->GetDevice();
+        if (device != 0 && device->GetNode() != 0)
+        {
+          context = device->GetNode()->GetId();
+        }
+       	// The same packet as the sender's: the trackers are keyed by it
+        Simulator::ScheduleWithContext(context, delay, &CulledLoraChannel::Deliver, this,
+          receiver, packet, parameters);
+      }
+
+      if (culled > 0)
+      {
+        m_culled += culled;
+        Simulator::ScheduleNow(&CulledLoraChannel::NotifyCulled, this, Ptr<const Packet> (packet), culled);
+      }
+    }
+
+    void
+    CulledLoraChannel::Deliver(Ptr<LoraPhy> phy, Ptr<Packet> packet, LoraChannelParameters parameters) const
+    {
+      phy->StartReceive(packet, parameters.rxPowerDbm, parameters.sf, parameters.duration,
+        parameters.frequencyMHz);
+    }
+
+    void
+    CulledLoraChannel::NotifyCulled(Ptr<const Packet> packet, uint32_t culled) const
+    {
+      m_culledTrace(packet, culled);
+    }
+
+  }
+}
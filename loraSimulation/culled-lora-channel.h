@@ -0,0 +1,94 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+  LoRa channel that doesn't deliver an uplink to the gateways that can't
+  decode it even in the best case, instead of scheduling a reception that
+  can only end under the sensitivity.
+ */
+
+#ifndef CULLED_LORA_CHANNEL_H
+#define CULLED_LORA_CHANNEL_H
+
+#include "ns3/lora-channel.h"
+#include "ns3/lora-phy.h"
+#include "ns3/propagation-loss-model.h"
+#include "ns3/propagation-delay-model.h"
+#include "ns3/traced-callback.h"
+#include <vector>
+
+namespace ns3 {
+namespace lorawan {
+
+/**
+ * LoraChannel that culls the gateways out of range.
+ *
+ * The best-case power of a link is computed with a deterministic loss
+ * model, the one of the channel without its random components (shadowing,
+ * building penetration), plus a margin. A gateway PHY whose best-case power
+ * is below the gateway sensitivity of the spreading factor of the packet
+ * doesn't get the packet; every other PHY gets it as from LoraChannel. The
+ * number of gateways culled for a packet is fired by the CulledDeliveries
+ * trace in an event scheduled for the time of the transmission, after the
+ * sender fired its own traces, so trackers waiting for an outcome from
+ * every gateway can count them as under the sensitivity.
+ */
+class CulledLoraChannel : public LoraChannel
+{
+public:
+  static TypeId GetTypeId (void);
+
+  CulledLoraChannel ();
+  CulledLoraChannel (Ptr<PropagationLossModel> loss, Ptr<PropagationDelayModel> delay);
+  virtual ~CulledLoraChannel ();
+
+  /**
+   * Set the deterministic loss model the best-case power is computed with.
+   * Without it nothing is culled.
+   */
+  void SetBestCaseLossModel (Ptr<PropagationLossModel> loss);
+
+  virtual void Send (Ptr<LoraPhy> sender, Ptr<Packet> packet, double txPowerDbm,
+                     LoraTxParameters txParams, Time duration, double frequencyMHz) const;
+
+  /**
+   * \returns the number of gateway deliveries that were skipped
+   */
+  uint64_t GetCulledDeliveries (void) const;
+
+  /**
+   * The gateway sensitivity (dBm) of SF7 to SF12, as in GatewayLoraPhy
+   */
+  static const double GATEWAY_SENSITIVITY[6];
+
+  /**
+   * TracedCallback signature for the gateways a packet was not delivered to.
+   *
+   * \param [in] packet The packet sent
+   * \param [in] culled The number of gateways skipped
+   */
+  typedef void (*CulledTracedCallback)(Ptr<const Packet> packet, uint32_t culled);
+
+private:
+  void Deliver (Ptr<LoraPhy> phy, Ptr<Packet> packet, LoraChannelParameters parameters) const;
+
+  void NotifyCulled (Ptr<const Packet> packet, uint32_t culled) const;
+
+  /**
+   * Refresh the receivers if devices were added since the last send
+   */
+  void UpdateReceivers (void) const;
+
+  Ptr<PropagationDelayModel> m_delay;
+  Ptr<PropagationLossModel> m_bestCaseLoss;
+  double m_margin;                                //!< dB added to the best-case power
+
+  mutable std::vector<Ptr<LoraPhy> > m_receivers;
+  mutable std::vector<bool> m_isGateway;
+  mutable uint64_t m_culled;
+
+  TracedCallback<Ptr<const Packet>, uint32_t> m_culledTrace;
+};
+
+} //namespace ns3
+
+}
+#endif /* CULLED_LORA_CHANNEL_H */
@@ -0,0 +1,218 @@
+/*-*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+  Stops the simulation as soon as the network has drained after the senders
+  stopped, instead of running until a fixed safety horizon.
+ */
+#include "drain-detector.h"
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+#include "ns3/lora-net-device.h"
+#include "ns3/end-device-lora-phy.h"
+#include "ns3/gateway-lora-phy.h"
+#include "ns3/logical-lora-channel-helper.h"
+#include <sstream>
+
+namespace ns3
+{
+  namespace lorawan
+  {
+
+    NS_LOG_COMPONENT_DEFINE("DrainDetector");
+
+    NS_OBJECT_ENSURE_REGISTERED(DrainDetector);
+
+    TypeId
+    DrainDetector::GetTypeId(void)
+    {
+      static TypeId tid = TypeId("ns3::DrainDetector")
+        .SetParent<Object> ()
+        .AddConstructor<DrainDetector> ()
+        .SetGroupName("lorawan")
+        .AddAttribute("CheckInterval", "The time between two checks of the network",
+          TimeValue(Seconds(1)),
+          MakeTimeAccessor(&DrainDetector::m_checkInterval),
+          MakeTimeChecker())
+        .AddAttribute("QuietTime", "Time without transmissions after which the class A "
+          "receive windows are considered closed",
+          TimeValue(Seconds(5)),
+          MakeTimeAccessor(&DrainDetector::m_quietTime),
+          MakeTimeChecker());
+      return tid;
+    }
+
+    DrainDetector::DrainDetector(): m_dutyCycleNode(0),
+      m_stopped(false)
+    {
+      NS_LOG_FUNCTION_NOARGS();
+    }
+
+    DrainDetector::~DrainDetector()
+    {
+      NS_LOG_FUNCTION_NOARGS();
+    }
+
+    void
+    DrainDetector::SetEndDevices(NodeContainer endDevices)
+    {
+      m_endDevices = endDevices;
+      for (NodeContainer::Iterator j = endDevices.Begin(); j != endDevices.End(); ++j)
+      {
+        Ptr<LoraNetDevice> loraNetDevice = (*j)->GetDevice(0)->GetObject<LoraNetDevice> ();
+        loraNetDevice->GetPhy()->TraceConnectWithoutContext("StartSending",
+          MakeCallback(&DrainDetector::NotifyActivity, this));
+      }
+    }
+
+    void
+    DrainDetector::SetGateways(NodeContainer gateways)
+    {
+      m_gateways = gateways;
+      for (NodeContainer::Iterator j = gateways.Begin(); j != gateways.End(); ++j)
+      {
+        Ptr<LoraNetDevice> loraNetDevice = (*j)->GetDevice(0)->GetObject<LoraNetDevice> ();
+        loraNetDevice->GetPhy()->TraceConnectWithoutContext("StartSending",
+          MakeCallback(&DrainDetector::NotifyActivity, this));
+      }
+    }
+
+    void
+    DrainDetector::SetPendingPacketsCallback(Callback<bool> pendingPackets)
+    {
+      m_pendingPackets = pendingPackets;
+    }
+
+    void
+    DrainDetector::Start(Time appStopTime)
+    {
+      NS_LOG_FUNCTION(this << appStopTime);
+      m_appStopTime = appStopTime;
+      m_reason = "the network was never checked";
+      m_dutyCycleEnd = appStopTime;
+      Simulator::Cancel(m_checkEvent);
+      Simulator::Schedule(appStopTime - Simulator::Now(), &DrainDetector::RecordDutyCycle, this);
+      m_checkEvent = Simulator::Schedule(appStopTime - Simulator::Now() + m_checkInterval,
+        &DrainDetector::Check, this);
+    }
+
+    void
+    DrainDetector::RecordDutyCycle(void)
+    {
+      NS_LOG_FUNCTION(this);
+      for (NodeContainer::Iterator j = m_endDevices.Begin(); j != m_endDevices.End(); ++j)
+      {
+        Ptr<LoraNetDevice> loraNetDevice = (*j)->GetDevice(0)->GetObject<LoraNetDevice> ();
+        LogicalLoraChannelHelper channelHelper = loraNetDevice->GetMac()->GetLogicalLoraChannelHelper();
+        std::vector<Ptr<LogicalLoraChannel> > channels = channelHelper.GetEnabledChannelList();
+        for (std::vector<Ptr<LogicalLoraChannel> >::iterator c = channels.begin(); c != channels.end(); ++c)
+        {
+          Time end = Simulator::Now() + channelHelper.GetWaitingTime(*c);
+          if (end > m_dutyCycleEnd)
+          {
+            m_dutyCycleEnd = end;
+            m_dutyCycleNode = (*j)->GetId();
+          }
+        }
+      }
+    }
+
+    bool
+    DrainDetector::HasStoppedEarly(void) const
+    {
+      return m_stopped;
+    }
+
+    Time
+    DrainDetector::GetStopTime(void) const
+    {
+      return m_stopTime;
+    }
+
+    std::string
+    DrainDetector::GetReason(void) const
+    {
+      return m_reason;
+    }
+
+    void
+    DrainDetector::NotifyActivity(Ptr<Packet const> packet, uint32_t systemId)
+    {
+      m_lastActivity = Simulator::Now();
+    }
+
+    void
+    DrainDetector::Check(void)
+    {
+      NS_LOG_FUNCTION(this);
+
+      std::string busy = GetBusyReason();
+      if (!busy.empty())
+      {
+        NS_LOG_DEBUG("Network still busy: " << busy);
+        m_reason = "still busy at the hard stop: " + busy;
+        m_checkEvent = Simulator::Schedule(m_checkInterval, &DrainDetector::Check, this);
+        return;
+      }
+
+      m_stopped = true;
+      m_stopTime = Simulator::Now();
+      std::ostringstream reason;
+      reason << "senders stopped at " << m_appStopTime.GetSeconds() <<
+        " s, no packet waiting for its outcome and no MAC/PHY activity since " <<
+        m_lastActivity.GetSeconds() << " s";
+      m_reason = reason.str();
+      NS_LOG_INFO("Stopping at " << m_stopTime.GetSeconds() << " s: " << m_reason);
+      Simulator::Stop();
+    }
+
+    std::string
+    DrainDetector::GetBusyReason(void) const
+    {
+      std::ostringstream busy;
+      Time now = Simulator::Now();
+
+      if (!m_pendingPackets.IsNull() && m_pendingPackets())
+      {
+        return "packets waiting for their outcome at the gateways";
+      }
+
+      if (now - m_lastActivity < m_quietTime)
+      {
+        busy << "last transmission at " << m_lastActivity.GetSeconds() << " s";
+        return busy.str();
+      }
+
+      for (NodeContainer::Iterator j = m_gateways.Begin(); j != m_gateways.End(); ++j)
+      {
+        Ptr<LoraNetDevice> loraNetDevice = (*j)->GetDevice(0)->GetObject<LoraNetDevice> ();
+        Ptr<GatewayLoraPhy> gwPhy = loraNetDevice->GetPhy()->GetObject<GatewayLoraPhy> ();
+        if (gwPhy->IsTransmitting())
+        {
+          busy << "gateway " << (*j)->GetId() << " is transmitting";
+          return busy.str();
+        }
+      }
+
+      for (NodeContainer::Iterator j = m_endDevices.Begin(); j != m_endDevices.End(); ++j)
+      {
+        Ptr<LoraNetDevice> loraNetDevice = (*j)->GetDevice(0)->GetObject<LoraNetDevice> ();
+        Ptr<EndDeviceLoraPhy> edPhy = loraNetDevice->GetPhy()->GetObject<EndDeviceLoraPhy> ();
+        if (edPhy->GetState() == EndDeviceLoraPhy::TX || edPhy->GetState() == EndDeviceLoraPhy::RX)
+        {
+          busy << "end device " << (*j)->GetId() << " PHY is active";
+          return busy.str();
+        }
+      }
+
+     	// A transmission postponed by the duty cycle before the senders stopped
+     	// may still be pending in a MAC
+      if (now < m_dutyCycleEnd)
+      {
+        busy << "end device " << m_dutyCycleNode << " may send a postponed transmission until " <<
+          m_dutyCycleEnd.GetSeconds() << " s";
+        return busy.str();
+      }
+
+      return "";
+    }
+  }
+}
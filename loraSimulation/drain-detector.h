@@ -0,0 +1,113 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+  Stops the simulation as soon as the network has drained after the senders
+  stopped, instead of running until a fixed safety horizon.
+ */
+
+#ifndef DRAIN_DETECTOR_H
+#define DRAIN_DETECTOR_H
+
+#include "ns3/object.h"
+#include "ns3/nstime.h"
+#include "ns3/event-id.h"
+#include "ns3/callback.h"
+#include "ns3/node-container.h"
+#include "ns3/packet.h"
+#include <string>
+
+namespace ns3 {
+namespace lorawan {
+
+/**
+ * Periodically checks, once the applications have stopped, whether anything
+ * can still happen in the LoRaWAN network: packets waiting for their outcome
+ * at the gateways, PHYs that are transmitting or receiving, MACs that may
+ * hold a transmission postponed by the duty cycle and class A receive
+ * windows that may still open after the last uplink. A MAC holds at most one
+ * postponed transmission, sent as soon as its duty cycle allows, so none can
+ * be left once the off time the devices had when the senders stopped is
+ * over; the off time of the transmissions made after that blocks nothing. When the network is
+ * idle it calls Simulator::Stop and remembers why.
+ */
+class DrainDetector : public Object
+{
+public:
+  DrainDetector ();
+  ~DrainDetector ();
+
+  static TypeId GetTypeId (void);
+
+  void SetEndDevices (NodeContainer endDevices);
+
+  void SetGateways (NodeContainer gateways);
+
+  /**
+   * Set the callback that tells whether the scenario is still waiting for
+   * the outcome of some packet
+   */
+  void SetPendingPacketsCallback (Callback<bool> pendingPackets);
+
+  /**
+   * Start checking once the applications stop
+   */
+  void Start (Time appStopTime);
+
+  /**
+   * \returns true if the simulation was stopped by this detector
+   */
+  bool HasStoppedEarly (void) const;
+
+  /**
+   * \returns the time at which the network was found idle
+   */
+  Time GetStopTime (void) const;
+
+  /**
+   * \returns why the simulation was stopped, or what was still busy at the
+   * last check
+   */
+  std::string GetReason (void) const;
+
+  /**
+   * Record a transmission. Connected to the StartSending trace of the PHYs
+   * given to SetEndDevices and SetGateways, it can also be connected to
+   * other senders sharing the channel.
+   */
+  void NotifyActivity (Ptr<Packet const> packet, uint32_t systemId);
+
+private:
+  void Check (void);
+
+  /**
+   * Record until when a transmission postponed before the senders stopped
+   * may still be sent
+   */
+  void RecordDutyCycle (void);
+
+  /**
+   * \returns an empty string if the network is idle, otherwise a description
+   * of what is still busy
+   */
+  std::string GetBusyReason (void) const;
+
+  NodeContainer m_endDevices;
+  NodeContainer m_gateways;
+  Callback<bool> m_pendingPackets;
+
+  Time m_checkInterval;   //!< Time between two checks
+  Time m_quietTime;       //!< Time without transmissions before declaring the network idle
+  Time m_appStopTime;
+  Time m_lastActivity;    //!< Start of the last transmission seen
+  Time m_dutyCycleEnd;    //!< End of the longest off time at the stop of the senders
+  uint32_t m_dutyCycleNode; //!< Node of the end device with that off time
+
+  EventId m_checkEvent;
+  bool m_stopped;
+  Time m_stopTime;
+  std::string m_reason;
+};
+
+} //namespace ns3
+
+}
+#endif /* DRAIN_DETECTOR_H */
@@ -0,0 +1,184 @@
+/*-*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+  Places the gateways of the scenario, on a hexagonal grid or on a layout
+  read from a file, and maps their node ids to dense slots for the outcome
+  bookkeeping.
+ */
+#include "gateway-deployment.h"
+#include "ns3/log.h"
+#include "ns3/double.h"
+#include "ns3/fatal-error.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+namespace ns3
+{
+  namespace lorawan
+  {
+
+    NS_LOG_COMPONENT_DEFINE("GatewayDeployment");
+
+    NS_OBJECT_ENSURE_REGISTERED(GatewayDeployment);
+
+    TypeId
+    GatewayDeployment::GetTypeId(void)
+    {
+      static TypeId tid = TypeId("ns3::GatewayDeployment")
+        .SetParent<Object> ()
+        .AddConstructor<GatewayDeployment> ()
+        .SetGroupName("lorawan")
+        .AddAttribute("Height", "Height of the gateways (m)",
+          DoubleValue(15),
+          MakeDoubleAccessor(&GatewayDeployment::m_height),
+          MakeDoubleChecker<double> (0));
+      return tid;
+    }
+
+    GatewayDeployment::GatewayDeployment(): m_height(15)
+    {
+      NS_LOG_FUNCTION_NOARGS();
+    }
+
+    GatewayDeployment::~GatewayDeployment()
+    {
+      NS_LOG_FUNCTION_NOARGS();
+    }
+
+    void
+    GatewayDeployment::SetSingle(uint32_t n)
+    {
+      m_positions.assign(n, Vector(0.0, 0.0, m_height));
+    }
+
+    void
+    GatewayDeployment::SetHexagonal(uint32_t n, double spacing)
+    {
+      NS_LOG_FUNCTION(this << n << spacing);
+
+     	// Axial coordinates (q, r): ring k holds the 6 k cells at distance k,
+     	// walked from (-k, k) along the six directions
+      static const int directions[6][2] = { { 1, 0 }, { 1, -1 }, { 0, -1 }, { -1, 0 }, { -1, 1 }, { 0, 1 } };
+      m_positions.clear();
+      m_positions.reserve(n);
+      if (n > 0)
+      {
+        m_positions.push_back(Vector(0.0, 0.0, m_height));
+      }
+      for (int k = 1; m_positions.size() < n; k++)
+      {
+        int q = -k;
+        int r = k;
+        for (int side = 0; side < 6 && m_positions.size() < n; side++)
+        {
+          for (int step = 0; step < k && m_positions.size() < n; step++)
+          {
+            m_positions.push_back(Vector(spacing * (q + r / 2.0), spacing * std::sqrt(3.0) / 2 * r, m_height));
+            q += directions[side][0];
+            r += directions[side][1];
+          }
+        }
+      }
+    }
+
+    double
+    GatewayDeployment::GetCoveringSpacing(uint32_t n, double radius)
+    {
+     	// A cell of a hexagonal grid of spacing d covers sqrt(3) / 2 d^2
+      return std::sqrt(2 * M_PI * radius * radius / (std::sqrt(3.0) * std::max<uint32_t>(n, 1)));
+    }
+
+    void
+    GatewayDeployment::LoadLayout(std::string filename)
+    {
+      NS_LOG_FUNCTION(this << filename);
+      std::ifstream in(filename.c_str());
+      if (!in)
+      {
+        NS_FATAL_ERROR("Can't read the gateway layout " << filename);
+      }
+      m_positions.clear();
+      std::string line;
+      while (std::getline(in, line))
+      {
+        if (line.empty() || line[0] == '#')
+        {
+          continue;
+        }
+        std::istringstream fields(line);
+        Vector position(0.0, 0.0, m_height);
+        if (!(fields >> position.x >> position.y))
+        {
+          NS_FATAL_ERROR("Bad line in the gateway layout " << filename << ": " << line);
+        }
+        fields >> position.z;
+        m_positions.push_back(position);
+      }
+      if (m_positions.empty())
+      {
+        NS_FATAL_ERROR("The gateway layout " << filename << " is empty");
+      }
+    }
+
+    uint32_t
+    GatewayDeployment::GetN(void) const
+    {
+      return m_positions.size();
+    }
+
+    Vector
+    GatewayDeployment::GetPosition(uint32_t slot) const
+    {
+      return m_positions.at(slot);
+    }
+
+    Ptr<ListPositionAllocator>
+    GatewayDeployment::GetPositionAllocator(void) const
+    {
+      Ptr<ListPositionAllocator> allocator = CreateObject<ListPositionAllocator> ();
+      for (uint32_t i = 0; i < m_positions.size(); i++)
+      {
+        allocator->Add(m_positions[i]);
+      }
+      return allocator;
+    }
+
+    void
+    GatewayDeployment::Register(NodeContainer gateways)
+    {
+      NS_LOG_FUNCTION(this);
+      NS_ASSERT_MSG(gateways.GetN() == m_positions.size(), "One node per gateway position is needed");
+
+      uint32_t maxId = 0;
+      for (NodeContainer::Iterator j = gateways.Begin(); j != gateways.End(); ++j)
+      {
+        maxId = std::max(maxId, (*j)->GetId());
+      }
+      m_slots.assign(gateways.GetN() > 0 ? maxId + 1 : 0, NO_SLOT);
+      for (uint32_t i = 0; i < gateways.GetN(); i++)
+      {
+        m_slots[gateways.Get(i)->GetId()] = i;
+      }
+
+      GatewayStats empty;
+      std::memset(&empty, 0, sizeof(empty));
+      m_stats.assign(gateways.GetN(), empty);
+    }
+
+    void
+    GatewayDeployment::WriteStats(std::string filename) const
+    {
+      std::ofstream out(filename.c_str(), std::ios::trunc);
+      out << "# slot x y z received interfered noMoreReceivers underSensitivity\n";
+      for (uint32_t i = 0; i < m_stats.size(); i++)
+      {
+        out << i << " " << m_positions[i].x << " " << m_positions[i].y << " " << m_positions[i].z
+            << " " << m_stats[i].received << " " << m_stats[i].interfered
+            << " " << m_stats[i].noMoreReceivers << " " << m_stats[i].underSensitivity << "\n";
+      }
+    }
+
+  }
+}
@@ -0,0 +1,120 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+  Places the gateways of the scenario, on a hexagonal grid or on a layout
+  read from a file, and maps their node ids to dense slots for the outcome
+  bookkeeping.
+ */
+
+#ifndef GATEWAY_DEPLOYMENT_H
+#define GATEWAY_DEPLOYMENT_H
+
+#include "ns3/object.h"
+#include "ns3/vector.h"
+#include "ns3/node-container.h"
+#include "ns3/position-allocator.h"
+#include <string>
+#include <vector>
+
+namespace ns3 {
+namespace lorawan {
+
+/**
+ * The positions of the gateways and a dense map from their node ids to
+ * slots 0..n-1.
+ *
+ * The slot of a node id is a lookup in a vector indexed by node id, so the
+ * reception callbacks don't assume that the gateway ids are contiguous or
+ * follow the end devices. Every slot keeps the outcomes of the packets seen
+ * by its gateway.
+ */
+class GatewayDeployment : public Object
+{
+public:
+  static constexpr uint32_t NO_SLOT = 0xffffffff;
+
+  /**
+   * Outcomes of the packets that reached a gateway
+   */
+  struct GatewayStats
+  {
+    uint32_t received;
+    uint32_t interfered;
+    uint32_t noMoreReceivers;
+    uint32_t underSensitivity;
+  };
+
+  GatewayDeployment ();
+  ~GatewayDeployment ();
+
+  static TypeId GetTypeId (void);
+
+  /**
+   * Place n gateways at the origin, as the scenario always did
+   */
+  void SetSingle (uint32_t n);
+
+  /**
+   * Place n gateways on a hexagonal grid centred on the origin, filling
+   * the rings outwards
+   *
+   * \param n The number of gateways
+   * \param spacing The distance between neighbouring gateways
+   */
+  void SetHexagonal (uint32_t n, double spacing);
+
+  /**
+   * \returns the spacing of a hexagonal grid of n gateways whose cells
+   * cover a disc of the given radius
+   */
+  static double GetCoveringSpacing (uint32_t n, double radius);
+
+  /**
+   * Read the positions from a file with one "x y" or "x y z" line per
+   * gateway; lines starting with # are skipped. A missing z is the height.
+   */
+  void LoadLayout (std::string filename);
+
+  uint32_t GetN (void) const;
+
+  Vector GetPosition (uint32_t slot) const;
+
+  /**
+   * \returns an allocator handing out the positions in slot order
+   */
+  Ptr<ListPositionAllocator> GetPositionAllocator (void) const;
+
+  /**
+   * Map the node ids of the gateways, installed in slot order, to their
+   * slots and clear the statistics
+   */
+  void Register (NodeContainer gateways);
+
+  /**
+   * \returns the slot of a gateway node, NO_SLOT if it isn't one
+   */
+  uint32_t GetSlot (uint32_t nodeId) const
+  {
+    return nodeId < m_slots.size () ? m_slots[nodeId] : NO_SLOT;
+  }
+
+  GatewayStats &GetStats (uint32_t slot)
+  {
+    return m_stats[slot];
+  }
+
+  /**
+   * Write the position and the statistics of every gateway, one line each
+   */
+  void WriteStats (std::string filename) const;
+
+private:
+  double m_height;                    //!< Height of the gateways placed on the ground plan
+  std::vector<Vector> m_positions;
+  std::vector<uint32_t> m_slots;      //!< Slot of each node id
+  std::vector<GatewayStats> m_stats;
+};
+
+} //namespace ns3
+
+}
+#endif /* GATEWAY_DEPLOYMENT_H */
@@ -0,0 +1,274 @@
+/*-*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+  Gateway PHY whose interference check looks up the receptions overlapping a
+  packet in an index per (frequency, spreading factor) instead of scanning
+  every event the gateway heard.
+ */
+#include "indexed-gateway-lora-phy.h"
+#include "culled-lora-channel.h"
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+#include "ns3/node.h"
+#include "ns3/lora-tag.h"
+#include "ns3/lorawan-mac.h"
+#include <algorithm>
+#include <cmath>
+
+namespace ns3
+{
+  namespace lorawan
+  {
+
+    NS_LOG_COMPONENT_DEFINE("IndexedGatewayLoraPhy");
+
+    NS_OBJECT_ENSURE_REGISTERED(IndexedGatewayLoraPhy);
+
+    IntervalInterference::IntervalInterference(): m_longest(Seconds(0)),
+      m_nextClean(Seconds(0)),
+      m_nEvents(0)
+    {
+     	// The same matrix the LoraInterferenceHelper of a SimpleGatewayLoraPhy
+     	// would be built with
+      if (LoraInterferenceHelper::collisionMatrix == LoraInterferenceHelper::ALOHA)
+      {
+        m_collisionSnir = LoraInterferenceHelper::collisionSnirAloha;
+      }
+      else
+      {
+        m_collisionSnir = LoraInterferenceHelper::collisionSnirGoursaud;
+      }
+    }
+
+    bool
+    IntervalInterference::StartsBefore(const Interval &interval, Time time)
+    {
+      return interval.start < time;
+    }
+
+    void
+    IntervalInterference::Add(Ptr<LoraInterferenceHelper::Event> event)
+    {
+      Interval interval;
+      interval.start = event->GetStartTime();
+      interval.end = event->GetEndTime();
+      interval.powerW = std::pow(10.0, event->GetRxPowerdBm() / 10) / 1000;
+      interval.event = event;
+
+      Index &index = m_indices[std::make_pair(event->GetFrequency(), event->GetSpreadingFactor())];
+      NS_ASSERT_MSG(index.intervals.empty() || index.intervals.back().start <= interval.start,
+        "Events have to be added when they start");
+      index.intervals.push_back(interval);
+      index.longest = std::max(index.longest, event->GetDuration());
+      m_longest = std::max(m_longest, event->GetDuration());
+      m_nEvents++;
+
+      if (Simulator::Now() >= m_nextClean)
+      {
+        CleanOldEvents();
+      }
+    }
+
+    void
+    IntervalInterference::CleanOldEvents(void)
+    {
+     	// A reception still running started at most m_longest ago, so what
+     	// ended before that can't overlap it
+      Time threshold = Simulator::Now() - m_longest;
+      for (IndexMap::iterator it = m_indices.begin(); it != m_indices.end(); it++)
+      {
+        std::deque<Interval> &intervals = it->second.intervals;
+        while (!intervals.empty() && intervals.front().end < threshold)
+        {
+          intervals.pop_front();
+          m_nEvents--;
+        }
+      }
+      m_nextClean = Simulator::Now() + m_longest;
+    }
+
+    uint8_t
+    IntervalInterference::IsDestroyedByInterference(Ptr<LoraInterferenceHelper::Event> event) const
+    {
+      NS_LOG_FUNCTION(this << event);
+
+      Time start = event->GetStartTime();
+      Time end = event->GetEndTime();
+      uint8_t sf = event->GetSpreadingFactor();
+      double frequency = event->GetFrequency();
+
+      double signalEnergy = event->GetDuration().GetSeconds() * std::pow(10.0, event->GetRxPowerdBm() / 10) / 1000;
+      for (uint8_t currentSf = 7; currentSf <= 12; currentSf++)
+      {
+        IndexMap::const_iterator it = m_indices.find(std::make_pair(frequency, currentSf));
+        if (it == m_indices.end())
+        {
+          continue;
+        }
+        const std::deque<Interval> &intervals = it->second.intervals;
+        std::deque<Interval>::const_iterator first = std::lower_bound(intervals.begin(), intervals.end(),
+          start - it->second.longest, &IntervalInterference::StartsBefore);
+        std::deque<Interval>::const_iterator last = std::lower_bound(first, intervals.end(), end,
+          &IntervalInterference::StartsBefore);
+
+        double interferenceEnergy = 0;
+        for (std::deque<Interval>::const_iterator interval = first; interval != last; interval++)
+        {
+          if (interval->event == event || interval->end <= start)
+          {
+            continue;
+          }
+          Time overlap = std::min(end, interval->end) - std::max(start, interval->start);
+          interferenceEnergy += overlap.GetSeconds() * interval->powerW;
+        }
+
+        double snir = 10 * std::log10(signalEnergy / interferenceEnergy);
+        if (snir < m_collisionSnir[sf - 7][currentSf - 7])
+        {
+          NS_LOG_DEBUG("Packet destroyed by SF" << unsigned(currentSf) << ", SIR " << snir << " dB");
+          return currentSf;
+        }
+      }
+      return 0;
+    }
+
+    uint32_t
+    IntervalInterference::GetNEvents(void) const
+    {
+      return m_nEvents;
+    }
+
+    void
+    IntervalInterference::Clear(void)
+    {
+      m_indices.clear();
+      m_longest = Seconds(0);
+      m_nextClean = Seconds(0);
+      m_nEvents = 0;
+    }
+
+    TypeId
+    IndexedGatewayLoraPhy::GetTypeId(void)
+    {
+      static TypeId tid = TypeId("ns3::IndexedGatewayLoraPhy")
+        .SetParent<SimpleGatewayLoraPhy> ()
+        .AddConstructor<IndexedGatewayLoraPhy> ()
+        .SetGroupName("lorawan");
+      return tid;
+    }
+
+    IndexedGatewayLoraPhy::IndexedGatewayLoraPhy()
+    {
+      NS_LOG_FUNCTION_NOARGS();
+    }
+
+    IndexedGatewayLoraPhy::~IndexedGatewayLoraPhy()
+    {
+      NS_LOG_FUNCTION_NOARGS();
+    }
+
+    Ptr<IndexedGatewayLoraPhy>
+    IndexedGatewayLoraPhy::Replace(Ptr<LoraNetDevice> device)
+    {
+      Ptr<LoraPhy> old = device->GetPhy();
+      Ptr<IndexedGatewayLoraPhy> phy = CreateObject<IndexedGatewayLoraPhy> ();
+      phy->SetChannel(old->GetChannel());
+      phy->SetMobility(old->GetMobility());
+      phy->SetDevice(device);
+     	// Same reception paths as LoraPhyHelper gives a gateway
+      for (int i = 0; i < 8; i++)
+      {
+        phy->AddReceptionPath();
+      }
+      device->SetPhy(phy);
+      device->GetMac()->SetPhy(phy);
+      return phy;
+    }
+
+    void
+    IndexedGatewayLoraPhy::StartReceive(Ptr<Packet> packet, double rxPowerDbm, uint8_t sf,
+      Time duration, double frequencyMHz)
+    {
+      NS_LOG_FUNCTION(this << packet << rxPowerDbm << duration << frequencyMHz);
+
+     	// Same as SimpleGatewayLoraPhy, with the event in the index
+      m_phyRxBeginTrace(packet);
+      uint32_t nodeId = m_device ? m_device->GetNode()->GetId() : 0;
+
+      if (m_isTransmitting)
+      {
+        NS_LOG_INFO("Dropping packet reception of packet with sf = " << unsigned(sf) << " because we are in TX mode");
+        m_phyRxEndTrace(packet);
+        m_noReceptionBecauseTransmitting(packet, nodeId);
+        return;
+      }
+
+      Ptr<LoraInterferenceHelper::Event> event =
+        Create<LoraInterferenceHelper::Event> (duration, rxPowerDbm, sf, packet, frequencyMHz);
+      m_index.Add(event);
+
+      std::list<Ptr<GatewayLoraPhy::ReceptionPath> >::iterator it;
+      for (it = m_receptionPaths.begin(); it != m_receptionPaths.end(); ++it)
+      {
+        Ptr<GatewayLoraPhy::ReceptionPath> currentPath = *it;
+        if (!currentPath->IsAvailable())
+        {
+          continue;
+        }
+        if (rxPowerDbm < CulledLoraChannel::GATEWAY_SENSITIVITY[unsigned(sf) - 7])
+        {
+          NS_LOG_INFO("Dropping packet reception of packet with sf = " << unsigned(sf) << " because under the sensitivity");
+          m_underSensitivity(packet, nodeId);
+          return;
+        }
+        currentPath->LockOnEvent(event);
+        m_occupiedReceptionPaths++;
+        EventId endReceiveEventId = Simulator::Schedule(duration, &LoraPhy::EndReceive, this, packet, event);
+        currentPath->SetEndReceive(endReceiveEventId);
+        return;
+      }
+      m_noMoreDemodulators(packet, nodeId);
+    }
+
+    void
+    IndexedGatewayLoraPhy::EndReceive(Ptr<Packet> packet, Ptr<LoraInterferenceHelper::Event> event)
+    {
+      NS_LOG_FUNCTION(this << packet << event);
+
+      m_phyRxEndTrace(packet);
+      uint32_t nodeId = m_device ? m_device->GetNode()->GetId() : 0;
+
+      if (m_index.IsDestroyedByInterference(event) != 0)
+      {
+        m_interferedPacket(packet, nodeId);
+      }
+      else
+      {
+        m_successfullyReceivedPacket(packet, nodeId);
+
+        LoraTag tag;
+        packet->RemovePacketTag(tag);
+        tag.SetReceptionPower(event->GetRxPowerdBm());
+        tag.SetFrequency(event->GetFrequency());
+        packet->AddPacketTag(tag);
+
+        if (!m_rxOkCallback.IsNull())
+        {
+          m_rxOkCallback(packet);
+        }
+      }
+
+      std::list<Ptr<GatewayLoraPhy::ReceptionPath> >::iterator it;
+      for (it = m_receptionPaths.begin(); it != m_receptionPaths.end(); ++it)
+      {
+        Ptr<GatewayLoraPhy::ReceptionPath> currentPath = *it;
+        if (currentPath->GetEvent() == event)
+        {
+          currentPath->Free();
+          m_occupiedReceptionPaths--;
+          return;
+        }
+      }
+    }
+
+  }
+}
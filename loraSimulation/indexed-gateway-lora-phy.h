@@ -0,0 +1,114 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+  Gateway PHY whose interference check looks up the receptions overlapping a
+  packet in an index per (frequency, spreading factor) instead of scanning
+  every event the gateway heard.
+ */
+
+#ifndef INDEXED_GATEWAY_LORA_PHY_H
+#define INDEXED_GATEWAY_LORA_PHY_H
+
+#include "ns3/simple-gateway-lora-phy.h"
+#include "ns3/lora-interference-helper.h"
+#include "ns3/lora-net-device.h"
+#include "ns3/nstime.h"
+#include <deque>
+#include <map>
+#include <utility>
+
+namespace ns3 {
+namespace lorawan {
+
+/**
+ * The interference model of LoraInterferenceHelper, on indexed events. The
+ * collision matrix is the one LoraInterferenceHelper::collisionMatrix
+ * selects when the index is built, Goursaud or ALOHA.
+ *
+ * The events of each (frequency, spreading factor) are kept in a deque
+ * sorted by start time, with the longest duration seen. The events that
+ * overlap [s, e] start in [s - longest, e), a range found by binary search,
+ * so a check costs a logarithmic search plus the overlapping events in each
+ * of the six indices of the frequency. Events are added when they start, so
+ * the deques only grow at the back; the events that ended before any
+ * reception still running could have started are dropped from the front of
+ * every deque in one sweep, once per longest duration.
+ */
+class IntervalInterference
+{
+public:
+  IntervalInterference ();
+
+  void Add (Ptr<LoraInterferenceHelper::Event> event);
+
+  /**
+   * \returns 0 if the event survives the interference of the others, the
+   * spreading factor of the interferers that destroyed it otherwise
+   */
+  uint8_t IsDestroyedByInterference (Ptr<LoraInterferenceHelper::Event> event) const;
+
+  uint32_t GetNEvents (void) const;
+
+  void Clear (void);
+
+private:
+  struct Interval
+  {
+    Time start;
+    Time end;
+    double powerW;
+    Ptr<LoraInterferenceHelper::Event> event;
+  };
+
+  struct Index
+  {
+    std::deque<Interval> intervals;   //!< Sorted by start
+    Time longest;                     //!< Longest duration among the intervals
+  };
+
+  typedef std::map<std::pair<double, uint8_t>, Index> IndexMap;
+
+  static bool StartsBefore (const Interval &interval, Time time);
+
+  void CleanOldEvents (void);
+
+  IndexMap m_indices;
+  Time m_longest;                     //!< Longest duration of any event
+  Time m_nextClean;
+  uint32_t m_nEvents;
+  const double (*m_collisionSnir)[6]; //!< Minimum SIR (dB) of the row SF against interferers of the column SF
+};
+
+/**
+ * SimpleGatewayLoraPhy with the same reception paths and trace sources,
+ * deciding the interference with an IntervalInterference.
+ */
+class IndexedGatewayLoraPhy : public SimpleGatewayLoraPhy
+{
+public:
+  static TypeId GetTypeId (void);
+
+  IndexedGatewayLoraPhy ();
+  virtual ~IndexedGatewayLoraPhy ();
+
+  /**
+   * Replace the PHY that LoraHelper installed on a gateway device: the new
+   * one gets its channel, mobility and eight reception paths, and the MAC is
+   * moved to it. The old PHY stays registered in the channel, so this needs
+   * a channel delivering to the PHY of each device, as CulledLoraChannel
+   * does; the trace sources of the new PHY have to be connected again.
+   */
+  static Ptr<IndexedGatewayLoraPhy> Replace (Ptr<LoraNetDevice> device);
+
+  virtual void StartReceive (Ptr<Packet> packet, double rxPowerDbm, uint8_t sf,
+                             Time duration, double frequencyMHz);
+
+  virtual void EndReceive (Ptr<Packet> packet, Ptr<LoraInterferenceHelper::Event> event);
+
+private:
+  IntervalInterference m_index;
+};
+
+} //namespace ns3
+
+}
+#endif /* INDEXED_GATEWAY_LORA_PHY_H */
@@ -0,0 +1,322 @@
+/*-*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+  Ladder queue event scheduler: the far future is kept unsorted and split
+  into buckets whose width follows the spread of the events, so only the
+  events about to run are ever sorted.
+ */
+#include "ladder-scheduler.h"
+#include "ns3/log.h"
+#include "ns3/uinteger.h"
+#include "ns3/assert.h"
+#include <algorithm>
+#include <limits>
+
+namespace ns3
+{
+  namespace lorawan
+  {
+
+    NS_LOG_COMPONENT_DEFINE("LadderScheduler");
+
+    NS_OBJECT_ENSURE_REGISTERED(LadderScheduler);
+
+    TypeId
+    LadderScheduler::GetTypeId(void)
+    {
+      static TypeId tid = TypeId("ns3::LadderScheduler")
+        .SetParent<Scheduler> ()
+        .AddConstructor<LadderScheduler> ()
+        .SetGroupName("lorawan")
+        .AddAttribute("Threshold", "Events a bucket can hold before it is split into a finer rung "
+          "instead of being sorted",
+          UintegerValue(50),
+          MakeUintegerAccessor(&LadderScheduler::m_threshold),
+          MakeUintegerChecker<uint32_t> (1))
+        .AddAttribute("MaxRungs", "Maximum number of rungs of the ladder",
+          UintegerValue(8),
+          MakeUintegerAccessor(&LadderScheduler::m_maxRungs),
+          MakeUintegerChecker<uint32_t> (1));
+      return tid;
+    }
+
+    LadderScheduler::LadderScheduler(): m_threshold(50),
+      m_maxRungs(8),
+      m_topStart(0),
+      m_topMin(std::numeric_limits<uint64_t>::max()),
+      m_topMax(0),
+      m_bottomHead(0),
+      m_size(0)
+    {
+      NS_LOG_FUNCTION_NOARGS();
+    }
+
+    LadderScheduler::~LadderScheduler()
+    {
+      NS_LOG_FUNCTION_NOARGS();
+    }
+
+    bool
+    LadderScheduler::Earlier(const Event &a, const Event &b)
+    {
+      return a.key < b.key;
+    }
+
+    void
+    LadderScheduler::Insert(const Event &ev)
+    {
+      NS_LOG_FUNCTION(this << ev.impl << ev.key.m_ts << ev.key.m_uid);
+      m_size++;
+      uint64_t ts = ev.key.m_ts;
+      if (ts >= m_topStart)
+      {
+        m_top.push_back(ev);
+        m_topMin = std::min(m_topMin, ts);
+        m_topMax = std::max(m_topMax, ts);
+      }
+      else
+      {
+        std::vector<Event> *events = 0;
+        for (uint32_t i = 0; i < m_rungs.size() && events == 0; i++)
+        {
+          Rung &rung = m_rungs[i];
+          if (ts >= rung.GetCurrentStart())
+          {
+           	// Past the end of a finer rung is still before the current bucket
+           	// of the coarser one, so the last bucket keeps the order
+            events = &rung.buckets[std::min<uint64_t>((ts - rung.start) / rung.width, rung.buckets.size() - 1)];
+          }
+        }
+        if (events)
+        {
+          events->push_back(ev);
+        }
+        else if (m_bottom.size() - m_bottomHead >= 4 * m_threshold && m_rungs.size() < m_maxRungs
+                 && m_bottom[m_bottomHead].key.m_ts < m_bottom.back().key.m_ts)
+        {
+         	// A burst landing before the ladder, as the deliveries of a send
+         	// to every PHY: Bottom becomes the finest rung rather than
+         	// growing by sorted insertions. Smaller bursts are cheaper to
+         	// insert than to spread
+          SpillBottom();
+          m_size--;
+          Insert(ev);
+          return;
+        }
+        else
+        {
+          InsertBottom(ev);
+        }
+      }
+     	// The queue was empty: the earliest event has to reach Bottom
+      if (IsBottomEmpty())
+      {
+        Refill();
+      }
+    }
+
+    void
+    LadderScheduler::InsertBottom(const Event &ev)
+    {
+     	// Bottom runs from the next event to the last one: an event later than
+     	// the others is appended
+      std::vector<Event>::iterator it = std::upper_bound(m_bottom.begin() + m_bottomHead, m_bottom.end(), ev,
+        &LadderScheduler::Earlier);
+      m_bottom.insert(it, ev);
+    }
+
+    void
+    LadderScheduler::SpillBottom(void)
+    {
+      std::vector<Event> events(m_bottom.begin() + m_bottomHead, m_bottom.end());
+      ClearBottom();
+      uint64_t first = events.front().key.m_ts;
+      uint64_t last = events.back().key.m_ts;
+     	// About eight events a bucket, a bucket costs an allocation
+      uint64_t width = (last - first) * 8 / events.size() + 1;
+      SpawnRung(events, first, width, (last - first) / width + 1);
+    }
+
+    bool
+    LadderScheduler::IsBottomEmpty(void) const
+    {
+      return m_bottomHead == m_bottom.size();
+    }
+
+    void
+    LadderScheduler::ClearBottom(void)
+    {
+      m_bottom.clear();
+      m_bottomHead = 0;
+    }
+
+    bool
+    LadderScheduler::IsEmpty(void) const
+    {
+      return m_size == 0;
+    }
+
+    Scheduler::Event
+    LadderScheduler::PeekNext(void) const
+    {
+      NS_ASSERT(!IsBottomEmpty());
+      return m_bottom[m_bottomHead];
+    }
+
+    Scheduler::Event
+    LadderScheduler::RemoveNext(void)
+    {
+      NS_ASSERT(!IsBottomEmpty());
+      Event ev = m_bottom[m_bottomHead++];
+      m_size--;
+      if (IsBottomEmpty())
+      {
+        ClearBottom();
+        Refill();
+      }
+      return ev;
+    }
+
+    void
+    LadderScheduler::Remove(const Event &ev)
+    {
+      NS_LOG_FUNCTION(this << ev.impl << ev.key.m_ts << ev.key.m_uid);
+      uint64_t ts = ev.key.m_ts;
+      std::vector<Event> *events = &m_bottom;
+      if (ts >= m_topStart)
+      {
+        events = &m_top;
+      }
+      else
+      {
+        for (uint32_t i = 0; i < m_rungs.size(); i++)
+        {
+          Rung &rung = m_rungs[i];
+          if (ts >= rung.GetCurrentStart())
+          {
+            events = &rung.buckets[std::min<uint64_t>((ts - rung.start) / rung.width, rung.buckets.size() - 1)];
+            break;
+          }
+        }
+      }
+
+      if (events == &m_bottom)
+      {
+        std::vector<Event>::iterator it = std::lower_bound(m_bottom.begin() + m_bottomHead, m_bottom.end(), ev,
+          &LadderScheduler::Earlier);
+        NS_ASSERT_MSG(it != m_bottom.end() && it->key.m_uid == ev.key.m_uid, "Event not scheduled");
+        m_bottom.erase(it);
+      }
+      else
+      {
+       	// Top and the buckets are unsorted: the last event fills the hole
+        std::vector<Event>::iterator it = events->begin();
+        while (it != events->end() && it->key.m_uid != ev.key.m_uid)
+        {
+          it++;
+        }
+        NS_ASSERT_MSG(it != events->end(), "Event not scheduled");
+        *it = events->back();
+        events->pop_back();
+      }
+      m_size--;
+      if (IsBottomEmpty())
+      {
+        ClearBottom();
+        Refill();
+      }
+    }
+
+    void
+    LadderScheduler::SpawnRung(std::vector<Event> &events, uint64_t start, uint64_t width, uint32_t nBuckets)
+    {
+      NS_LOG_FUNCTION(this << events.size() << start << width << nBuckets);
+      m_rungs.push_back(Rung());
+      Rung &rung = m_rungs.back();
+      rung.start = start;
+      rung.width = width;
+      rung.current = 0;
+      rung.buckets.resize(nBuckets);
+      for (std::vector<Event>::const_iterator it = events.begin(); it != events.end(); it++)
+      {
+        uint64_t bucket = std::min<uint64_t>((it->key.m_ts - start) / width, nBuckets - 1);
+        rung.buckets[bucket].push_back(*it);
+      }
+      events.clear();
+    }
+
+    void
+    LadderScheduler::Refill(void)
+    {
+      while (IsBottomEmpty() && m_size > 0)
+      {
+        if (m_rungs.empty())
+        {
+          NS_ASSERT(!m_top.empty());
+          uint64_t spread = m_topMax - m_topMin;
+          if (m_top.size() <= m_threshold || spread == 0)
+          {
+            m_topStart = m_topMax + 1;
+            ClearBottom();
+            m_bottom.swap(m_top);
+            std::sort(m_bottom.begin(), m_bottom.end(), &LadderScheduler::Earlier);
+          }
+          else
+          {
+           	// About one event per bucket, whatever the spread of Top
+            uint64_t width = spread / m_top.size() + 1;
+            uint32_t nBuckets = spread / width + 1;
+            m_topStart = m_topMin + nBuckets * width;
+            SpawnRung(m_top, m_topMin, width, nBuckets);
+          }
+          m_topMin = std::numeric_limits<uint64_t>::max();
+          m_topMax = 0;
+          continue;
+        }
+
+        Rung &rung = m_rungs.back();
+        while (rung.current < rung.buckets.size() && rung.buckets[rung.current].empty())
+        {
+          rung.current++;
+        }
+        if (rung.current == rung.buckets.size())
+        {
+          m_rungs.pop_back();
+          continue;
+        }
+        std::vector<Event> bucket;
+        bucket.swap(rung.buckets[rung.current]);
+        rung.current++;
+       	// A rung goes as soon as it is used up, so nothing is inserted behind
+       	// its current bucket
+        while (rung.current < rung.buckets.size() && rung.buckets[rung.current].empty())
+        {
+          rung.current++;
+        }
+        if (rung.current == rung.buckets.size())
+        {
+          m_rungs.pop_back();
+        }
+
+        uint64_t bucketMin = std::numeric_limits<uint64_t>::max();
+        uint64_t bucketMax = 0;
+        for (std::vector<Event>::const_iterator it = bucket.begin(); it != bucket.end(); it++)
+        {
+          bucketMin = std::min(bucketMin, it->key.m_ts);
+          bucketMax = std::max(bucketMax, it->key.m_ts);
+        }
+        if (bucket.size() > m_threshold && bucketMax > bucketMin && m_rungs.size() < m_maxRungs)
+        {
+         	// The new rung starts at the earliest event, what comes before it
+         	// goes to Bottom
+          uint64_t width = (bucketMax - bucketMin) / bucket.size() + 1;
+          SpawnRung(bucket, bucketMin, width, (bucketMax - bucketMin) / width + 1);
+          continue;
+        }
+        ClearBottom();
+        m_bottom.swap(bucket);
+        std::sort(m_bottom.begin(), m_bottom.end(), &LadderScheduler::Earlier);
+      }
+    }
+
+  }
+}
@@ -0,0 +1,107 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+  Ladder queue event scheduler: the far future is kept unsorted and split
+  into buckets whose width follows the spread of the events, so only the
+  events about to run are ever sorted.
+ */
+
+#ifndef LADDER_SCHEDULER_H
+#define LADDER_SCHEDULER_H
+
+#include "ns3/scheduler.h"
+#include <vector>
+
+namespace ns3 {
+namespace lorawan {
+
+/**
+ * Ladder queue (Tang, Goh and Thng, 2005).
+ *
+ * Events at or after TopStart are appended to the unsorted Top. When the
+ * nearer events run out, Top becomes the first rung of the ladder, a row of
+ * buckets as wide as the spread of its events divided by their number, so a
+ * rung has about one event per bucket whatever the traffic period. The
+ * current bucket of the lowest rung is moved to the sorted Bottom, or split
+ * into a finer rung first if it holds more than Threshold events, as the
+ * bursts of sends at the same instant do. An event is inserted in the first
+ * rung whose current bucket doesn't start after it, or in Bottom, so an
+ * insertion costs a division unless it falls in the next few events. When
+ * an event falls before the ladder with four times Threshold events in
+ * Bottom already, Bottom is spread over a new finest rung instead: the
+ * delivery of a send to every PHY, a few microseconds ahead, would
+ * otherwise make each insertion move the whole of Bottom.
+ *
+ * The sends of the periodic end devices spread over a whole period and land
+ * in Top or a coarse rung; only the receive windows and the channel events,
+ * a fixed offset ahead, reach Bottom.
+ */
+class LadderScheduler : public Scheduler
+{
+public:
+  static TypeId GetTypeId (void);
+
+  LadderScheduler ();
+  virtual ~LadderScheduler ();
+
+  virtual void Insert (const Event &ev);
+  virtual bool IsEmpty (void) const;
+  virtual Event PeekNext (void) const;
+  virtual Event RemoveNext (void);
+  virtual void Remove (const Event &ev);
+
+private:
+  struct Rung
+  {
+    uint64_t start;                           //!< Time stamp of the first bucket
+    uint64_t width;                           //!< Time covered by a bucket
+    uint32_t current;                         //!< First bucket not moved down yet
+    std::vector<std::vector<Event> > buckets;
+
+    uint64_t GetCurrentStart (void) const
+    {
+      return start + current * width;
+    }
+  };
+
+  /**
+   * Fill Bottom from the ladder or Top if it is empty, so it always holds
+   * the earliest event
+   */
+  void Refill (void);
+
+  /**
+   * Spread events over a new rung starting at start, with buckets of the
+   * given width
+   */
+  void SpawnRung (std::vector<Event> &events, uint64_t start, uint64_t width, uint32_t nBuckets);
+
+  void InsertBottom (const Event &ev);
+
+  /**
+   * Turn the events of Bottom into a new finest rung
+   */
+  void SpillBottom (void);
+
+  bool IsBottomEmpty (void) const;
+
+  void ClearBottom (void);
+
+  static bool Earlier (const Event &a, const Event &b);
+
+  uint32_t m_threshold;                       //!< Events a bucket is sorted with, at most
+  uint32_t m_maxRungs;
+
+  std::vector<Event> m_top;
+  uint64_t m_topStart;
+  uint64_t m_topMin;
+  uint64_t m_topMax;
+  std::vector<Rung> m_rungs;                  //!< From the coarsest to the finest
+  std::vector<Event> m_bottom;                //!< Sorted, the events before m_bottomHead already ran
+  uint32_t m_bottomHead;                      //!< Index of the next event in Bottom
+  uint32_t m_size;
+};
+
+} //namespace ns3
+
+}
+#endif /* LADDER_SCHEDULER_H */
@@ -0,0 +1,434 @@
+/*-*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+  Compact representation of transmit-only end devices. Instead of a Node with
+  a LoraNetDevice, PHY, MAC, mobility model, building info and application per
+  device, the state of every sensor is packed in a flat array and a single
+  proxy PHY puts their uplinks on the real LoraChannel.
+ */
+#include "lite-end-devices.h"
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+#include "ns3/double.h"
+#include "ns3/boolean.h"
+#include "ns3/rng-seed-manager.h"
+#include "ns3/trace-source-accessor.h"
+#include "ns3/constant-position-mobility-model.h"
+#include "ns3/simple-end-device-lora-phy.h"
+#include "ns3/lora-frame-header.h"
+#include "ns3/lorawan-mac-header.h"
+#include "ns3/lora-device-address.h"
+#include "ns3/lora-tag.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace ns3
+{
+  namespace lorawan
+  {
+
+    NS_LOG_COMPONENT_DEFINE("LiteEndDevices");
+
+    NS_OBJECT_ENSURE_REGISTERED(LiteEndDevices);
+
+    const int64_t LiteEndDevices::NEVER = std::numeric_limits<int64_t>::max();
+
+    // The three default channels of the EU868 region, all in the same sub-band
+    static const double FREQUENCIES[] = { 868.1, 868.3, 868.5 };
+
+    TypeId
+    LiteEndDevices::GetTypeId(void)
+    {
+      static TypeId tid = TypeId("ns3::LiteEndDevices")
+        .SetParent<Object> ()
+        .AddConstructor<LiteEndDevices> ()
+        .SetGroupName("lorawan")
+        .AddAttribute("TxPower", "The transmission power of the devices (dBm)",
+          DoubleValue(14),
+          MakeDoubleAccessor(&LiteEndDevices::m_txPowerDbm),
+          MakeDoubleChecker<double> ())
+        .AddAttribute("DutyCycle", "The duty cycle of the sub-band the devices transmit on",
+          DoubleValue(0.01),
+          MakeDoubleAccessor(&LiteEndDevices::m_dutyCycle),
+          MakeDoubleChecker<double> (0, 1))
+        .AddTraceSource("StartSending", "A device started sending a packet, "
+          "the id is the index of the device",
+          MakeTraceSourceAccessor(&LiteEndDevices::m_startSending),
+          "ns3::Packet::TracedCallback")
+        .AddTraceSource("SentNewPacket", "A device sent a new packet at MAC level",
+          MakeTraceSourceAccessor(&LiteEndDevices::m_sentNewPacket),
+          "ns3::Packet::TracedCallback");
+      return tid;
+    }
+
+    LiteEndDevices::LiteEndDevices(): m_postponed(0),
+      m_height(1.2),
+      m_nwkId(0),
+      m_firstNwkAddr(0),
+      m_pktSize(10),
+      m_stream(0),
+      m_stop(NEVER),
+      m_distribution(CONSTANT),
+      m_param1(10),
+      m_param2(0),
+      m_bound(0),
+      m_antithetic(false)
+    {
+      NS_LOG_FUNCTION_NOARGS();
+    }
+
+    LiteEndDevices::~LiteEndDevices()
+    {
+      NS_LOG_FUNCTION_NOARGS();
+    }
+
+    void
+    LiteEndDevices::Install(uint32_t n, Ptr<PositionAllocator> positions, double height)
+    {
+      NS_LOG_FUNCTION(this << n << height);
+
+      m_height = height;
+      m_devices.clear();
+      m_devices.reserve(n);
+      for (uint32_t i = 0; i < n; i++)
+      {
+        Vector position = positions->GetNext();
+        Device device;
+        device.rng = 0;
+        device.nextPacket = NEVER;
+        device.postponedTx = NEVER;
+        device.dutyCycleFree = 0;
+        device.x = position.x;
+        device.y = position.y;
+        device.fCnt = 0;
+        device.sf = 12;
+        device.dataRate = 0;
+        m_devices.push_back(device);
+      }
+
+     	// A single node carries the position of the device that is sending. It
+     	// has no building info, which would be shared by all the devices: the
+     	// scenario refuses lite devices with the buildings channel
+      m_proxyNode = CreateObject<Node> ();
+      m_proxyMobility = CreateObject<ConstantPositionMobilityModel> ();
+      m_proxyNode->AggregateObject(m_proxyMobility);
+
+      m_proxyPhy = CreateObject<SimpleEndDeviceLoraPhy> ();
+      m_proxyPhy->SetMobility(m_proxyMobility);
+
+      NS_LOG_DEBUG("Installed " << n << " lite end devices, " << GetBytesPerDevice() << " bytes each");
+    }
+
+    void
+    LiteEndDevices::SetChannel(Ptr<LoraChannel> channel)
+    {
+      m_channel = channel;
+    }
+
+    void
+    LiteEndDevices::SetAddresses(uint8_t nwkId, uint32_t firstNwkAddr)
+    {
+      m_nwkId = nwkId;
+      m_firstNwkAddr = firstNwkAddr;
+    }
+
+    void
+    LiteEndDevices::SetDataRate(uint8_t dataRate)
+    {
+      NS_ASSERT(dataRate <= 6);
+      for (std::vector<Device>::iterator i = m_devices.begin(); i != m_devices.end(); ++i)
+      {
+        i->dataRate = dataRate;
+        i->sf = dataRate < 6 ? 12 - dataRate : 7;
+      }
+    }
+
+    void
+    LiteEndDevices::SetPeriodRandomVariable(Ptr<RandomVariableStream> period)
+    {
+      m_periodRV = period;
+      m_bound = 0;
+      BooleanValue antithetic;
+      period->GetAttribute("Antithetic", antithetic);
+      m_antithetic = antithetic.Get();
+      if (Ptr<UniformRandomVariable> uniform = DynamicCast<UniformRandomVariable> (period))
+      {
+        m_distribution = UNIFORM;
+        m_param1 = uniform->GetMin();
+        m_param2 = uniform->GetMax();
+      }
+      else if (Ptr<ExponentialRandomVariable> exponential = DynamicCast<ExponentialRandomVariable> (period))
+      {
+        m_distribution = EXPONENTIAL;
+        m_param1 = exponential->GetMean();
+        m_bound = exponential->GetBound();
+      }
+      else if (Ptr<WeibullRandomVariable> weibull = DynamicCast<WeibullRandomVariable> (period))
+      {
+        m_distribution = WEIBULL;
+        m_param1 = weibull->GetScale();
+        m_param2 = weibull->GetShape();
+        m_bound = weibull->GetBound();
+      }
+      else if (Ptr<ConstantRandomVariable> constant = DynamicCast<ConstantRandomVariable> (period))
+      {
+        m_distribution = CONSTANT;
+        m_param1 = constant->GetConstant();
+      }
+      else
+      {
+        NS_LOG_WARN("The devices will share " << period->GetInstanceTypeId().GetName());
+        m_distribution = SHARED;
+      }
+    }
+
+    void
+    LiteEndDevices::SetPacketSize(uint8_t size)
+    {
+      m_pktSize = size;
+    }
+
+    int64_t
+    LiteEndDevices::AssignStreams(int64_t stream)
+    {
+      m_stream = stream;
+      return 1;
+    }
+
+    uint32_t
+    LiteEndDevices::GetN(void) const
+    {
+      return m_devices.size();
+    }
+
+    bool
+    LiteEndDevices::HasPendingTransmissions(void) const
+    {
+      return m_postponed > 0;
+    }
+
+    uint32_t
+    LiteEndDevices::GetBytesPerDevice(void)
+    {
+      return sizeof(Device) + sizeof(uint32_t);
+    }
+
+    int64_t
+    LiteEndDevices::NextEvent(const Device &device)
+    {
+      return std::min(device.nextPacket, device.postponedTx);
+    }
+
+    uint64_t
+    LiteEndDevices::Mix(uint64_t z)
+    {
+      z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+      z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+      return z ^ (z >> 31);
+    }
+
+    double
+    LiteEndDevices::NextUniform(uint64_t &state)
+    {
+      state += 0x9e3779b97f4a7c15ULL;
+     	// 53 random bits, never 0 nor 1
+      return ((Mix(state) >> 11) + 0.5) / 9007199254740992.0;
+    }
+
+    double
+    LiteEndDevices::NextTrafficUniform(Device &device)
+    {
+      double u = NextUniform(device.rng);
+      return m_antithetic ? 1 - u : u;
+    }
+
+    double
+    LiteEndDevices::SamplePeriod(Device &device)
+    {
+      switch (m_distribution)
+      {
+      case UNIFORM:
+        return m_param1 + NextTrafficUniform(device) * (m_param2 - m_param1);
+      case EXPONENTIAL:
+        while (true)
+        {
+          double value = -m_param1 * std::log(NextTrafficUniform(device));
+          if (m_bound == 0 || value <= m_bound)
+          {
+            return value;
+          }
+        }
+      case WEIBULL:
+        while (true)
+        {
+          double value = m_param1 * std::pow(-std::log(NextTrafficUniform(device)), 1 / m_param2);
+          if (m_bound == 0 || value <= m_bound)
+          {
+            return value;
+          }
+        }
+      case CONSTANT:
+        return m_param1;
+      default:
+        return m_periodRV->GetValue();
+      }
+    }
+
+    void
+    LiteEndDevices::SeedDevices(void)
+    {
+     	// Hash (seed, run, stream, device): Mix is a bijection, so every device
+     	// gets a different starting point of the sequence
+      uint64_t base = Mix(Mix(Mix(RngSeedManager::GetSeed()) ^ RngSeedManager::GetRun()) ^ uint64_t(m_stream));
+      for (uint32_t i = 0; i < m_devices.size(); i++)
+      {
+        m_devices[i].rng = Mix(base ^ i);
+      }
+    }
+
+    void
+    LiteEndDevices::Start(Time start, Time stop)
+    {
+      NS_LOG_FUNCTION(this << start << stop);
+      NS_ASSERT_MSG(m_channel, "The lite end devices need a channel");
+
+      SeedDevices();
+      m_stop = stop.GetTimeStep();
+      m_heap.clear();
+      m_heap.reserve(m_devices.size());
+      for (uint32_t i = 0; i < m_devices.size(); i++)
+      {
+       	// Same as RandomPeriodicSenderHelper: the first packet comes after a
+       	// delay drawn uniformly in the first period
+        Device &device = m_devices[i];
+        double period = SamplePeriod(device);
+        int64_t first = (start + Seconds(NextTrafficUniform(device) * period)).GetTimeStep();
+        device.nextPacket = first < m_stop ? first : NEVER;
+        if (device.nextPacket != NEVER)
+        {
+          m_heap.push_back(i);
+        }
+      }
+
+      LaterDevice later = { &m_devices };
+      std::make_heap(m_heap.begin(), m_heap.end(), later);
+      ScheduleDispatch();
+    }
+
+    void
+    LiteEndDevices::GeneratePacket(uint32_t index)
+    {
+      Device &device = m_devices[index];
+      int64_t now = Simulator::Now().GetTimeStep();
+
+      if (now < device.dutyCycleFree)
+      {
+       	// Like EndDeviceLorawanMac, the new packet replaces the one already waiting
+        NS_LOG_DEBUG("Device " << index << " postponed its packet by the duty cycle");
+        if (device.postponedTx == NEVER)
+        {
+          m_postponed++;
+        }
+        device.postponedTx = device.dutyCycleFree;
+      }
+      else
+      {
+        Transmit(index);
+      }
+
+      int64_t next = now + Seconds(SamplePeriod(device)).GetTimeStep();
+      device.nextPacket = next < m_stop ? next : NEVER;
+    }
+
+    void
+    LiteEndDevices::Transmit(uint32_t index)
+    {
+      Device &device = m_devices[index];
+      m_proxyMobility->SetPosition(Vector(device.x, device.y, m_height));
+
+     	// Same headers as an unconfirmed uplink of ClassAEndDeviceLorawanMac
+      Ptr<Packet> packet = Create<Packet> (m_pktSize);
+      LoraFrameHeader frameHdr;
+      frameHdr.SetAsUplink();
+      frameHdr.SetFPort(1);
+      frameHdr.SetAddress(LoraDeviceAddress(m_nwkId, m_firstNwkAddr + index));
+      frameHdr.SetAdr(false);
+      frameHdr.SetAdrAckReq(false);
+      frameHdr.SetFCnt(device.fCnt++);
+      packet->AddHeader(frameHdr);
+      LorawanMacHeader macHdr;
+      macHdr.SetMType(LorawanMacHeader::UNCONFIRMED_DATA_UP);
+      macHdr.SetMajor(1);
+      packet->AddHeader(macHdr);
+      m_sentNewPacket(packet);
+
+      LoraTxParameters params;
+      params.sf = device.sf;
+      params.headerDisabled = false;
+      params.codingRate = 1;
+      params.bandwidthHz = device.dataRate == 6 ? 250000 : 125000;
+      params.nPreamble = 8;
+      params.crcEnabled = true;
+      params.lowDataRateOptimizationEnabled = LoraPhy::GetTSym(params) > MilliSeconds(16);
+      Time duration = LoraPhy::GetOnAirTime(packet, params);
+
+      LoraTag tag;
+      packet->RemovePacketTag(tag);
+      tag.SetSpreadingFactor(device.sf);
+      packet->AddPacketTag(tag);
+
+      double frequency = FREQUENCIES[std::min(2, int (NextUniform(device.rng) * 3))];
+      device.dutyCycleFree = Simulator::Now().GetTimeStep() + duration.GetTimeStep() / m_dutyCycle;
+
+      m_channel->Send(m_proxyPhy, packet, m_txPowerDbm, params, duration, frequency);
+      m_startSending(packet, index);
+    }
+
+    void
+    LiteEndDevices::Dispatch(void)
+    {
+      NS_LOG_FUNCTION(this);
+
+      int64_t now = Simulator::Now().GetTimeStep();
+      LaterDevice later = { &m_devices };
+      while (!m_heap.empty() && NextEvent(m_devices[m_heap.front()]) <= now)
+      {
+        uint32_t index = m_heap.front();
+        std::pop_heap(m_heap.begin(), m_heap.end(), later);
+        m_heap.pop_back();
+
+        Device &device = m_devices[index];
+        if (device.postponedTx <= now)
+        {
+          device.postponedTx = NEVER;
+          m_postponed--;
+          Transmit(index);
+        }
+        if (device.nextPacket <= now)
+        {
+          GeneratePacket(index);
+        }
+
+        if (NextEvent(device) != NEVER)
+        {
+          m_heap.push_back(index);
+          std::push_heap(m_heap.begin(), m_heap.end(), later);
+        }
+      }
+
+      ScheduleDispatch();
+    }
+
+    void
+    LiteEndDevices::ScheduleDispatch(void)
+    {
+      Simulator::Cancel(m_dispatchEvent);
+      if (m_heap.empty())
+      {
+        return;
+      }
+      Time next = TimeStep(NextEvent(m_devices[m_heap.front()]));
+      m_dispatchEvent = Simulator::Schedule(next - Simulator::Now(), &LiteEndDevices::Dispatch, this);
+    }
+  }
+}
@@ -0,0 +1,242 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+  Compact representation of transmit-only end devices. Instead of a Node with
+  a LoraNetDevice, PHY, MAC, mobility model, building info and application per
+  device, the state of every sensor is packed in a flat array and a single
+  proxy PHY puts their uplinks on the real LoraChannel.
+ */
+
+#ifndef LITE_END_DEVICES_H
+#define LITE_END_DEVICES_H
+
+#include "ns3/object.h"
+#include "ns3/nstime.h"
+#include "ns3/event-id.h"
+#include "ns3/node.h"
+#include "ns3/packet.h"
+#include "ns3/position-allocator.h"
+#include "ns3/mobility-model.h"
+#include "ns3/random-variable-stream.h"
+#include "ns3/traced-callback.h"
+#include "ns3/lora-channel.h"
+#include "ns3/end-device-lora-phy.h"
+#include <vector>
+
+namespace ns3 {
+namespace lorawan {
+
+/**
+ * A population of class A end devices that only send unconfirmed uplinks.
+ *
+ * Each device takes a fixed-size record (position, spreading factor, data
+ * rate, frame counter, next packet time, duty cycle timer and the state of
+ * its own random generator) instead of the few kilobytes and dozens of heap
+ * objects of a full node, so a million devices fit in a few tens of MB.
+ *
+ * The devices behave like a ClassAEndDeviceLorawanMac driven by a
+ * RandomPeriodicSender: the first packet is sent after a delay drawn
+ * uniformly in [0, period), the following ones after a new period is drawn,
+ * and a packet generated while the duty cycle forbids transmitting is
+ * postponed, replacing any packet already waiting. Every uplink carries real
+ * MAC and frame headers and goes through LoraChannel::Send, so gateways, the
+ * interference model and the propagation loss models see it exactly as they
+ * would see the uplink of a full device.
+ *
+ * Differences with full devices: the devices don't move, don't open receive
+ * windows and never hear downlinks, so they must not be registered with a
+ * network server.
+ *
+ * All the pending sends are kept in a heap ordered by time and a single
+ * dispatch event is pending in the simulator at any time.
+ */
+class LiteEndDevices : public Object
+{
+public:
+  LiteEndDevices ();
+  ~LiteEndDevices ();
+
+  static TypeId GetTypeId (void);
+
+  /**
+   * Create the devices, placing them with the given allocator
+   *
+   * \param n The number of devices
+   * \param positions The allocator giving the position of every device
+   * \param height The height of every device
+   */
+  void Install (uint32_t n, Ptr<PositionAllocator> positions, double height);
+
+  /**
+   * Set the channel the uplinks are sent on. The proxy PHY is not added to
+   * the channel, so the devices never receive anything.
+   */
+  void SetChannel (Ptr<LoraChannel> channel);
+
+  /**
+   * Set the address of the first device, the others follow consecutively
+   */
+  void SetAddresses (uint8_t nwkId, uint32_t firstNwkAddr);
+
+  /**
+   * Set the data rate of every device. The spreading factor follows from it
+   * as in the EU868 region.
+   */
+  void SetDataRate (uint8_t dataRate);
+
+  /**
+   * Set the distribution of the time between two packets of a device, in
+   * seconds. Uniform, exponential, Weibull and constant variables are sampled
+   * from the generator of each device, antithetically if the variable is;
+   * any other variable is shared by all the devices.
+   */
+  void SetPeriodRandomVariable (Ptr<RandomVariableStream> period);
+
+  void SetPacketSize (uint8_t size);
+
+  /**
+   * Start generating packets at start and stop generating them at stop.
+   * Packets postponed by the duty cycle are sent after stop.
+   */
+  void Start (Time start, Time stop);
+
+  /**
+   * Derive the generators of the devices from the given stream, together
+   * with the run number
+   *
+   * \returns the number of streams used
+   */
+  int64_t AssignStreams (int64_t stream);
+
+  uint32_t GetN (void) const;
+
+  /**
+   * \returns true if some device holds a packet postponed by the duty cycle
+   */
+  bool HasPendingTransmissions (void) const;
+
+  /**
+   * \returns the memory taken by each device, including its heap entry
+   */
+  static uint32_t GetBytesPerDevice (void);
+
+private:
+  /**
+   * The state of a single device
+   */
+  struct Device
+  {
+    uint64_t rng;          //!< State of the generator of the device
+    int64_t nextPacket;    //!< Time step of the next packet, or NEVER
+    int64_t postponedTx;   //!< Time step of the transmission waiting for the duty cycle, or NEVER
+    int64_t dutyCycleFree; //!< First time step at which the duty cycle allows transmitting
+    float x;
+    float y;
+    uint16_t fCnt;
+    uint8_t sf;
+    uint8_t dataRate;
+  };
+
+  struct LaterDevice
+  {
+    const std::vector<Device> *devices;
+    bool operator() (uint32_t a, uint32_t b) const
+    {
+      return NextEvent ((*devices)[a]) > NextEvent ((*devices)[b]);
+    }
+  };
+
+  enum PeriodDistribution
+  {
+    UNIFORM,
+    EXPONENTIAL,
+    WEIBULL,
+    CONSTANT,
+    SHARED
+  };
+
+  static const int64_t NEVER;
+
+  static int64_t NextEvent (const Device &device);
+
+  /**
+   * The finalizer of splitmix64
+   */
+  static uint64_t Mix (uint64_t z);
+
+  /**
+   * \returns the next number of the splitmix64 generator of the device,
+   * mapped to (0, 1)
+   */
+  static double NextUniform (uint64_t &state);
+
+  /**
+   * \returns the next traffic draw of a device, u or 1 - u if the period
+   * variable is antithetic
+   */
+  double NextTrafficUniform (Device &device);
+
+  /**
+   * Draw the time to the next packet of a device, in seconds
+   */
+  double SamplePeriod (Device &device);
+
+  void SeedDevices (void);
+
+  /**
+   * Generate a new packet, transmitting it or postponing it
+   */
+  void GeneratePacket (uint32_t index);
+
+  void Transmit (uint32_t index);
+
+  /**
+   * Handle everything that is due and wait for the next event
+   */
+  void Dispatch (void);
+
+  void ScheduleDispatch (void);
+
+  std::vector<Device> m_devices;
+  std::vector<uint32_t> m_heap;
+  EventId m_dispatchEvent;
+  uint32_t m_postponed;
+
+  Ptr<LoraChannel> m_channel;
+  Ptr<Node> m_proxyNode;
+  Ptr<MobilityModel> m_proxyMobility;
+  Ptr<EndDeviceLoraPhy> m_proxyPhy;
+  double m_height;
+
+  uint8_t m_nwkId;
+  uint32_t m_firstNwkAddr;
+  uint8_t m_pktSize;
+  double m_txPowerDbm;
+  double m_dutyCycle;
+  int64_t m_stream;
+  int64_t m_stop;
+
+  Ptr<RandomVariableStream> m_periodRV;
+  PeriodDistribution m_distribution;
+  double m_param1;
+  double m_param2;
+  double m_bound;
+  bool m_antithetic;
+
+  /**
+   * The trace source fired when a device starts sending, with the same
+   * signature as the StartSending trace of LoraPhy. The id is the index of
+   * the device.
+   */
+  TracedCallback<Ptr<const Packet>, uint32_t> m_startSending;
+
+  /**
+   * The trace source fired when a device generates a new packet, with the
+   * same signature as the SentNewPacket trace of LorawanMac
+   */
+  TracedCallback<Ptr<const Packet> > m_sentNewPacket;
+};
+
+} //namespace ns3
+
+}
+#endif /* LITE_END_DEVICES_H */
@@ -17,8 +17,11 @@
 #include "ns3/mobility-helper.h"
 #include "ns3/position-allocator.h"
 #include "ns3/double.h"
+#include "ns3/boolean.h"
 #include "ns3/random-variable-stream.h"
 #include "random-periodic-sender-helper.h"
+#include "rate-profile-sender-helper.h"
+#include "burst-traffic-generator.h"
 #include "ns3/command-line.h"
 #include "ns3/network-server-helper.h"
 #include "ns3/correlated-shadowing-propagation-loss-model.h"
@@ -26,6 +29,22 @@
 #include "ns3/building-allocator.h"
 #include "ns3/buildings-helper.h"
 #include "ns3/forwarder-helper.h"
+#include "drain-detector.h"
+#include "lite-end-devices.h"
+#include "gateway-deployment.h"
+#include "culled-lora-channel.h"
+#include "indexed-gateway-lora-phy.h"
+#include "ladder-scheduler.h"
+#include "bounded-shadowing-loss-model.h"
+#include "../scenario-profiler.h"
+#include "../binary-log.h"
+#include "../replication-controller.h"
+#include "../steady-state-monitor.h"
+#include "../config-hash.h"
+#include "../result-store.h"
+#include "../run-arena.h"
+#include "ns3/rng-seed-manager.h"
+#include "ns3/global-value.h"
 #include <algorithm>
 #include <ctime>
 #include <ns3/rectangle.h>
@@ -38,13 +57,69 @@ NS_LOG_COMPONENT_DEFINE("LorawanNetworkSimulation");
 // Network settings
 int nDevices = 18;
 int nGateways = 1;
+
+// Gateway layout: single (every gateway at the centre), hexagonal (a grid
+// gatewaySpacing apart, or spread to cover the radius if 0) or the name of a
+// file with one "x y [z]" line per gateway
+std::string gatewayLayout = "single";
+double gatewaySpacing = 0;
 double radius = 6400;
 double simulationTime = 600;
 int packetSize = 20;
 
+// Represent the end devices as compact transmit-only records instead of nodes,
+// outdoor only: they can't be used with the realistic channel model
+bool liteEndDevices = false;
+
 // Channel model
 bool realisticChannelModel = true;
 
+// Shadowing of the realistic channel hashed from the grid vertices instead of
+// the lorawan module model, whose map grows as the end devices move
+bool boundedShadowing = false;
+
+// Gateway culling: an uplink isn't delivered to the gateways whose best-case
+// power, with the log-distance loss only plus the margin, is under the
+// sensitivity of its spreading factor. Off by default: without a margin of a
+// few shadowing sigmas it drops links the shadowing gains would have saved
+bool gatewayCulling = false;
+double cullingMargin = 0;
+
+// Gateways check the interference on receptions indexed per (frequency, SF)
+// instead of the event list of the lorawan module
+bool indexedInterference = false;
+
+// Give each end device its own traffic streams, derived from (run, node id)
+bool perDeviceStreams = false;
+int64_t trafficStreamBase = 1000;
+
+// Common random numbers: the positions, mobility, shadowing, buildings and
+// storms draw from fixed streams after the traffic ones, so the compared
+// distributions see the same network and only differ in the traffic. With
+// antithetic, each replication is a pair of runs, the second one drawing the
+// traffic from 1 - u
+bool crn = false;
+bool antithetic = false;
+
+// Directory of the stored results: a run whose configuration, traffic, seed
+// and build already have a record there is read back instead of simulated,
+// unless forceRun is set; empty disables the store
+std::string resultStore = "";
+bool forceRun = false;
+
+// Time-varying traffic: a rate table replaces the traffic distributions
+std::string rateProfile = "";
+std::string rateProfileMode = "Inversion";
+double rateProfileResolution = 60;
+
+// Correlated bursts (alarm storms) on top of the periodic traffic
+double burstInterval = 0;	// mean time between bursts (s), 0 disables them
+double burstX = 0;
+double burstY = 0;
+double burstRadius = 1000;
+double burstJitter = 5;
+int burstRetries = 0;
+
 /************************/
 /* Lorawan Tracker */
 /************************/
@@ -54,6 +129,34 @@ int received = 0;
 int noMoreReceivers = 0;
 int interfered = 0;
 int underSensitivity = 0;
+int culledDeliveries = 0;
+
+// Losses per time window, to find the peaks caused by the bursts
+double peakWindow = 10;
+std::vector<int> interferedPerWindow;
+std::vector<int> noMoreReceiversPerWindow;
+
+void CountInWindow(std::vector<int> &windows)
+{
+  size_t window = Simulator::Now().GetSeconds() / peakWindow;
+  if (window >= windows.size())
+  {
+    windows.resize(window + 1, 0);
+  }
+  windows[window] += 1;
+}
+
+void PrintPeak(std::string label, const std::vector<int> &windows)
+{
+  std::vector<int>::const_iterator peak = std::max_element(windows.begin(), windows.end());
+  if (peak == windows.end())
+  {
+    std::cout << label << ": 0\n";
+    return;
+  }
+  std::cout << label << ": " << *peak << " en la ventana que empieza en " <<
+    (peak - windows.begin()) * peakWindow << " s\n";
+}
 
 namespace std
 {
@@ -65,12 +168,14 @@ namespace std
     UNDER_SENSITIVITY,
     UNSET
   };
+  // The outcome of a packet is the best one among the gateways, in the
+  // order of the enum, so its state doesn't grow with the gateways
   struct PacketStatus
   {
     Ptr<Packet const> packet;
     uint32_t senderId;
     int outcomeNumber;
-    std::vector<enum PacketOutcome> outcomes;
+    enum PacketOutcome outcome;
   };
 
 };
@@ -87,115 +192,272 @@ void configureNode(Ptr<Node> node, u_int8_t newWindowValue, u_int8_t newDataRate
   endDeviceMac->SetDataRate(newDataRate);
 
 }
-std::map<Ptr<Packet const>, std::PacketStatus> packetTracker;
+// The packets waiting for the outcome of every gateway; its nodes come from
+// the run arena, given back in one go at the end of the run
+typedef std::map<Ptr<Packet const>, std::PacketStatus, std::less<Ptr<Packet const> >,
+  RunArenaAllocator<std::pair<const Ptr<Packet const>, std::PacketStatus> > > PacketTrackerMap;
+PacketTrackerMap packetTracker;
 
-void CheckReceptionByAllGWsComplete(std::map<Ptr<Packet const>, std::PacketStatus>::iterator it)
+// The gateways, whose slots the outcomes are counted in
+Ptr<GatewayDeployment> gatewayDeployment;
+
+// The end devices of the current run when they are lite
+Ptr<LiteEndDevices> liteDevices;
+
+// The alarm storms of the current run, if any
+Ptr<BurstTrafficGenerator> burstGenerator;
+
+void CheckReceptionByAllGWsComplete(PacketTrackerMap::iterator it)
 {
-  // Check whether this packet is received by all gateways
+  SCENARIO_PROFILE_SCOPE("CheckReceptionByAllGWsComplete");
+  // Check whether every gateway reported an outcome for this packet
   if ((*it).second.outcomeNumber == nGateways)
   {
     // Update the statistics
     std::PacketStatus status = (*it).second;
-    for (int j = 0; j < nGateways; j++)
+    switch ((int)status.outcome) //por si acaso castear a entero lo del switch
     {
-      switch ((int)status.outcomes.at(j)) //por si acaso castear a entero lo del switch
-      {
-      case std::RECEIVED:
-      {
-        received += 1;
-        break;
-      }
-      case std::INTERFERED:
-      {
-        interfered += 1;
-        break;
-      }
-      case std::NO_MORE_RECEIVERS:
-      {
-        noMoreReceivers += 1;
-        break;
-      }
-      case std::UNDER_SENSITIVITY:
-      {
-        underSensitivity += 1;
-        break;
-      }
+    case std::RECEIVED:
+    {
+      received += 1;
+      break;
+    }
+    case std::INTERFERED:
+    {
+      interfered += 1;
+      CountInWindow(interferedPerWindow);
+      break;
+    }
+    case std::NO_MORE_RECEIVERS:
+    {
+      noMoreReceivers += 1;
+      CountInWindow(noMoreReceiversPerWindow);
+      break;
+    }
+    case std::UNDER_SENSITIVITY:
+    {
+      underSensitivity += 1;
+      break;
+    }
 
-      case std::UNSET:
-      {
-        break;
-      }
-      default:
-      {
-        break;
-      }
-      }
+    case std::UNSET:
+    {
+      break;
+    }
+    default:
+    {
+      break;
+    }
     }
     // Remove the packet from the tracker
     packetTracker.erase(it);
   }
 }
 
+/**
+ * Record the outcome of a packet at a gateway: in the slot of the gateway,
+ * and in the packet if it is better than the ones of the other gateways
+ */
+void RecordOutcome(PacketTrackerMap::iterator it, uint32_t systemId, std::PacketOutcome outcome)
+{
+  if (it == packetTracker.end())
+  {
+    // A downlink of another gateway
+    return;
+  }
+  uint32_t slot = gatewayDeployment->GetSlot(systemId);
+  NS_ASSERT_MSG(slot != GatewayDeployment::NO_SLOT, "Node " << systemId << " is not a gateway");
+  GatewayDeployment::GatewayStats &stats = gatewayDeployment->GetStats(slot);
+  switch (outcome)
+  {
+  case std::RECEIVED:
+    stats.received++;
+    break;
+  case std::INTERFERED:
+    stats.interfered++;
+    break;
+  case std::NO_MORE_RECEIVERS:
+    stats.noMoreReceivers++;
+    break;
+  default:
+    stats.underSensitivity++;
+    break;
+  }
+  if (outcome < it->second.outcome)
+  {
+    it->second.outcome = outcome;
+  }
+  it->second.outcomeNumber += 1;
+}
+
 void TransmissionCallback(Ptr<Packet const> packet, uint32_t systemId)
 {
-  //NS_LOG_DEBUG("Transmitted a packet from device " << systemId);
+  SCENARIO_PROFILE_SCOPE("TransmissionCallback");
+  BINARY_LOG("LorawanNetworkSimulation", "Transmitted a packet from device {}", systemId);
   // Create a packetStatus
   std::PacketStatus status;
   status.packet = packet;
   status.senderId = systemId;
   status.outcomeNumber = 0;
-  status.outcomes = std::vector<std::PacketOutcome>(UNSET);
+  status.outcome = std::UNSET;
 
-  packetTracker.insert(std::pair<Ptr<Packet const>, std::PacketStatus>(packet, status));
+  packetTracker.insert(PacketTrackerMap::value_type(packet, status));
   count = count + 1;
 }
 void PacketReceptionCallback(Ptr<Packet const> packet, uint32_t systemId)
 {
-  //NS_LOG_INFO("A packet was successfully received at gateway " << systemId);
-  std::map<Ptr<Packet const>, std::PacketStatus>::iterator it = packetTracker.find(packet);
-  (*it).second.outcomes.at(systemId - nDevices) = std::RECEIVED;
-  (*it).second.outcomeNumber += 1;
+  SCENARIO_PROFILE_SCOPE("PacketReceptionCallback");
+  BINARY_LOG("LorawanNetworkSimulation", "A packet was successfully received at gateway {}", systemId);
+  PacketTrackerMap::iterator it = packetTracker.find(packet);
+  if (it == packetTracker.end())
+  {
+    // Not an uplink of an end device
+    return;
+  }
+  RecordOutcome(it, systemId, std::RECEIVED);
   CheckReceptionByAllGWsComplete(it);
 }
 
 void InterferenceCallback(Ptr<Packet const> packet, uint32_t systemId)
 {
-  //NS_LOG_INFO("A packet was interferenced at gateway " << systemId);
+  SCENARIO_PROFILE_SCOPE("InterferenceCallback");
+  BINARY_LOG("LorawanNetworkSimulation", "A packet was interferenced at gateway {}", systemId);
 
-  std::map<Ptr<Packet const>, std::PacketStatus>::iterator it = packetTracker.find(packet);
-  it->second.outcomes.at(systemId - nDevices) = std::INTERFERED;
-  it->second.outcomeNumber += 1;
+  PacketTrackerMap::iterator it = packetTracker.find(packet);
+  if (it == packetTracker.end())
+  {
+    // Not an uplink of an end device
+    return;
+  }
+  RecordOutcome(it, systemId, std::INTERFERED);
+
+  CheckReceptionByAllGWsComplete(it);
 }
 
 void NoMoreReceiversCallback(Ptr<Packet const> packet, uint32_t systemId)
 {
-  // NS_LOG_INFO ("A packet was lost because there were no more receivers at gateway " << systemId);
+  SCENARIO_PROFILE_SCOPE("NoMoreReceiversCallback");
+  BINARY_LOG("LorawanNetworkSimulation", "A packet was lost because there were no more receivers at gateway {}", systemId);
 
-  std::map<Ptr<Packet const>, std::PacketStatus>::iterator it = packetTracker.find(packet);
-  (*it).second.outcomes.at(systemId - nDevices) = std::NO_MORE_RECEIVERS;
-  (*it).second.outcomeNumber += 1;
+  PacketTrackerMap::iterator it = packetTracker.find(packet);
+  if (it == packetTracker.end())
+  {
+    // Not an uplink of an end device
+    return;
+  }
+  RecordOutcome(it, systemId, std::NO_MORE_RECEIVERS);
 
   CheckReceptionByAllGWsComplete(it);
 }
 
 void UnderSensitivityCallback(Ptr<Packet const> packet, uint32_t systemId)
 {
-  // NS_LOG_INFO ("A packet arrived at the gateway under sensitivity at gateway " << systemId);
+  SCENARIO_PROFILE_SCOPE("UnderSensitivityCallback");
+  BINARY_LOG("LorawanNetworkSimulation", "A packet arrived at the gateway under sensitivity at gateway {}", systemId);
 
-  std::map<Ptr<Packet const>, std::PacketStatus>::iterator it = packetTracker.find(packet);
-  (*it).second.outcomes.at(systemId - nDevices) = std::UNDER_SENSITIVITY;
-  (*it).second.outcomeNumber += 1;
+  PacketTrackerMap::iterator it = packetTracker.find(packet);
+  if (it == packetTracker.end())
+  {
+    // Not an uplink of an end device
+    return;
+  }
+  RecordOutcome(it, systemId, std::UNDER_SENSITIVITY);
 
   CheckReceptionByAllGWsComplete(it);
 }
 
+void CulledDeliveriesCallback(Ptr<Packet const> packet, uint32_t culled)
+{
+  SCENARIO_PROFILE_SCOPE("CulledDeliveriesCallback");
+  PacketTrackerMap::iterator it = packetTracker.find(packet);
+  if (it == packetTracker.end())
+  {
+    // Not an uplink of an end device
+    return;
+  }
+  // The culled gateways could only have reported it under the sensitivity
+  culledDeliveries += culled;
+  if (std::UNDER_SENSITIVITY < it->second.outcome)
+  {
+    it->second.outcome = std::UNDER_SENSITIVITY;
+  }
+  it->second.outcomeNumber += culled;
+  CheckReceptionByAllGWsComplete(it);
+}
+
+double CountReceived(void)
+{
+  return received;
+}
+
+double CountSent(void)
+{
+  return count;
+}
+
+double CountReceivedBits(void)
+{
+  return double(received) * 8 * packetSize;
+}
+
+bool PacketsPending(void)
+{
+  return !packetTracker.empty() || (liteDevices && liteDevices->HasPendingTransmissions())
+    || (burstGenerator && burstGenerator->HasPendingSends());
+}
+
 // Output control
 bool print = true;
 
+// Stop the simulation once the network has drained after appStopTime
+bool earlyStop = true;
+
+// Prefix of the JSON profile written after each run, empty to disable profiling
+std::string profile = "";
+
+// Event scheduler of the runs: map (the ns-3 default), list, heap, calendar,
+// priority or ladder
+std::string scheduler = "map";
+
+// Text logging of every level of this scenario, slow on long runs
+bool verbose = false;
+
+// Records kept by the binary log, 0 disables it, and the file it is dumped to
+uint32_t binaryLog = 0;
+std::string binaryLogFile = "lorawan-log.txt";
+
+// Traffic distributions to simulate: all, uniform, exponential or weibull
+std::string distribution = "all";
+
+// Replications: each configuration is repeated with consecutive RngRun values
+// until the confidence interval of ciMetric (pdr or throughput) is narrower
+// than ciWidth times its mean; 0 runs each configuration once
+double ciWidth = 0;
+double ciConfidence = 0.95;
+std::string ciMetric = "pdr";
+uint32_t minReplications = 3;
+uint32_t maxReplications = 30;
+
+// Steady state: the PDR is sampled in windows, the warm-up found by MSER-5 is
+// discarded and the run stops once the batch means of the rest converge. A
+// window of 0 is a sixtieth of the simulation time, so the twenty windows the
+// check needs take a third of the run
+bool steadyState = false;
+double steadyWindow = 0;
+double steadyTolerance = 0.02;
+bool steadyStop = true;
+
+// Metrics of a run
+struct RunMetrics
+{
+  double pdr;
+  double throughput;	// bps
+};
+
 class Experiment {
   public:
     Experiment();
-    void Run(Ptr<RandomVariableStream> rv);
+    RunMetrics Run(Ptr<RandomVariableStream> rv);
 
   private:
     uint32_t m_bytesTotal;
@@ -203,21 +465,28 @@ class Experiment {
 
 Experiment::Experiment() {}
 
-void Experiment::Run(Ptr<RandomVariableStream> trafficDistribution){
+RunMetrics Experiment::Run(Ptr<RandomVariableStream> trafficDistribution){
   /***********
    *Setup  *
    ***********/
 
+  ScenarioProfiler::Get().BeginRun(trafficDistribution ? trafficDistribution->GetInstanceTypeId().GetName() : "RateProfile");
+
   count = 0;
   received = 0;
   noMoreReceivers = 0;
   interfered = 0;
   underSensitivity = 0;
+  culledDeliveries = 0;
+  interferedPerWindow.clear();
+  noMoreReceiversPerWindow.clear();
 
  	// Mobility
+  Ptr<UniformDiscPositionAllocator> positions = CreateObject<UniformDiscPositionAllocator> ();
+  positions->SetRho(radius);
+  positions->SetX(0.0);
+  positions->SetY(0.0);
   MobilityHelper mobility;
-  mobility.SetPositionAllocator("ns3::UniformDiscPositionAllocator", "rho", DoubleValue(radius),
-    "X", DoubleValue(0.0), "Y", DoubleValue(0.0));
   mobility.SetMobilityModel("ns3::RandomDirection2dMobilityModel",
                               "Bounds", RectangleValue (Rectangle (-500, 500, -500, 500)),
                               "Speed", StringValue ("ns3::ConstantRandomVariable[Constant=1]"),
@@ -235,8 +504,15 @@ void Experiment::Run(Ptr<RandomVariableStream> trafficDistribution){
   if (realisticChannelModel)
   {
    	// Create the correlated shadowing component
-    Ptr<CorrelatedShadowingPropagationLossModel> shadowing =
-      CreateObject<CorrelatedShadowingPropagationLossModel> ();
+    Ptr<PropagationLossModel> shadowing;
+    if (boundedShadowing)
+    {
+      shadowing = CreateObject<BoundedShadowingPropagationLossModel> ();
+    }
+    else
+    {
+      shadowing = CreateObject<CorrelatedShadowingPropagationLossModel> ();
+    }
 
    	// Aggregate shadowing to the logdistance loss
     loss->SetNext(shadowing);
@@ -247,9 +523,28 @@ void Experiment::Run(Ptr<RandomVariableStream> trafficDistribution){
     shadowing->SetNext(buildingLoss);
   }
 
+  // The network streams come after the traffic streams of every node
+  int64_t stream = trafficStreamBase + RandomPeriodicSenderHelper::STREAMS_PER_DEVICE * (nDevices + nGateways + 1);
+  if (crn)
+  {
+    stream += positions->AssignStreams(stream);
+    stream += loss->AssignStreams(stream);
+  }
+
+  mobility.SetPositionAllocator(positions);
+
   Ptr<PropagationDelayModel> delay = CreateObject<ConstantSpeedPropagationDelayModel> ();
 
-  Ptr<LoraChannel> channel = CreateObject<LoraChannel> (loss, delay);
+  Ptr<CulledLoraChannel> channel = CreateObject<CulledLoraChannel> (loss, delay);
+  if (gatewayCulling)
+  {
+    Ptr<LogDistancePropagationLossModel> bestCaseLoss = CreateObject<LogDistancePropagationLossModel> ();
+    bestCaseLoss->SetPathLossExponent(3.76);
+    bestCaseLoss->SetReference(1, 7.7);
+    channel->SetBestCaseLossModel(bestCaseLoss);
+    channel->SetAttribute("Margin", DoubleValue(cullingMargin));
+    channel->TraceConnectWithoutContext("CulledDeliveries", MakeCallback(&CulledDeliveriesCallback));
+  }
 
   /************************
    *Create the helpers  *
@@ -279,42 +574,67 @@ void Experiment::Run(Ptr<RandomVariableStream> trafficDistribution){
 
  	// Create a set of nodes
   NodeContainer endDevices;
-  endDevices.Create(nDevices);
-
- 	// Assign a mobility model to each node
-  mobility.Install(endDevices);
-
- 	// Make it so that nodes are at a certain height > 0
-  for (NodeContainer::Iterator j = endDevices.Begin(); j != endDevices.End(); ++j)
+  uint8_t nwkId = 54;
+  uint32_t nwkAddr = 1864;
+  if (liteEndDevices)
   {
-    Ptr<MobilityModel> mobility = (*j)->GetObject<MobilityModel> ();
-    Vector position = mobility->GetPosition();
-    position.z = 1.2;
-    mobility->SetPosition(position);
+   	// Same positions and addresses as the full devices, without the nodes
+    liteDevices = CreateObject<LiteEndDevices> ();
+    liteDevices->Install(nDevices, positions, 1.2);
+    liteDevices->SetChannel(channel);
+    liteDevices->SetAddresses(nwkId, nwkAddr);
+    liteDevices->SetDataRate(0);
+    liteDevices->AssignStreams(trafficStreamBase);
+
+    liteDevices->TraceConnectWithoutContext("StartSending", MakeCallback(&TransmissionCallback));
+    LoraPacketTracker &tracker = helper.GetPacketTracker();
+    liteDevices->TraceConnectWithoutContext("StartSending",
+      MakeCallback(&LoraPacketTracker::TransmissionCallback, &tracker));
+    liteDevices->TraceConnectWithoutContext("SentNewPacket",
+      MakeCallback(&LoraPacketTracker::MacTransmissionCallback, &tracker));
+    NS_LOG_INFO("Lite end devices: " << LiteEndDevices::GetBytesPerDevice() << " bytes each");
   }
+  else
+  {
+    endDevices.Create(nDevices);
 
- 	// Create the LoraNetDevices of the end devices
-  uint8_t nwkId = 54;
-  uint32_t nwkAddr = 1864;
-  Ptr<LoraDeviceAddressGenerator> addrGen =
-    CreateObject<LoraDeviceAddressGenerator> (nwkId, nwkAddr);
+   	// Assign a mobility model to each node
+    mobility.Install(endDevices);
+    if (crn)
+    {
+      stream += mobility.AssignStreams(endDevices, stream);
+    }
 
- 	// Create the LoraNetDevices of the end devices
-  macHelper.SetAddressGenerator(addrGen);
-  phyHelper.SetDeviceType(LoraPhyHelper::ED);
-  macHelper.SetDeviceType(LorawanMacHelper::ED_A);
-  helper.Install(phyHelper, macHelper, endDevices);
+   	// Make it so that nodes are at a certain height > 0
+    for (NodeContainer::Iterator j = endDevices.Begin(); j != endDevices.End(); ++j)
+    {
+      Ptr<MobilityModel> mobility = (*j)->GetObject<MobilityModel> ();
+      Vector position = mobility->GetPosition();
+      position.z = 1.2;
+      mobility->SetPosition(position);
+    }
 
- 	// Now end devices are connected to the channel
+   	// Create the LoraNetDevices of the end devices
+    Ptr<LoraDeviceAddressGenerator> addrGen =
+      CreateObject<LoraDeviceAddressGenerator> (nwkId, nwkAddr);
 
- 	// Connect trace sources
-  for (NodeContainer::Iterator j = endDevices.Begin(); j != endDevices.End(); ++j)
-  {
-    Ptr<Node> node = *j;
-    Ptr<LoraNetDevice> loraNetDevice = node->GetDevice(0)->GetObject<LoraNetDevice> ();
-    Ptr<LoraPhy> phy = loraNetDevice->GetPhy();
-    phy->TraceConnectWithoutContext("StartSending", MakeCallback(&TransmissionCallback));
-    configureNode(node, 1, 0, 12);
+   	// Create the LoraNetDevices of the end devices
+    macHelper.SetAddressGenerator(addrGen);
+    phyHelper.SetDeviceType(LoraPhyHelper::ED);
+    macHelper.SetDeviceType(LorawanMacHelper::ED_A);
+    helper.Install(phyHelper, macHelper, endDevices);
+
+   	// Now end devices are connected to the channel
+
+   	// Connect trace sources
+    for (NodeContainer::Iterator j = endDevices.Begin(); j != endDevices.End(); ++j)
+    {
+      Ptr<Node> node = *j;
+      Ptr<LoraNetDevice> loraNetDevice = node->GetDevice(0)->GetObject<LoraNetDevice> ();
+      Ptr<LoraPhy> phy = loraNetDevice->GetPhy();
+      phy->TraceConnectWithoutContext("StartSending", MakeCallback(&TransmissionCallback));
+      configureNode(node, 1, 0, 12);
+    }
   }
 
   /*********************
@@ -325,16 +645,18 @@ void Experiment::Run(Ptr<RandomVariableStream> trafficDistribution){
   NodeContainer gateways;
   gateways.Create(nGateways);
 
-  Ptr<ListPositionAllocator> allocator = CreateObject<ListPositionAllocator> ();
- 	// Make it so that nodes are at a certain height > 0
-  allocator->Add(Vector(0.0, 0.0, 15.0));
-  mobility.SetPositionAllocator(allocator);
+  mobility.SetPositionAllocator(gatewayDeployment->GetPositionAllocator());
   mobility.Install(gateways);
+  if (crn)
+  {
+    stream += mobility.AssignStreams(gateways, stream);
+  }
 
  	// Create a netdevice for each gateway
   phyHelper.SetDeviceType(LoraPhyHelper::GW);
   macHelper.SetDeviceType(LorawanMacHelper::GW);
   helper.Install(phyHelper, macHelper, gateways);
+  gatewayDeployment->Register(gateways);
 
   for (NodeContainer::Iterator j = gateways.Begin(); j != gateways.End(); j++)
   {
@@ -343,6 +665,22 @@ void Experiment::Run(Ptr<RandomVariableStream> trafficDistribution){
     Ptr<LoraNetDevice> gLoraNetDevice = gNetDevice->GetObject<LoraNetDevice>();
     NS_ASSERT(gLoraNetDevice != 0);
     Ptr<GatewayLoraPhy> gwPhy = gLoraNetDevice->GetPhy()->GetObject<GatewayLoraPhy>();
+    if (indexedInterference)
+    {
+     	// The new PHY needs the trace sources LoraHelper connected to the tracker
+      gwPhy = IndexedGatewayLoraPhy::Replace(gLoraNetDevice);
+      LoraPacketTracker &tracker = helper.GetPacketTracker();
+      gwPhy->TraceConnectWithoutContext("ReceivedPacket",
+        MakeCallback(&LoraPacketTracker::PacketReceptionCallback, &tracker));
+      gwPhy->TraceConnectWithoutContext("LostPacketBecauseInterference",
+        MakeCallback(&LoraPacketTracker::InterferenceCallback, &tracker));
+      gwPhy->TraceConnectWithoutContext("LostPacketBecauseNoMoreReceivers",
+        MakeCallback(&LoraPacketTracker::NoMoreReceiversCallback, &tracker));
+      gwPhy->TraceConnectWithoutContext("LostPacketBecauseUnderSensitivity",
+        MakeCallback(&LoraPacketTracker::UnderSensitivityCallback, &tracker));
+      gwPhy->TraceConnectWithoutContext("NoReceptionBecauseTransmitting",
+        MakeCallback(&LoraPacketTracker::LostBecauseTxCallback, &tracker));
+    }
     gwPhy->TraceConnectWithoutContext("ReceivedPacket",
                                       MakeCallback(&PacketReceptionCallback));
     gwPhy->TraceConnectWithoutContext("LostPacketBecauseInterference",
@@ -415,39 +753,153 @@ void Experiment::Run(Ptr<RandomVariableStream> trafficDistribution){
    *********************************************/
 
   Time appStopTime = Seconds(simulationTime);
-  RandomPeriodicSenderHelper appHelper = RandomPeriodicSenderHelper();
-  appHelper.SetPeriodRandomVariable(trafficDistribution);
-  appHelper.SetPacketSize(packetSize);
-  ApplicationContainer appContainer = appHelper.Install(endDevices);
+  ApplicationContainer appContainer;
+  if (liteEndDevices)
+  {
+    if (!rateProfile.empty())
+    {
+      NS_FATAL_ERROR("The lite end devices don't support rate profiles");
+    }
+    liteDevices->SetPeriodRandomVariable(trafficDistribution);
+    liteDevices->SetPacketSize(packetSize);
+    liteDevices->Start(Seconds(0), appStopTime);
+  }
+  else if (rateProfile.empty())
+  {
+    RandomPeriodicSenderHelper appHelper = RandomPeriodicSenderHelper();
+    appHelper.SetPeriodRandomVariable(trafficDistribution);
+    appHelper.SetPacketSize(packetSize);
+    if (perDeviceStreams || crn)
+    {
+      appHelper.SetPerDeviceStreams(trafficStreamBase);
+    }
+    appContainer = appHelper.Install(endDevices);
+  }
+  else
+  {
+    // All the devices share one profile, built once for the whole run
+    Ptr<RateProfile> profile = Create<RateProfile> ();
+    if (!profile->LoadFromFile(rateProfile))
+    {
+      NS_FATAL_ERROR("Can't read the rate profile " << rateProfile);
+    }
+    profile->Build(Seconds(rateProfileResolution));
+
+    RateProfileSenderHelper appHelper = RateProfileSenderHelper();
+    appHelper.SetRateProfile(profile);
+    appHelper.SetAttribute("SamplingMode", StringValue(rateProfileMode));
+    appHelper.SetPacketSize(packetSize);
+    if (perDeviceStreams || crn)
+    {
+      appHelper.SetPerDeviceStreams(trafficStreamBase);
+    }
+    appContainer = appHelper.Install(endDevices);
+  }
 
   appContainer.Start(Seconds(0));
   appContainer.Stop(appStopTime);
 
+  // Alarm storms from the devices of one region
+  if (burstInterval > 0)
+  {
+    if (liteEndDevices)
+    {
+      NS_FATAL_ERROR("The lite end devices don't support alarm storms");
+    }
+    burstGenerator = CreateObject<BurstTrafficGenerator> ();
+    burstGenerator->SetDevices(endDevices);
+    burstGenerator->SetRegion(Vector(burstX, burstY, 0), burstRadius);
+    burstGenerator->SetPacketSize(packetSize);
+    burstGenerator->SetAttribute("Jitter", TimeValue(Seconds(burstJitter)));
+    burstGenerator->SetAttribute("Retries", UintegerValue(burstRetries));
+    if (crn)
+    {
+      stream += burstGenerator->AssignStreams(stream);
+    }
+    burstGenerator->SchedulePoissonBursts(Seconds(0), appStopTime, Seconds(burstInterval));
+  }
+
   /**************************
    *Create Network Server  *
    ***************************/
 
- 	// Create the NS node
-  NodeContainer networkServer;
-  networkServer.Create(1);
+ 	// The lite end devices are unknown to the network server and never listen
+ 	// to downlinks, their uplinks end at the gateways
+  if (!liteEndDevices)
+  {
+   	// Create the NS node
+    NodeContainer networkServer;
+    networkServer.Create(1);
 
- 	// Create a NS for the network
-  nsHelper.SetEndDevices(endDevices);
-  nsHelper.SetGateways(gateways);
-  nsHelper.Install(networkServer);
+   	// Create a NS for the network
+    nsHelper.SetEndDevices(endDevices);
+    nsHelper.SetGateways(gateways);
+    nsHelper.Install(networkServer);
 
- 	//Create a forwarder for each gateway
-  forHelper.Install(gateways);
+   	//Create a forwarder for each gateway
+    forHelper.Install(gateways);
+  }
 
  	////////////////
  	// Simulation	//
  	////////////////
   Simulator::Stop(appStopTime + Hours(1));
 
+  // Stop as soon as the network has drained, the fixed stop is only a bound
+  Ptr<DrainDetector> drainDetector;
+  if (earlyStop)
+  {
+    drainDetector = CreateObject<DrainDetector> ();
+    drainDetector->SetEndDevices(endDevices);
+    drainDetector->SetGateways(gateways);
+    drainDetector->SetPendingPacketsCallback(MakeCallback(&PacketsPending));
+    if (liteDevices)
+    {
+      liteDevices->TraceConnectWithoutContext("StartSending",
+        MakeCallback(&DrainDetector::NotifyActivity, drainDetector));
+    }
+    drainDetector->Start(appStopTime);
+  }
+
+  // Steady state of the PDR, which can end the run, and of the throughput
+  Ptr<SteadyStateMonitor> pdrMonitor;
+  Ptr<SteadyStateMonitor> throughputMonitor;
+  if (steadyState)
+  {
+    double window = steadyWindow > 0 ? steadyWindow : simulationTime / 60;
+    pdrMonitor = Create<SteadyStateMonitor>(Seconds(window), steadyTolerance);
+    pdrMonitor->SetSource(MakeCallback(&CountReceived), MakeCallback(&CountSent));
+    pdrMonitor->SetStopWhenSteady(steadyStop);
+    pdrMonitor->Start(Seconds(0));
+    throughputMonitor = Create<SteadyStateMonitor>(Seconds(window), steadyTolerance);
+    throughputMonitor->SetSource(MakeCallback(&CountReceivedBits), Callback<double>());
+    throughputMonitor->Start(Seconds(0));
+  }
+
   NS_LOG_INFO("Running simulation...");
+  ScenarioProfiler::Get().EndSetup();
   Simulator::Run();
+  ScenarioProfiler::Get().EndRun();
+
+  if (BinaryLog::Enabled())
+  {
+    BinaryLog::Get().DumpToFile(binaryLogFile, true);
+    BinaryLog::Get().Clear();
+  }
+
+  if (drainDetector)
+  {
+    NS_LOG_INFO("Simulation ended at " << Simulator::Now().GetSeconds() << " s, " << drainDetector->GetReason());
+  }
 
   Simulator::Destroy();
+  liteDevices = 0;
+
+  // The packets still in flight when the run stopped
+  packetTracker.clear();
+  NS_LOG_INFO("Run arena: " << RunArena::Get().GetPeakBytes() << " bytes at the peak, "
+    << RunArena::Get().GetReservedBytes() << " reserved");
+  RunArena::Get().Release();
 
  	///////////////////////////
  	// Print results to file	//
@@ -477,12 +929,295 @@ void Experiment::Run(Ptr<RandomVariableStream> trafficDistribution){
             << "\nProbabilidad de No Recepcion:" << noMoreReceiversProb
             << "\nProbabilidad de Recepcion dada una alta Sensibilidad:" << receivedProbGivenAboveSensitivity
             << "\nProbabilidad de Interferencia dada una alta Sensibilidad:" << interferedProbGivenAboveSensitivity
-            << "\nProbabilidad de No Recepcion dada una alta Sensibilidad:" << noMoreReceiversProbGivenAboveSensitivity << "\n\n";
+            << "\nProbabilidad de No Recepcion dada una alta Sensibilidad:" << noMoreReceiversProbGivenAboveSensitivity
+            << "\nEntregas a gateways descartadas por alcance:" << culledDeliveries << "\n\n";
   
+  if (burstGenerator)
+  {
+    std::cout << "Rafagas:" << burstGenerator->GetBurstCount()
+              << "\nPaquetes de Rafaga:" << burstGenerator->GetSentPackets() << "\n";
+    burstGenerator = 0;
+  }
+  if (print)
+  {
+    gatewayDeployment->WriteStats("gateways.txt");
+  }
+  PrintPeak("Pico de Interferencia", interferedPerWindow);
+  PrintPeak("Pico de No Recepcion", noMoreReceiversPerWindow);
+
   LoraPacketTracker &tracker = helper.GetPacketTracker();
   std::cout << "Tx Packets\tRxPackets\n";
   std::cout << tracker.CountMacPacketsGlobally(Seconds(0), appStopTime + Hours(1)) << std::endl;
-  
+
+  RunMetrics metrics;
+  metrics.pdr = receivedProb;
+  metrics.throughput = double(received) * 8 * packetSize / double(simulationTime);
+  if (pdrMonitor)
+  {
+    pdrMonitor->Finish();
+    throughputMonitor->Finish();
+    if (pdrMonitor->IsSteady())
+    {
+      std::cout << "Estado estacionario alcanzado a los " << pdrMonitor->GetSteadyTime().GetSeconds() << " s";
+    }
+    else
+    {
+      std::cout << "Estado estacionario no alcanzado";
+    }
+    std::cout << ", calentamiento descartado hasta " << pdrMonitor->GetWarmupEnd().GetSeconds() << " s"
+              << "\nProbabilidad de Recepcion estacionaria:" << pdrMonitor->GetEstimate()
+              << " +- " << pdrMonitor->GetHalfWidth()
+              << "\nThrougput estacionario:" << throughputMonitor->GetEstimate() << " bps\n";
+    metrics.pdr = pdrMonitor->GetEstimate();
+    metrics.throughput = throughputMonitor->GetEstimate();
+  }
+  return metrics;
+}
+
+/**
+ * A new traffic distribution, each replication needs its own streams
+ */
+Ptr<RandomVariableStream> CreateTrafficDistribution(std::string name, bool mirrored)
+{
+  if (name == "uniform")
+  {
+    return CreateObjectWithAttributes<UniformRandomVariable>("Min", DoubleValue(0), "Max", DoubleValue(10),
+      "Antithetic", BooleanValue(mirrored));
+  }
+  if (name == "exponential")
+  {
+    return CreateObjectWithAttributes<ExponentialRandomVariable>("Mean", DoubleValue(2), "Bound", DoubleValue(10),
+      "Antithetic", BooleanValue(mirrored));
+  }
+  if (name == "weibull")
+  {
+    return CreateObjectWithAttributes<WeibullRandomVariable>("Scale", DoubleValue(2), "Shape", DoubleValue(10),
+      "Antithetic", BooleanValue(mirrored));
+  }
+  // The rate profile doesn't use a distribution
+  return 0;
+}
+
+/**
+ * The scheduler type of a short name; they all run the events in the same
+ * order, so the results don't depend on it
+ */
+TypeId GetSchedulerType(std::string name)
+{
+  if (name == "ladder")
+  {
+    return LadderScheduler::GetTypeId();
+  }
+  if (name == "priority")
+  {
+    return TypeId::LookupByName("ns3::PriorityQueueScheduler");
+  }
+  if (name == "calendar")
+  {
+    return TypeId::LookupByName("ns3::CalendarScheduler");
+  }
+  if (name == "heap")
+  {
+    return TypeId::LookupByName("ns3::HeapScheduler");
+  }
+  if (name == "list")
+  {
+    return TypeId::LookupByName("ns3::ListScheduler");
+  }
+  if (name == "map")
+  {
+    return TypeId::LookupByName("ns3::MapScheduler");
+  }
+  NS_FATAL_ERROR("Unknown scheduler " << name);
+  return TypeId();
+}
+
+/**
+ * The key of a run in the result store: every parameter the metrics depend on
+ */
+ConfigHash CreateRunKey(Ptr<RandomVariableStream> trafficDistribution)
+{
+  ConfigHash key;
+  key.Add("scenario", "lorawan")
+    .Add("build", ResultStore::GetBuild())
+    .Add("nDevices", nDevices)
+    .Add("nGateways", nGateways)
+    .Add("gatewaySpacing", gatewaySpacing)
+    .Add("radius", radius)
+    .Add("simulationTime", simulationTime)
+    .Add("packetSize", packetSize)
+    .Add("liteEndDevices", liteEndDevices)
+    .Add("realisticChannelModel", realisticChannelModel)
+    .Add("boundedShadowing", boundedShadowing)
+    .Add("gatewayCulling", gatewayCulling)
+    .Add("cullingMargin", cullingMargin)
+    .Add("indexedInterference", indexedInterference)
+    .Add("earlyStop", earlyStop)
+    .Add("perDeviceStreams", perDeviceStreams)
+    .Add("trafficStreamBase", trafficStreamBase)
+    .Add("crn", crn)
+    .Add("rateProfileMode", rateProfileMode)
+    .Add("rateProfileResolution", rateProfileResolution)
+    .Add("burstInterval", burstInterval)
+    .Add("burstX", burstX)
+    .Add("burstY", burstY)
+    .Add("burstRadius", burstRadius)
+    .Add("burstJitter", burstJitter)
+    .Add("burstRetries", burstRetries)
+    .Add("steadyState", steadyState)
+    .Add("steadyWindow", steadyWindow)
+    .Add("steadyTolerance", steadyTolerance)
+    .Add("steadyStop", steadyStop)
+    .Add("seed", RngSeedManager::GetSeed())
+    .Add("run", RngSeedManager::GetRun());
+  if (gatewayLayout == "single" || gatewayLayout == "hexagonal")
+  {
+    key.Add("gatewayLayout", gatewayLayout);
+  }
+  else
+  {
+    key.AddFile("gatewayLayout", gatewayLayout);
+  }
+  if (!rateProfile.empty())
+  {
+    key.AddFile("rateProfile", rateProfile);
+  }
+  if (trafficDistribution)
+  {
+    key.AddAttributes("traffic", trafficDistribution);
+  }
+  return key;
+}
+
+/**
+ * Run a configuration once, or read its metrics from the result store
+ */
+RunMetrics RunOnce(Experiment &experiment, std::string name, bool mirrored)
+{
+  // Every run draws from the same automatic streams, whatever the runs made
+  // before it in the process: the random variables without a fixed stream
+  // are then common to the compared distributions, and a stored run is the
+  // one that would be simulated
+  RngSeedManager::ResetNextStreamIndex();
+  if (resultStore.empty())
+  {
+    return experiment.Run(CreateTrafficDistribution(name, mirrored));
+  }
+
+  Ptr<RandomVariableStream> trafficDistribution = CreateTrafficDistribution(name, mirrored);
+  ConfigHash key = CreateRunKey(trafficDistribution);
+  ResultStore store(resultStore);
+  std::map<std::string, double> values;
+  RunMetrics metrics;
+  if (!forceRun && store.Lookup(key, values))
+  {
+    metrics.pdr = values["pdr"];
+    metrics.throughput = values["throughput"];
+    std::cout << "Resultado guardado " << store.GetFilename(key)
+              << "\nProbabilidad de Recepcion:" << metrics.pdr
+              << "\nThrougput:" << metrics.throughput << " bps\n";
+    return metrics;
+  }
+  metrics = experiment.Run(trafficDistribution);
+  values["pdr"] = metrics.pdr;
+  values["throughput"] = metrics.throughput;
+  store.Store(key, values);
+  return metrics;
+}
+
+/**
+ * Run one replication of a configuration: a single run, or the mean of an
+ * antithetic pair
+ */
+RunMetrics RunReplication(Experiment &experiment, std::string name)
+{
+  RunMetrics metrics = RunOnce(experiment, name, false);
+  if (antithetic && name != "profile")
+  {
+    RunMetrics mirror = RunOnce(experiment, name, true);
+    metrics.pdr = (metrics.pdr + mirror.pdr) / 2;
+    metrics.throughput = (metrics.throughput + mirror.throughput) / 2;
+  }
+  return metrics;
+}
+
+/**
+ * Run a configuration once, or as many times as the replication controller
+ * asks for, and print the confidence intervals
+ *
+ * \returns the metrics of every replication
+ */
+std::vector<RunMetrics> RunConfiguration(Experiment &experiment, std::string name)
+{
+  std::vector<RunMetrics> replications;
+  if (ciWidth <= 0)
+  {
+    replications.push_back(RunReplication(experiment, name));
+    return replications;
+  }
+
+  ReplicationController controller(ciWidth, ciConfidence, minReplications, maxReplications);
+  controller.AddMetric("pdr");
+  controller.AddMetric("throughput");
+  controller.SetTarget(ciMetric);
+  uint32_t firstRun = RngSeedManager::GetRun();
+  while (!controller.Done())
+  {
+    RngSeedManager::SetRun(firstRun + controller.GetRuns());
+    RunMetrics metrics = RunReplication(experiment, name);
+    replications.push_back(metrics);
+    controller.Record("pdr", metrics.pdr);
+    controller.Record("throughput", metrics.throughput);
+    controller.EndReplication();
+  }
+  RngSeedManager::SetRun(firstRun);
+
+  std::cout << "Replicas:" << controller.GetRuns()
+            << (controller.Converged() ? "" : " (sin alcanzar el intervalo pedido)") << "\n";
+  for (uint32_t i = 0; i < controller.GetNMetrics(); i++)
+  {
+    const ReplicationMetric &metric = controller.GetMetric(i);
+    std::cout << metric.name << ": " << metric.mean << " +- " << controller.GetHalfWidth(i)
+              << " (" << ciConfidence * 100 << "%)\n";
+  }
+  return replications;
+}
+
+/**
+ * Print the confidence intervals of the differences between every two
+ * configurations, paired by replication. Under common random numbers the
+ * replications i of all the configurations share the network, so the
+ * differences vary much less than the configurations themselves.
+ */
+void PrintDifferences(const std::vector<std::string> &names, const std::vector<std::vector<RunMetrics> > &results)
+{
+  for (uint32_t a = 0; a < names.size(); a++)
+  {
+    for (uint32_t b = a + 1; b < names.size(); b++)
+    {
+      uint32_t pairs = std::min(results[a].size(), results[b].size());
+      if (pairs < 2)
+      {
+        continue;
+      }
+      ReplicationController differences(1, ciConfidence, pairs, pairs);
+      differences.AddMetric("pdr");
+      differences.AddMetric("throughput");
+      for (uint32_t i = 0; i < pairs; i++)
+      {
+        differences.Record("pdr", results[a][i].pdr - results[b][i].pdr);
+        differences.Record("throughput", results[a][i].throughput - results[b][i].throughput);
+      }
+      std::cout << "Diferencia " << names[a] << " - " << names[b] << " (" << pairs << " replicas emparejadas)\n";
+      for (uint32_t i = 0; i < differences.GetNMetrics(); i++)
+      {
+        const ReplicationMetric &metric = differences.GetMetric(i);
+        double halfWidth = differences.GetHalfWidth(i);
+        std::cout << metric.name << ": " << metric.mean << " +- " << halfWidth
+                  << (std::abs(metric.mean) > halfWidth ? " (significativa)" : " (no significativa)") << "\n";
+      }
+    }
+  }
 }
 
 int
@@ -492,24 +1227,133 @@ main(int argc, char *argv[])
   CommandLine cmd;
   cmd.AddValue("nDevices", "Number of end devices to include in the simulation", nDevices);
   cmd.AddValue("radius", "The radius of the area to simulate", radius);
+  cmd.AddValue("nGateways", "Number of gateways of the single and hexagonal layouts", nGateways);
+  cmd.AddValue("gatewayLayout", "Gateway layout: single, hexagonal or a file of \"x y [z]\" lines", gatewayLayout);
+  cmd.AddValue("gatewaySpacing", "Distance between the gateways of the hexagonal layout, 0 to cover the radius", gatewaySpacing);
   cmd.AddValue("simulationTime", "The time for which to simulate", simulationTime);
   cmd.AddValue("packetSize", "Packet size (bytes)", packetSize);
+  cmd.AddValue("realisticChannelModel", "Whether the channel adds correlated shadowing and buildings to the log-distance loss", realisticChannelModel);
+  cmd.AddValue("liteEndDevices", "Whether the end devices are compact transmit-only records instead of nodes, needs realisticChannelModel=false", liteEndDevices);
+  cmd.AddValue("boundedShadowing", "Whether the shadowing is hashed from grid values instead of kept in a growing map", boundedShadowing);
+  cmd.AddValue("gatewayCulling", "Whether to skip the gateways that can't decode an uplink even in the best case", gatewayCulling);
+  cmd.AddValue("cullingMargin", "Margin (dB) over the log-distance loss of the gateway culling, a few shadowing sigmas to keep the PDR", cullingMargin);
+  cmd.AddValue("indexedInterference", "Whether the gateways index the receptions per frequency and SF to check the interference", indexedInterference);
   cmd.AddValue("print", "Whether or not to print various informations", print);
+  cmd.AddValue("earlyStop", "Whether to stop as soon as the network drains after the senders stop", earlyStop);
+  cmd.AddValue("perDeviceStreams", "Whether each end device draws its traffic from its own random stream", perDeviceStreams);
+  cmd.AddValue("crn", "Whether the compared distributions share the random streams of the network", crn);
+  cmd.AddValue("antithetic", "Whether each replication is a pair of runs with antithetic traffic, implies crn", antithetic);
+  cmd.AddValue("trafficStreamBase", "First random stream used by the per-device traffic streams", trafficStreamBase);
+  cmd.AddValue("rateProfile", "File with a periodic rate table to use instead of the traffic distributions", rateProfile);
+  cmd.AddValue("rateProfileMode", "How arrivals are sampled from the rate table (Inversion or Thinning)", rateProfileMode);
+  cmd.AddValue("rateProfileResolution", "Width of the rate table bins (seconds)", rateProfileResolution);
+  cmd.AddValue("burstInterval", "Mean time between alarm storms (s), 0 disables them", burstInterval);
+  cmd.AddValue("burstX", "X coordinate of the center of the storm region", burstX);
+  cmd.AddValue("burstY", "Y coordinate of the center of the storm region", burstY);
+  cmd.AddValue("burstRadius", "Radius of the storm region, 0 includes every device", burstRadius);
+  cmd.AddValue("burstJitter", "Time over which the uplinks of a storm are spread (s)", burstJitter);
+  cmd.AddValue("burstRetries", "How many times each device repeats its storm uplink", burstRetries);
+  cmd.AddValue("peakWindow", "Width of the windows used to find the loss peaks (s)", peakWindow);
+  cmd.AddValue("distribution", "Traffic distribution to simulate: all, uniform, exponential or weibull", distribution);
+  cmd.AddValue("steadyState", "Whether to drop the warm-up and stop the run once the PDR is steady", steadyState);
+  cmd.AddValue("steadyWindow", "Width of the windows the PDR is sampled in (s), 0 derives it from the simulation time", steadyWindow);
+  cmd.AddValue("steadyTolerance", "Relative half width of the batch means interval of a steady PDR", steadyTolerance);
+  cmd.AddValue("steadyStop", "Whether to stop the run once the PDR is steady", steadyStop);
+  cmd.AddValue("ciWidth", "Relative half width of the confidence interval that stops the replications, 0 runs once", ciWidth);
+  cmd.AddValue("ciConfidence", "Confidence level of the interval", ciConfidence);
+  cmd.AddValue("ciMetric", "Metric whose interval stops the replications: pdr or throughput", ciMetric);
+  cmd.AddValue("minReplications", "Replications made before checking the interval", minReplications);
+  cmd.AddValue("maxReplications", "Replications made at most", maxReplications);
+
+  cmd.AddValue("resultStore", "Directory of the results reused by the runs with the same configuration, empty to disable it", resultStore);
+  cmd.AddValue("forceRun", "Whether to simulate the runs the result store already holds, replacing their records", forceRun);
+
+  cmd.AddValue("profile", "Prefix of the JSON profile written after each run, empty to disable profiling", profile);
+  cmd.AddValue("scheduler", "Event scheduler: map, list, heap, calendar, priority or ladder", scheduler);
+  cmd.AddValue("verbose", "Whether to log every level of the scenario as text", verbose);
+  cmd.AddValue("binaryLog", "Records kept by the binary log, 0 disables it", binaryLog);
+  cmd.AddValue("binaryLogFile", "File the binary log is written to after each run", binaryLogFile);
 
   cmd.Parse(argc, argv);
 
+ 	// The lite devices share a proxy node, so none of them can be inside a building
+  if (liteEndDevices && realisticChannelModel)
+  {
+    NS_FATAL_ERROR("The lite end devices don't support the buildings of the realistic channel model, set realisticChannelModel=false");
+  }
+
+  gatewayDeployment = CreateObject<GatewayDeployment> ();
+  if (gatewayLayout == "single")
+  {
+    gatewayDeployment->SetSingle(nGateways);
+  }
+  else if (gatewayLayout == "hexagonal")
+  {
+    gatewayDeployment->SetHexagonal(nGateways, gatewaySpacing > 0 ? gatewaySpacing :
+      GatewayDeployment::GetCoveringSpacing(nGateways, radius));
+  }
+  else
+  {
+    gatewayDeployment->LoadLayout(gatewayLayout);
+  }
+  nGateways = gatewayDeployment->GetN();
+  // The two runs of a pair are only mirrored if everything else is common
+  crn = crn || antithetic;
+
+  // Every simulator created from now on uses it, the profiler wraps it
+  TypeId schedulerType = GetSchedulerType(scheduler);
+  GlobalValue::Bind("SchedulerType", TypeIdValue(schedulerType));
+  ScenarioProfiler::Get().SetInnerScheduler(schedulerType);
+  if (!profile.empty())
+  {
+    ScenarioProfiler::Get().Enable("lorawan", profile);
+  }
+
  	// Set up logging
-  LogComponentEnable("LorawanNetworkSimulation", LOG_LEVEL_ALL);
+  LogComponentEnable("LorawanNetworkSimulation", verbose ? LOG_LEVEL_ALL : LOG_LEVEL_INFO);
+  if (binaryLog > 0)
+  {
+    // Every run appends its records, a crash leaves the raw buffer next to them
+    std::ofstream(binaryLogFile.c_str(), std::ios::trunc);
+    BinaryLog::Get().Enable(binaryLog);
+    BinaryLog::Get().InstallCrashHandler(binaryLogFile + ".crash");
+  }
 
   Experiment experiment;
-  NS_LOG_INFO("\nDistribución Uniforme");
-  experiment.Run(CreateObjectWithAttributes<UniformRandomVariable>("Min", DoubleValue(0), "Max", DoubleValue(10)));
+  if (!rateProfile.empty())
+  {
+    NS_LOG_INFO("\nPerfil de tasa variable");
+    RunConfiguration(experiment, "profile");
+    return 0;
+  }
 
-  NS_LOG_INFO("\nDistribución Exponencial");
-  experiment.Run(CreateObjectWithAttributes<ExponentialRandomVariable>("Mean", DoubleValue(2), "Bound", DoubleValue(10)));
+  std::vector<std::string> names;
+  std::vector<std::vector<RunMetrics> > results;
+  if (distribution == "all" || distribution == "uniform")
+  {
+    NS_LOG_INFO("\nDistribución Uniforme");
+    names.push_back("uniform");
+    results.push_back(RunConfiguration(experiment, "uniform"));
+  }
 
-  NS_LOG_INFO("\nDistribución Video on Demand");
-  experiment.Run(CreateObjectWithAttributes<WeibullRandomVariable>("Scale", DoubleValue(2), "Shape", DoubleValue(10)));
+  if (distribution == "all" || distribution == "exponential")
+  {
+    NS_LOG_INFO("\nDistribución Exponencial");
+    names.push_back("exponential");
+    results.push_back(RunConfiguration(experiment, "exponential"));
+  }
+
+  if (distribution == "all" || distribution == "weibull")
+  {
+    NS_LOG_INFO("\nDistribución Video on Demand");
+    names.push_back("weibull");
+    results.push_back(RunConfiguration(experiment, "weibull"));
+  }
+
+  if (crn)
+  {
+    PrintDifferences(names, results);
+  }
 
   return 0;
 }
\ No newline at end of file
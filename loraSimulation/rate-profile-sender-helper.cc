@@ -0,0 +1,90 @@
+/*-*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+  Application helper that installs RateProfileSender applications following a
+  shared rate profile.
+ */
+#include "rate-profile-sender-helper.h"
+#include "rate-profile-sender.h"
+#include "ns3/log.h"
+
+namespace ns3
+{
+  namespace lorawan
+  {
+
+    NS_LOG_COMPONENT_DEFINE("RateProfileSenderHelper");
+
+    RateProfileSenderHelper::RateProfileSenderHelper()
+    {
+      m_factory.SetTypeId("ns3::RateProfileSender");
+
+      m_pktSize = 10;
+      m_streamBase = -1;
+    }
+
+    RateProfileSenderHelper::~RateProfileSenderHelper() {}
+
+    void
+    RateProfileSenderHelper::SetAttribute(std::string name, const AttributeValue &value)
+    {
+      m_factory.Set(name, value);
+    }
+
+    ApplicationContainer
+    RateProfileSenderHelper::Install(Ptr<Node> node) const
+    {
+      return ApplicationContainer(InstallPriv(node));
+    }
+
+    ApplicationContainer
+    RateProfileSenderHelper::Install(NodeContainer c) const
+    {
+      ApplicationContainer apps;
+      for (NodeContainer::Iterator i = c.Begin(); i != c.End(); ++i)
+      {
+        apps.Add(InstallPriv(*i));
+      }
+
+      return apps;
+    }
+
+    Ptr<Application>
+    RateProfileSenderHelper::InstallPriv(Ptr<Node> node) const
+    {
+      NS_LOG_FUNCTION(this << node);
+      NS_ASSERT(m_profile != 0);
+
+      Ptr<RateProfileSender> app = m_factory.Create<RateProfileSender> ();
+      app->SetRateProfile(m_profile);
+      app->SetPacketSize(m_pktSize);
+      if (m_streamBase >= 0)
+      {
+        app->AssignStreams(m_streamBase + node->GetId());
+      }
+
+      app->SetNode(node);
+      node->AddApplication(app);
+
+      return app;
+    }
+
+    void
+    RateProfileSenderHelper::SetRateProfile(Ptr<RateProfile> profile)
+    {
+      m_profile = profile;
+    }
+
+    void
+    RateProfileSenderHelper::SetPacketSize(uint8_t size)
+    {
+      m_pktSize = size;
+    }
+
+    void
+    RateProfileSenderHelper::SetPerDeviceStreams(int64_t streamBase)
+    {
+      NS_ASSERT(streamBase >= 0);
+      m_streamBase = streamBase;
+    }
+  }
+}	// namespace ns3
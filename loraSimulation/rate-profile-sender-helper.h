@@ -0,0 +1,71 @@
+/*-*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+  Application helper that installs RateProfileSender applications following a
+  shared rate profile.
+ */
+
+#ifndef RATE_PROFILE_SENDER_HELPER_H
+#define RATE_PROFILE_SENDER_HELPER_H
+#include "ns3/object-factory.h"
+#include "ns3/address.h"
+#include "ns3/attribute.h"
+#include "ns3/net-device.h"
+#include "ns3/node-container.h"
+#include "ns3/application-container.h"
+#include "rate-profile-sender.h"
+#include <stdint.h>
+#include <string>
+
+namespace ns3
+{
+  namespace lorawan
+  {
+
+    /**
+     *This class can be used to install RateProfileSender applications on a
+     *wide range of nodes. All the applications follow the same profile, which
+     *is only built once.
+     */
+    class RateProfileSenderHelper
+    {
+      public:
+      RateProfileSenderHelper();
+
+      ~RateProfileSenderHelper();
+
+      void SetAttribute(std::string name, const AttributeValue &value);
+
+      ApplicationContainer Install(NodeContainer c) const;
+
+      ApplicationContainer Install(Ptr<Node> node) const;
+
+      /**
+       *Set the profile followed by the applications. The profile must already
+       *be built.
+       */
+      void SetRateProfile(Ptr<RateProfile> profile);
+
+      void SetPacketSize(uint8_t size);
+
+      /**
+       *Draw the arrivals of each device from the stream streamBase + node id,
+       *see RandomPeriodicSenderHelper::SetPerDeviceStreams.
+       */
+      void SetPerDeviceStreams(int64_t streamBase);
+
+      private:
+        Ptr<Application> InstallPriv(Ptr<Node> node) const;
+
+      ObjectFactory m_factory;
+
+      Ptr<RateProfile> m_profile;
+
+      uint8_t m_pktSize;	// the packet size.
+
+      int64_t m_streamBase;	// first per-device stream, or -1 for automatic streams
+
+    };
+  }	// namespace ns3
+}
+
+#endif /*RATE_PROFILE_SENDER_HELPER_H */
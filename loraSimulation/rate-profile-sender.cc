@@ -0,0 +1,373 @@
+/*-*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+  Application that sends packets following a non-homogeneous Poisson process.
+  The arrival rate is read from a periodic piecewise rate table (for example a
+  daily load curve) and arrivals are sampled either by thinning or by inverting
+  the precomputed cumulative intensity.
+ */
+#include "rate-profile-sender.h"
+#include "ns3/pointer.h"
+#include "ns3/log.h"
+#include "ns3/double.h"
+#include "ns3/enum.h"
+#include "ns3/string.h"
+#include "ns3/lora-net-device.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+namespace ns3
+{
+  namespace lorawan
+  {
+
+    NS_LOG_COMPONENT_DEFINE("RateProfileSender");
+
+    NS_OBJECT_ENSURE_REGISTERED(RateProfileSender);
+
+    RateProfile::RateProfile(): m_period(Hours(24).GetSeconds()),
+      m_binWidth(0),
+      m_maxRate(0)
+    {
+    }
+
+    void
+    RateProfile::AddSegment(Time start, double packetsPerHour)
+    {
+      NS_ASSERT(packetsPerHour >= 0);
+      m_segments.push_back(std::make_pair(start.GetSeconds(), packetsPerHour / 3600));
+    }
+
+    bool
+    RateProfile::IsTime(std::string field)
+    {
+     	// Time(std::string) aborts on what it can't parse, so the unit is
+     	// checked first
+      const char *begin = field.c_str();
+      char *end;
+      std::strtod(begin, &end);
+      if (end == begin)
+      {
+        return false;
+      }
+      std::string unit(end);
+      return unit.empty() || unit == "s" || unit == "ms" || unit == "us" || unit == "ns" || unit == "ps"
+             || unit == "fs" || unit == "min" || unit == "h" || unit == "d" || unit == "y";
+    }
+
+    bool
+    RateProfile::LoadFromFile(std::string filename)
+    {
+      std::ifstream file(filename.c_str());
+      if (!file.is_open())
+      {
+        NS_LOG_ERROR("Can't open rate profile " << filename);
+        return false;
+      }
+
+      std::string line;
+      uint32_t lineNumber = 0;
+      while (std::getline(file, line))
+      {
+        lineNumber++;
+        std::istringstream fields(line);
+        std::string first;
+        if (!(fields >> first) || first[0] == '#')
+        {
+          continue;
+        }
+
+        std::string second;
+        std::string extra;
+        if (!(fields >> second) || fields >> extra)
+        {
+          NS_LOG_ERROR(filename << ":" << lineNumber << ": expected two fields in \"" << line << "\"");
+          return false;
+        }
+
+        if (first == "period")
+        {
+          if (!IsTime(second) || !Time(second).IsStrictlyPositive())
+          {
+            NS_LOG_ERROR(filename << ":" << lineNumber << ": bad period " << second);
+            return false;
+          }
+          SetPeriod(Time(second));
+          continue;
+        }
+
+        char *end;
+        double packetsPerHour = std::strtod(second.c_str(), &end);
+        if (!IsTime(first) || Time(first).IsStrictlyNegative() || *end != '\0' || end == second.c_str()
+            || !(packetsPerHour >= 0) || std::isinf(packetsPerHour))
+        {
+          NS_LOG_ERROR(filename << ":" << lineNumber << ": bad segment \"" << line << "\"");
+          return false;
+        }
+        AddSegment(Time(first), packetsPerHour);
+      }
+      return !m_segments.empty();
+    }
+
+    void
+    RateProfile::SetPeriod(Time period)
+    {
+      NS_ASSERT(period.IsStrictlyPositive());
+      m_period = period.GetSeconds();
+    }
+
+    Time
+    RateProfile::GetPeriod(void) const
+    {
+      return Seconds(m_period);
+    }
+
+    void
+    RateProfile::Build(Time resolution)
+    {
+      NS_ASSERT(!m_segments.empty());
+
+      for (std::vector<std::pair<double, double> >::iterator it = m_segments.begin(); it != m_segments.end(); ++it)
+      {
+        it->first = std::fmod(it->first, m_period);
+      }
+      std::sort(m_segments.begin(), m_segments.end());
+
+      uint32_t nBins = std::max(1.0, std::ceil(m_period / resolution.GetSeconds()));
+      m_binWidth = m_period / nBins;
+      m_binRate.assign(nBins, 0);
+
+     	// Integrate the piecewise constant rate over each bin. Before the first
+     	// segment the rate of the last one still holds.
+      std::vector<std::pair<double, double> > pieces;
+      if (m_segments.front().first > 0)
+      {
+        pieces.push_back(std::make_pair(0.0, m_segments.back().second));
+      }
+      pieces.insert(pieces.end(), m_segments.begin(), m_segments.end());
+      for (uint32_t k = 0; k < pieces.size(); k++)
+      {
+        double start = pieces[k].first;
+        double end = k + 1 < pieces.size() ? pieces[k + 1].first : m_period;
+        uint32_t lastBin = std::min<uint32_t> (nBins - 1, end / m_binWidth);
+        for (uint32_t i = start / m_binWidth; i <= lastBin; i++)
+        {
+          double overlap = std::min(end, (i + 1) * m_binWidth) - std::max(start, i * m_binWidth);
+          if (overlap > 0)
+          {
+            m_binRate[i] += pieces[k].second * overlap;
+          }
+        }
+      }
+
+      m_cumulative.assign(nBins + 1, 0);
+      m_maxRate = 0;
+      for (uint32_t i = 0; i < nBins; i++)
+      {
+        m_binRate[i] /= m_binWidth;
+        m_cumulative[i + 1] = m_cumulative[i] + m_binRate[i] * m_binWidth;
+        m_maxRate = std::max(m_maxRate, m_binRate[i]);
+      }
+
+     	// m_guide[k] is the first bin whose upper edge exceeds k / nBins of the
+     	// total intensity: the inversion only walks forward from there.
+      double total = m_cumulative.back();
+      m_guide.assign(nBins, 0);
+      uint32_t j = 0;
+      for (uint32_t k = 0; k < nBins; k++)
+      {
+        while (j + 1 < nBins && m_cumulative[j + 1] <= k * total / nBins)
+        {
+          j++;
+        }
+        m_guide[k] = j;
+      }
+
+      NS_LOG_DEBUG("Built rate profile with " << nBins << " bins, " << total <<
+        " packets per period, max rate " << m_maxRate * 3600 << " packets/h");
+    }
+
+    double
+    RateProfile::GetRate(Time t) const
+    {
+      double offset = std::fmod(t.GetSeconds(), m_period);
+      uint32_t bin = std::min<uint32_t> (m_binRate.size() - 1, offset / m_binWidth);
+      return m_binRate[bin];
+    }
+
+    double
+    RateProfile::GetMaxRate(void) const
+    {
+      return m_maxRate;
+    }
+
+    bool
+    RateProfile::HasArrivals(void) const
+    {
+      return !m_cumulative.empty() && m_cumulative.back() > 0;
+    }
+
+    double
+    RateProfile::GetCumulative(double offset, uint32_t &bin) const
+    {
+      bin = std::min<uint32_t> (m_binRate.size() - 1, offset / m_binWidth);
+      return m_cumulative[bin] + m_binRate[bin] * (offset - bin * m_binWidth);
+    }
+
+    Time
+    RateProfile::Invert(Time now, double e) const
+    {
+      NS_ASSERT(HasArrivals());
+
+      uint32_t nBins = m_binRate.size();
+      double total = m_cumulative.back();
+      double t = now.GetSeconds();
+      double cycles = std::floor(t / m_period);
+      uint32_t bin;
+      double target = GetCumulative(t - cycles * m_period, bin) + e;
+
+     	// Skip whole periods, then find the bin through the guide table
+      double wraps = std::floor(target / total);
+      target -= wraps * total;
+      uint32_t slice = std::min<uint32_t> (nBins - 1, target / total * nBins);
+      uint32_t j = m_guide[slice];
+      while (j + 1 < nBins && m_cumulative[j + 1] <= target)
+      {
+        j++;
+      }
+
+      double offset = j * m_binWidth;
+      if (m_binRate[j] > 0)
+      {
+        offset += (target - m_cumulative[j]) / m_binRate[j];
+      }
+      return Seconds((cycles + wraps) * m_period + offset);
+    }
+
+    TypeId
+    RateProfileSender::GetTypeId(void)
+    {
+      static TypeId tid = TypeId("ns3::RateProfileSender")
+        .SetParent<Application> ()
+        .AddConstructor<RateProfileSender> ()
+        .SetGroupName("lorawan")
+        .AddAttribute("SamplingMode", "How arrivals are sampled from the rate profile",
+          EnumValue(RateProfileSender::INVERSION),
+          MakeEnumAccessor(&RateProfileSender::m_mode),
+          MakeEnumChecker(RateProfileSender::THINNING, "Thinning",
+            RateProfileSender::INVERSION, "Inversion"));
+      return tid;
+    }
+
+    RateProfileSender::RateProfileSender(): m_mode(INVERSION),
+      m_basePktSize(10)
+    {
+      NS_LOG_FUNCTION_NOARGS();
+      m_uniform = CreateObject<UniformRandomVariable> ();
+    }
+
+    RateProfileSender::~RateProfileSender()
+    {
+      NS_LOG_FUNCTION_NOARGS();
+    }
+
+    void
+    RateProfileSender::SetRateProfile(Ptr<RateProfile> profile)
+    {
+      m_profile = profile;
+    }
+
+    void
+    RateProfileSender::SetPacketSize(uint8_t size)
+    {
+      m_basePktSize = size;
+    }
+
+    int64_t
+    RateProfileSender::AssignStreams(int64_t stream)
+    {
+      m_uniform->SetStream(stream);
+      return 1;
+    }
+
+    Time
+    RateProfileSender::GetNextArrival(Time now)
+    {
+      if (m_mode == INVERSION)
+      {
+        return m_profile->Invert(now, -std::log(1 - m_uniform->GetValue()));
+      }
+
+     	// Thinning: candidates at the maximum rate, each one kept with
+     	// probability rate(t) / maxRate. An arrival costs maxRate / meanRate
+     	// candidates on average, so a peaky profile makes it much slower than
+     	// the inversion.
+      double maxRate = m_profile->GetMaxRate();
+      double t = now.GetSeconds();
+      while (true)
+      {
+        t += -std::log(1 - m_uniform->GetValue()) / maxRate;
+        if (m_uniform->GetValue() * maxRate <= m_profile->GetRate(Seconds(t)))
+        {
+          return Seconds(t);
+        }
+      }
+    }
+
+    void
+    RateProfileSender::ScheduleNextArrival(void)
+    {
+      Time now = Simulator::Now();
+      Time delay = GetNextArrival(now) - now;
+      NS_LOG_DEBUG("Next packet in " << delay.GetSeconds() << " seconds");
+      m_sendEvent = Simulator::Schedule(delay, &RateProfileSender::SendPacket, this);
+    }
+
+    void
+    RateProfileSender::SendPacket(void)
+    {
+      NS_LOG_FUNCTION(this);
+
+      Ptr<Packet> packet = Create<Packet> (m_basePktSize);
+      m_mac->Send(packet);
+
+      ScheduleNextArrival();
+
+      NS_LOG_INFO("Sent a packet of size " << packet->GetSize());
+    }
+
+    void
+    RateProfileSender::StartApplication(void)
+    {
+      NS_LOG_FUNCTION(this);
+
+     	// Make sure we have a MAC layer
+      if (m_mac == 0)
+      {
+       	// Assumes there's only one device
+        Ptr<LoraNetDevice> loraNetDevice = m_node->GetDevice(0)->GetObject<LoraNetDevice> ();
+
+        m_mac = loraNetDevice->GetMac();
+        NS_ASSERT(m_mac != 0);
+      }
+
+      NS_ASSERT(m_profile != 0);
+      Simulator::Cancel(m_sendEvent);
+      if (!m_profile->HasArrivals())
+      {
+        NS_LOG_DEBUG("The rate profile is empty, no packet will be sent");
+        return;
+      }
+      ScheduleNextArrival();
+    }
+
+    void
+    RateProfileSender::StopApplication(void)
+    {
+      NS_LOG_FUNCTION_NOARGS();
+      Simulator::Cancel(m_sendEvent);
+    }
+  }
+}
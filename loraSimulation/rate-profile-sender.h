@@ -0,0 +1,208 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+  Application that sends packets following a non-homogeneous Poisson process.
+  The arrival rate is read from a periodic piecewise rate table (for example a
+  daily load curve) and arrivals are sampled either by thinning or by inverting
+  the precomputed cumulative intensity.
+ */
+
+#ifndef RATE_PROFILE_SENDER_H
+#define RATE_PROFILE_SENDER_H
+
+#include "ns3/application.h"
+#include "ns3/nstime.h"
+#include "ns3/lorawan-mac.h"
+#include "ns3/attribute.h"
+#include "ns3/random-variable-stream.h"
+#include "ns3/simple-ref-count.h"
+#include <string>
+#include <vector>
+
+namespace ns3 {
+namespace lorawan {
+
+/**
+ * A periodic, piecewise constant arrival rate.
+ *
+ * The segments are resampled on a uniform grid when the profile is built, so
+ * looking up the rate at a given time is a single index computation. The
+ * cumulative intensity at the bin edges is kept together with a guide table
+ * over its range, which makes the inversion of the cumulative intensity take
+ * constant expected time regardless of the number of bins.
+ */
+class RateProfile : public SimpleRefCount<RateProfile>
+{
+public:
+  RateProfile ();
+
+  /**
+   * Add a segment to the table. The rate holds from start until the start of
+   * the next segment, and the last segment wraps around to the first one.
+   *
+   * \param start The offset of the segment inside the period
+   * \param packetsPerHour The arrival rate of a single device
+   */
+  void AddSegment (Time start, double packetsPerHour);
+
+  /**
+   * Read the segments from a text file. Every line holds a start offset and a
+   * rate in packets per hour (for example "6h 12.5"), a line "period 24h"
+   * sets the period and lines starting with # are ignored.
+   *
+   * \returns false if the file can't be read, holds a malformed line (a
+   * missing or extra field, an unknown time unit, a negative rate or a null
+   * period) or holds no segments
+   */
+  bool LoadFromFile (std::string filename);
+
+  /**
+   * Set the period after which the profile repeats. Defaults to one day.
+   */
+  void SetPeriod (Time period);
+
+  Time GetPeriod (void) const;
+
+  /**
+   * Resample the segments on bins of the given width and precompute the
+   * cumulative intensity. Must be called after the last AddSegment.
+   */
+  void Build (Time resolution);
+
+  /**
+   * \returns the arrival rate at time t, in packets per second
+   */
+  double GetRate (Time t) const;
+
+  /**
+   * \returns the largest rate of the profile, in packets per second
+   */
+  double GetMaxRate (void) const;
+
+  /**
+   * \returns false if the profile has a null rate everywhere
+   */
+  bool HasArrivals (void) const;
+
+  /**
+   * Find the time at which the cumulative intensity has grown by e since now.
+   * With e drawn from a unit exponential this is the next arrival of the
+   * non-homogeneous Poisson process.
+   */
+  Time Invert (Time now, double e) const;
+
+private:
+  /**
+   * \returns true if Time can parse the field: a number with no unit or one
+   * of the units it knows
+   */
+  static bool IsTime (std::string field);
+
+  double GetCumulative (double offset, uint32_t &bin) const;
+
+  std::vector<std::pair<double, double> > m_segments; //!< (start, rate) in seconds and packets per second
+  double m_period;                                   //!< Period of the profile in seconds
+  double m_binWidth;                                 //!< Width of the resampling bins in seconds
+  std::vector<double> m_binRate;                     //!< Rate of each bin
+  std::vector<double> m_cumulative;                  //!< Cumulative intensity at the bin edges
+  std::vector<uint32_t> m_guide;                     //!< First bin reaching each slice of the intensity
+  double m_maxRate;                                  //!< Largest bin rate
+};
+
+class RateProfileSender : public Application
+{
+public:
+  /**
+   * THINNING draws candidates at the maximum rate and keeps each one with
+   * probability rate(t) / maxRate, which costs maxRate / meanRate candidates
+   * per arrival on average. INVERSION finds the arrival in the cumulative
+   * intensity through the guide table, in constant expected time.
+   */
+  enum SamplingMode
+  {
+    THINNING,
+    INVERSION
+  };
+
+  RateProfileSender ();
+  ~RateProfileSender ();
+
+  static TypeId GetTypeId (void);
+
+  /**
+   * Set the rate profile followed by this application
+   */
+  void SetRateProfile (Ptr<RateProfile> profile);
+
+  /**
+   * Set packet size
+   */
+  void SetPacketSize (uint8_t size);
+
+  /**
+   * Use a fixed stream for the random draws of this application
+   *
+   * \returns the number of streams used
+   */
+  int64_t AssignStreams (int64_t stream);
+
+  /**
+   * Send a packet using the LoraNetDevice's Send method
+   */
+  void SendPacket (void);
+
+  /**
+   * Start the application by scheduling the first SendPacket event
+   */
+  void StartApplication (void);
+
+  /**
+   * Stop the application
+   */
+  void StopApplication (void);
+
+private:
+  /**
+   * Sample the arrival following now
+   */
+  Time GetNextArrival (Time now);
+
+  /**
+   * Schedule the SendPacket event of the arrival following the current time
+   */
+  void ScheduleNextArrival (void);
+
+  /**
+   * The arrival rate profile
+   */
+  Ptr<RateProfile> m_profile;
+
+  /**
+   * How arrivals are sampled from the profile
+   */
+  enum SamplingMode m_mode;
+
+  /**
+   * The uniform draws used by both sampling methods
+   */
+  Ptr<UniformRandomVariable> m_uniform;
+
+  /**
+   * The sending event scheduled as next
+   */
+  EventId m_sendEvent;
+
+  /**
+   * The MAC layer of this node
+   */
+  Ptr<LorawanMac> m_mac;
+
+  /**
+   * The packet size.
+   */
+  uint8_t m_basePktSize;
+};
+
+} //namespace ns3
+
+}
+#endif /* RATE_PROFILE_SENDER_H */
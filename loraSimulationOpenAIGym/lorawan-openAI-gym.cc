@@ -36,6 +36,8 @@
 #include "ns3/building-allocator.h"
 #include "ns3/buildings-helper.h"
 #include "ns3/forwarder-helper.h"
+#include "drain-detector.h"
+#include "../binary-log.h"
 #include <algorithm>
 #include <ctime>
 #include <map>
@@ -97,7 +99,7 @@ Ptr<OpenGymSpace> MyGetObservationSpace(void)
   };
   std::string dtype = TypeNameGet<double> ();
   Ptr<OpenGymBoxSpace> space = CreateObject<OpenGymBoxSpace> (low, high, shape, dtype);
-  NS_LOG_UNCOND("MyGetObservationSpace: " << space);
+  NS_LOG_INFO("MyGetObservationSpace: " << space);
   return space;
 }
 
@@ -113,7 +115,7 @@ Ptr<OpenGymSpace> MyGetActionSpace(void)
   };
   std::string dtype = TypeNameGet<uint32_t> ();
   Ptr<OpenGymBoxSpace> space = CreateObject<OpenGymBoxSpace> (low, high, shape, dtype);
-  NS_LOG_UNCOND("MyGetActionSpace: " << space);
+  NS_LOG_INFO("MyGetActionSpace: " << space);
   return space;
 }
 
@@ -123,7 +125,7 @@ Define game over condition
 bool MyGetGameOver(void)
 {
   bool isGameOver = false;
-  NS_LOG_UNCOND("MyGetGameOver: " << isGameOver);
+  BINARY_LOG("LorawanNetworkSimulationOpenAIGym", "MyGetGameOver: {}", isGameOver);
   return isGameOver;
 }
 
@@ -145,7 +147,9 @@ Ptr<OpenGymDataContainer> MyGetObservation(void)
     box->AddValue(distance);
   }
 
-  NS_LOG_UNCOND("MyGetObservation: " << box);
+  // The whole box is only formatted when every level is logged
+  BINARY_LOG("LorawanNetworkSimulationOpenAIGym", "MyGetObservation: {} distances", endDevices.GetN());
+  NS_LOG_LOGIC("MyGetObservation: " << box);
   return box;
 }
 
@@ -153,16 +157,16 @@ std::string MyGetExtraInfo(void)
 {
   std::string myInfo = "linear-wireless-mesh";
   myInfo += "|123";
-  NS_LOG_UNCOND("MyGetExtraInfo: " << myInfo);
+  BINARY_LOG("LorawanNetworkSimulationOpenAIGym", "MyGetExtraInfo: linear-wireless-mesh|123");
   return myInfo;
 }
 
 bool MyExecuteActions(Ptr<OpenGymDataContainer> action)
 {
-  NS_LOG_UNCOND("MyExecuteActions: " << action);
-
   Ptr<OpenGymBoxContainer < uint32_t>> box = DynamicCast<OpenGymBoxContainer < uint32_t>> (action);
   std::vector<uint32_t> actionVector = box->GetData();
+  BINARY_LOG("LorawanNetworkSimulationOpenAIGym", "MyExecuteActions: spreading factor {}", actionVector.at(0));
+  NS_LOG_LOGIC("MyExecuteActions: " << action);
   int i = 0;
   u_int32_t newSpreadingFactor;
   for (NodeContainer::Iterator j = endDevices.Begin(); j != endDevices.End(); ++j)
@@ -204,6 +208,16 @@ bool realisticChannelModel = false;
 // Output control
 bool print = true;
 
+// Stop the simulation once the network has drained after appStopTime
+bool earlyStop = true;
+
+// Text logging of every level of this scenario, slow on long runs
+bool verbose = false;
+
+// Records kept by the binary log, 0 disables it, and the file it is dumped to
+uint32_t binaryLog = 0;
+std::string binaryLogFile = "lorawan-gym-log.txt";
+
 /************************/
 /*Lorawan Tracker */
 /************************/
@@ -282,7 +296,7 @@ void CheckReceptionByAllGWsComplete(std::map< Ptr < Packet
 void TransmissionCallback(Ptr < Packet
   const > packet, uint32_t systemId)
 {
- 	//NS_LOG_DEBUG("Transmitted a packet from device " << systemId);
+  BINARY_LOG("LorawanNetworkSimulationOpenAIGym", "Transmitted a packet from device {}", systemId);
  	// Create a packetStatus
   std::PacketStatus status;
   status.packet = packet;
@@ -297,7 +311,7 @@ void TransmissionCallback(Ptr < Packet
 void PacketReceptionCallback(Ptr < Packet
   const > packet, uint32_t systemId)
 {
- 	//NS_LOG_INFO("A packet was successfully received at gateway " << systemId);
+  BINARY_LOG("LorawanNetworkSimulationOpenAIGym", "A packet was successfully received at gateway {}", systemId);
   std::map< Ptr < Packet
   const >, std::PacketStatus >::iterator it = packetTracker.find(packet);
   (*it).second.outcomes.at(systemId - nDevices) = std::RECEIVED;
@@ -308,18 +322,20 @@ void PacketReceptionCallback(Ptr < Packet
 void InterferenceCallback(Ptr < Packet
   const > packet, uint32_t systemId)
 {
- 	//NS_LOG_INFO("A packet was interferenced at gateway " << systemId);
+  BINARY_LOG("LorawanNetworkSimulationOpenAIGym", "A packet was interferenced at gateway {}", systemId);
 
   std::map< Ptr < Packet
   const >, std::PacketStatus >::iterator it = packetTracker.find(packet);
   it->second.outcomes.at(systemId - nDevices) = std::INTERFERED;
   it->second.outcomeNumber += 1;
+
+  CheckReceptionByAllGWsComplete(it);
 }
 
 void NoMoreReceiversCallback(Ptr < Packet
   const > packet, uint32_t systemId)
 {
- 	// NS_LOG_INFO ("A packet was lost because there were no more receivers at gateway " << systemId);
+  BINARY_LOG("LorawanNetworkSimulationOpenAIGym", "A packet was lost because there were no more receivers at gateway {}", systemId);
 
   std::map< Ptr < Packet
   const >, std::PacketStatus >::iterator it = packetTracker.find(packet);
@@ -332,7 +348,7 @@ void NoMoreReceiversCallback(Ptr < Packet
 void UnderSensitivityCallback(Ptr < Packet
   const > packet, uint32_t systemId)
 {
- 	// NS_LOG_INFO ("A packet arrived at the gateway under sensitivity at gateway " << systemId);
+  BINARY_LOG("LorawanNetworkSimulationOpenAIGym", "A packet arrived at the gateway under sensitivity at gateway {}", systemId);
 
   std::map< Ptr < Packet
   const >, std::PacketStatus >::iterator it = packetTracker.find(packet);
@@ -342,6 +358,11 @@ void UnderSensitivityCallback(Ptr < Packet
   CheckReceptionByAllGWsComplete(it);
 }
 
+bool PacketsPending(void)
+{
+  return !packetTracker.empty();
+}
+
 //
 // Experiment Class
 //
@@ -621,9 +642,31 @@ void Experiment::Run(Ptr<RandomVariableStream> trafficDistribution)
  	// Flow monitor
   Simulator::Stop(appStopTime + Seconds(180));
 
+  // Stop as soon as the network has drained, the fixed stop is only a bound
+  Ptr<DrainDetector> drainDetector;
+  if (earlyStop)
+  {
+    drainDetector = CreateObject<DrainDetector> ();
+    drainDetector->SetEndDevices(endDevices);
+    drainDetector->SetGateways(gateways);
+    drainDetector->SetPendingPacketsCallback(MakeCallback(&PacketsPending));
+    drainDetector->Start(appStopTime);
+  }
+
   NS_LOG_INFO("Running simulation...");
   Simulator::Run();
 
+  if (BinaryLog::Enabled())
+  {
+    BinaryLog::Get().DumpToFile(binaryLogFile, true);
+    BinaryLog::Get().Clear();
+  }
+
+  if (drainDetector)
+  {
+    NS_LOG_INFO("Simulation ended at " << Simulator::Now().GetSeconds() << " s, " << drainDetector->GetReason());
+  }
+
   openGymInterface->NotifySimulationEnd();
 
   Simulator::Destroy();
@@ -674,11 +717,22 @@ int main(int argc, char *argv[])
   cmd.AddValue("simulationTime", "The time for which to simulate", simulationTime);
   cmd.AddValue("packetSize", "Packet size (bytes)", packetSize);
   cmd.AddValue("print", "Whether or not to print various informations", print);
+  cmd.AddValue("earlyStop", "Whether to stop as soon as the network drains after the senders stop", earlyStop);
+  cmd.AddValue("verbose", "Whether to log every level of the scenario as text", verbose);
+  cmd.AddValue("binaryLog", "Records kept by the binary log, 0 disables it", binaryLog);
+  cmd.AddValue("binaryLogFile", "File the binary log is written to after each run", binaryLogFile);
 
   cmd.Parse(argc, argv);
 
  	// Set up logging
-  LogComponentEnable("LorawanNetworkSimulationOpenAIGym", LOG_LEVEL_ALL);
+  LogComponentEnable("LorawanNetworkSimulationOpenAIGym", verbose ? LOG_LEVEL_ALL : LOG_LEVEL_INFO);
+  if (binaryLog > 0)
+  {
+    // Every run appends its records, a crash leaves the raw buffer next to them
+    std::ofstream(binaryLogFile.c_str(), std::ios::trunc);
+    BinaryLog::Get().Enable(binaryLog);
+    BinaryLog::Get().InstallCrashHandler(binaryLogFile + ".crash");
+  }
 
   Experiment experiment;
   NS_LOG_INFO("\nDistribución Uniforme");
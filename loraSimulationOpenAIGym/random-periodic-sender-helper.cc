@@ -7,6 +7,7 @@
 #include "random-periodic-sender.h"
 #include "ns3/random-variable-stream.h"
 #include "ns3/double.h"
+#include "ns3/integer.h"
 #include "ns3/string.h"
 #include "ns3/trace-source-accessor.h"
 #include "ns3/simulator.h"
@@ -29,6 +30,7 @@ namespace ns3
       m_pktSize = 10;
       m_pktSizeRV = 0;
       m_pktPeriodRV = 0;
+      m_streamBase = -1;
     }
 
     RandomPeriodicSenderHelper::~RandomPeriodicSenderHelper() {}
@@ -63,10 +65,27 @@ namespace ns3
 
         Ptr<RandomPeriodicSender> app = m_factory.Create<RandomPeriodicSender> ();
 
+        // Either share the helper's random variables or draw from streams that
+        // only belong to this device
+        Ptr<RandomVariableStream> periodRV = m_pktPeriodRV;
+        Ptr<RandomVariableStream> pktSizeRV = m_pktSizeRV;
+        Ptr<UniformRandomVariable> initialDelay = m_initialDelay;
+        if (m_streamBase >= 0) {
+          int64_t stream = m_streamBase + STREAMS_PER_DEVICE * node->GetId();
+          if (m_pktPeriodRV) {
+            periodRV = CopyRandomVariable(m_pktPeriodRV, stream);
+          }
+          if (m_pktSizeRV) {
+            pktSizeRV = CopyRandomVariable(m_pktSizeRV, stream + 1);
+          }
+          initialDelay = DynamicCast<UniformRandomVariable> (CopyRandomVariable(m_initialDelay, stream + 2));
+          NS_LOG_DEBUG("Node " << node->GetId() << " uses streams starting at " << stream);
+        }
+
         Time interval;
-        if (m_pktPeriodRV) {
-          app->SetIntervalRandomVariable(m_pktPeriodRV);
-          double intervalRand = m_pktPeriodRV->GetValue();
+        if (periodRV) {
+          app->SetIntervalRandomVariable(periodRV);
+          double intervalRand = periodRV->GetValue();
           interval = Seconds(intervalRand);
         } else {
           interval = m_period;
@@ -76,10 +95,10 @@ namespace ns3
         NS_LOG_DEBUG("Created an application with interval = " <<
           interval.GetHours() << " hours");
 
-        app->SetInitialDelay(Seconds(m_initialDelay->GetValue(0, interval.GetSeconds())));
+        app->SetInitialDelay(Seconds(initialDelay->GetValue(0, interval.GetSeconds())));
         app->SetPacketSize(m_pktSize);
-        if (m_pktSizeRV) {
-          app->SetPacketSizeRandomVariable(m_pktSizeRV);
+        if (pktSizeRV) {
+          app->SetPacketSizeRandomVariable(pktSizeRV);
         }
 
         app->SetNode(node);
@@ -88,6 +107,30 @@ namespace ns3
         return app;
       }
 
+    Ptr<RandomVariableStream>
+    RandomPeriodicSenderHelper::CopyRandomVariable(Ptr<RandomVariableStream> rv, int64_t stream) const
+    {
+      // Rebuild the same distribution from its attributes, only the stream changes
+      ObjectFactory factory;
+      factory.SetTypeId(rv->GetInstanceTypeId());
+      for (TypeId tid = rv->GetInstanceTypeId(); tid != Object::GetTypeId(); tid = tid.GetParent())
+      {
+        for (uint32_t i = 0; i < tid.GetAttributeN(); i++)
+        {
+          struct TypeId::AttributeInformation info = tid.GetAttribute(i);
+          if (info.name == "Stream" || !(info.flags & TypeId::ATTR_GET) || !(info.flags & TypeId::ATTR_CONSTRUCT))
+          {
+            continue;
+          }
+          Ptr<AttributeValue> value = info.checker->Create();
+          rv->GetAttribute(info.name, *value);
+          factory.Set(info.name, *value);
+        }
+      }
+      factory.Set("Stream", IntegerValue(stream));
+      return factory.Create<RandomVariableStream> ();
+    }
+
     void
     RandomPeriodicSenderHelper::SetPeriod(Time period)
     {
@@ -111,5 +154,12 @@ namespace ns3
     {
       m_pktSize = size;
     }
+
+    void
+    RandomPeriodicSenderHelper::SetPerDeviceStreams(int64_t streamBase)
+    {
+      NS_ASSERT(streamBase >= 0);
+      m_streamBase = streamBase;
+    }
   }
 }	// namespace ns3
\ No newline at end of file
@@ -54,9 +54,30 @@ namespace ns3
 
       void SetPacketSize(uint8_t size);
 
+      /**
+       *Give every application its own random streams instead of sharing the
+       *helper's random variables.
+       *
+       *Each device gets private copies of the period, initial delay and packet
+       *size random variables, with stream indices derived from streamBase and
+       *the node id. The run number comes from the global RngRun, so the traffic
+       *of a device only depends on (run, device id) and not on the installation
+       *order or on how the devices are split across processes.
+       *
+       *\param streamBase The first stream index reserved for the applications
+       */
+      void SetPerDeviceStreams(int64_t streamBase);
+
+      /**
+       *Number of streams that SetPerDeviceStreams reserves for each device.
+       */
+      static const int64_t STREAMS_PER_DEVICE = 3;
+
       private:
         Ptr<Application> InstallPriv(Ptr<Node> node) const;
 
+      Ptr<RandomVariableStream> CopyRandomVariable(Ptr<RandomVariableStream> rv, int64_t stream) const;
+
       ObjectFactory m_factory;
 
       Ptr<UniformRandomVariable> m_initialDelay;
@@ -72,6 +93,8 @@ namespace ns3
 
       uint8_t m_pktSize;	// the packet size.
 
+      int64_t m_streamBase;	// first per-device stream, or -1 to share the helper's streams
+
     };
   }	// namespace ns3
 }
@@ -0,0 +1,364 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+  Error rate model for the Wi-Fi scenario that reads the chunk success rates
+  from a table computed once and memory-mapped by the later runs.
+ */
+
+#ifndef PER_TABLE_ERROR_MODEL_H
+#define PER_TABLE_ERROR_MODEL_H
+
+#include "ns3/error-rate-model.h"
+#include "ns3/wifi-mode.h"
+#include "ns3/wifi-tx-vector.h"
+#include "ns3/string.h"
+#include "ns3/pointer.h"
+#include "ns3/yans-error-rate-model.h"
+#include "ns3/fatal-error.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * Chunk success rates looked up in a precomputed table.
+ *
+ * The table file starts with a PerTableHeader, followed by the chunk sizes
+ * (uint32_t bits, increasing), then for every mode its name in 32 bytes,
+ * NUL padded, and its natural log success rates as floats, SINR-major:
+ * value[snr * nSizes + size]. The SINR bins are in dB, from snrMinDb in
+ * steps of snrStepDb. Lookups interpolate linearly in SINR (dB) and chunk
+ * size, in the log domain, which is exact in the size for the models where
+ * errors are independent per bit or symbol. Larger chunks than the last
+ * size are scaled from it; SINRs outside the table are clamped to it.
+ *
+ * Modes that are not in the table are handed to the Fallback model, which
+ * is also the model the table is generated from; an instance without one
+ * creates its own YansErrorRateModel. The generator measures the largest
+ * absolute error of the success rate at the midpoints between bins and
+ * stores it in the header as maxError: that is the documented tolerance of
+ * a table against its analytic model.
+ *
+ * The file is mapped once per process and shared by all the instances. A
+ * mapping is found again by the name, modification time and header of the
+ * file, so a table regenerated in the process is mapped anew.
+ */
+class PerTableErrorModel : public ErrorRateModel
+{
+public:
+  struct PerTableHeader
+  {
+    char magic[8];       //!< "NS3PER01"
+    uint32_t nModes;
+    uint32_t nSnr;
+    uint32_t nSizes;
+    uint32_t reserved;
+    double snrMinDb;
+    double snrStepDb;
+    double maxError;     //!< Largest absolute error of the success rate found when generating
+  };
+
+  static const uint32_t MODE_NAME_LENGTH = 32;
+
+  static TypeId GetTypeId (void)
+  {
+    static TypeId tid = TypeId ("ns3::PerTableErrorModel")
+      .SetParent<ErrorRateModel> ()
+      .AddConstructor<PerTableErrorModel> ()
+      .AddAttribute ("TableFile", "The table to map",
+                     StringValue ("wifi-per-table.bin"),
+                     MakeStringAccessor (&PerTableErrorModel::m_filename),
+                     MakeStringChecker ())
+      .AddAttribute ("Fallback", "The model used for the modes the table doesn't hold, "
+                     "a YansErrorRateModel of the instance if unset",
+                     PointerValue (),
+                     MakePointerAccessor (&PerTableErrorModel::m_fallback),
+                     MakePointerChecker<ErrorRateModel> ());
+    return tid;
+  }
+
+  PerTableErrorModel ()
+    : m_table (0)
+  {
+  }
+
+  /**
+   * Generate the table of the given modes from an analytic model, unless
+   * the file already holds a table of the same modes, SINR bins and sizes
+   *
+   * \returns the largest absolute error of the table
+   */
+  static double EnsureTable (std::string filename, Ptr<ErrorRateModel> analytic, std::vector<std::string> modes,
+                             double snrMinDb = -10, double snrMaxDb = 40, double snrStepDb = 0.25)
+  {
+    std::vector<uint32_t> sizes;
+    for (uint32_t bits = 8; bits <= 65536; bits *= 2)
+      {
+        sizes.push_back (bits);
+      }
+    PerTableHeader header;
+    std::memset (&header, 0, sizeof (header));
+    std::memcpy (header.magic, "NS3PER01", 8);
+    header.nModes = modes.size ();
+    header.nSnr = std::floor ((snrMaxDb - snrMinDb) / snrStepDb) + 1;
+    header.nSizes = sizes.size ();
+    header.snrMinDb = snrMinDb;
+    header.snrStepDb = snrStepDb;
+
+    if (Matches (filename, header, sizes, modes))
+      {
+        return Map (filename).header->maxError;
+      }
+
+    std::vector<std::vector<float> > values (modes.size ());
+    for (uint32_t m = 0; m < modes.size (); m++)
+      {
+        WifiMode mode (modes[m]);
+        WifiTxVector txVector;
+        txVector.SetMode (mode);
+        for (uint32_t s = 0; s < header.nSnr; s++)
+          {
+            double snr = std::pow (10, (snrMinDb + s * snrStepDb) / 10);
+            for (uint32_t k = 0; k < sizes.size (); k++)
+              {
+                values[m].push_back (LogRate (analytic->GetChunkSuccessRate (mode, txVector, snr, sizes[k])));
+              }
+          }
+        // Compare the interpolation with the model halfway between the bins
+        for (uint32_t s = 0; s + 1 < header.nSnr; s++)
+          {
+            double snrDb = snrMinDb + (s + 0.5) * snrStepDb;
+            for (uint32_t k = 0; k + 1 < sizes.size (); k++)
+              {
+                uint32_t bits = (sizes[k] + sizes[k + 1]) / 2;
+                double exact = analytic->GetChunkSuccessRate (mode, txVector, std::pow (10, snrDb / 10), bits);
+                double table = Interpolate (header, &sizes[0], &values[m][0], snrDb, bits);
+                header.maxError = std::max (header.maxError, std::abs (exact - table));
+              }
+          }
+      }
+
+    // Written aside and renamed, so a table mapped already stays valid
+    std::string temporary = filename + ".tmp";
+    std::ofstream out (temporary.c_str (), std::ios::binary | std::ios::trunc);
+    if (!out)
+      {
+        NS_FATAL_ERROR ("Can't write the PER table " << filename);
+      }
+    out.write (reinterpret_cast<const char *> (&header), sizeof (header));
+    out.write (reinterpret_cast<const char *> (&sizes[0]), sizes.size () * sizeof (uint32_t));
+    for (uint32_t m = 0; m < modes.size (); m++)
+      {
+        out.write (ModeName (modes[m]).c_str (), MODE_NAME_LENGTH);
+        out.write (reinterpret_cast<const char *> (&values[m][0]), values[m].size () * sizeof (float));
+      }
+    out.close ();
+    if (!out || std::rename (temporary.c_str (), filename.c_str ()) != 0)
+      {
+        NS_FATAL_ERROR ("Can't write the PER table " << filename);
+      }
+    return header.maxError;
+  }
+
+private:
+  /**
+   * A mapped table file
+   */
+  struct Table
+  {
+    const PerTableHeader *header;
+    const uint32_t *sizes;
+    std::map<std::string, const float *> modes;
+  };
+
+  /**
+   * The name of a mode as stored in the file, NUL padded
+   */
+  static std::string ModeName (std::string mode)
+  {
+    mode.resize (MODE_NAME_LENGTH - 1);
+    mode.resize (MODE_NAME_LENGTH, '\0');
+    return mode;
+  }
+
+  /**
+   * Whether the file holds a table of exactly these modes, SINR bins and
+   * chunk sizes; a table generated with other settings is regenerated
+   * rather than reused
+   */
+  static bool Matches (std::string filename, const PerTableHeader &expected, const std::vector<uint32_t> &sizes,
+                       const std::vector<std::string> &modes)
+  {
+    std::ifstream in (filename.c_str (), std::ios::binary);
+    PerTableHeader header;
+    if (!in.read (reinterpret_cast<char *> (&header), sizeof (header))
+        || std::memcmp (header.magic, expected.magic, 8) != 0
+        || header.nModes != expected.nModes || header.nSnr != expected.nSnr || header.nSizes != expected.nSizes
+        || header.snrMinDb != expected.snrMinDb || header.snrStepDb != expected.snrStepDb)
+      {
+        return false;
+      }
+    std::vector<uint32_t> stored (header.nSizes);
+    if (!in.read (reinterpret_cast<char *> (&stored[0]), stored.size () * sizeof (uint32_t)) || stored != sizes)
+      {
+        return false;
+      }
+    uint64_t valueBytes = uint64_t (header.nSnr) * header.nSizes * sizeof (float);
+    for (uint32_t m = 0; m < modes.size (); m++)
+      {
+        char name[MODE_NAME_LENGTH];
+        if (!in.read (name, sizeof (name)) || std::string (name, sizeof (name)) != ModeName (modes[m]))
+          {
+            return false;
+          }
+        in.seekg (valueBytes, std::ios::cur);
+      }
+    uint64_t length = sizeof (PerTableHeader) + header.nSizes * sizeof (uint32_t)
+      + header.nModes * (MODE_NAME_LENGTH + valueBytes);
+    in.seekg (0, std::ios::end);
+    return in && uint64_t (in.tellg ()) == length;
+  }
+
+  static float LogRate (double rate)
+  {
+    return rate > 0 ? std::max (std::log (rate), -700.0) : -700;
+  }
+
+  static const Table &Map (std::string filename)
+  {
+    int fd = open (filename.c_str (), O_RDONLY);
+    struct stat info;
+    PerTableHeader header;
+    if (fd < 0 || fstat (fd, &info) != 0 || uint64_t (info.st_size) < sizeof (PerTableHeader)
+        || pread (fd, &header, sizeof (header), 0) != ssize_t (sizeof (header)))
+      {
+        NS_FATAL_ERROR ("Can't read the PER table " << filename);
+      }
+
+    // A regenerated table is a new file: the older mappings stay valid for
+    // the instances that use them
+    std::ostringstream key;
+    key << filename << '\0' << info.st_ino << " " << info.st_size << " "
+        << info.st_mtim.tv_sec << "." << info.st_mtim.tv_nsec << '\0';
+    key.write (reinterpret_cast<const char *> (&header), sizeof (header));
+    static std::map<std::string, Table> tables;
+    std::map<std::string, Table>::iterator found = tables.find (key.str ());
+    if (found != tables.end ())
+      {
+        close (fd);
+        return found->second;
+      }
+
+    void *data = mmap (0, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close (fd);
+    if (data == MAP_FAILED)
+      {
+        NS_FATAL_ERROR ("Can't map the PER table " << filename);
+      }
+
+    Table &table = tables[key.str ()];
+    const char *p = static_cast<const char *> (data);
+    table.header = reinterpret_cast<const PerTableHeader *> (p);
+    if (std::memcmp (table.header->magic, "NS3PER01", 8) != 0)
+      {
+        NS_FATAL_ERROR (filename << " is not a PER table");
+      }
+    uint64_t modeBytes = MODE_NAME_LENGTH + uint64_t (table.header->nSnr) * table.header->nSizes * sizeof (float);
+    uint64_t expected = sizeof (PerTableHeader) + table.header->nSizes * sizeof (uint32_t)
+      + table.header->nModes * modeBytes;
+    if (uint64_t (info.st_size) != expected)
+      {
+        NS_FATAL_ERROR ("The PER table " << filename << " is truncated");
+      }
+    p += sizeof (PerTableHeader);
+    table.sizes = reinterpret_cast<const uint32_t *> (p);
+    p += table.header->nSizes * sizeof (uint32_t);
+    for (uint32_t m = 0; m < table.header->nModes; m++)
+      {
+        table.modes[std::string (p)] = reinterpret_cast<const float *> (p + MODE_NAME_LENGTH);
+        p += modeBytes;
+      }
+    return table;
+  }
+
+  static double Interpolate (const PerTableHeader &header, const uint32_t *sizes, const float *values,
+                             double snrDb, uint64_t nbits)
+  {
+    double position = (snrDb - header.snrMinDb) / header.snrStepDb;
+    position = std::min (std::max (position, 0.0), header.nSnr - 1.0);
+    uint32_t s = std::min<uint32_t> (position, header.nSnr - 2);
+    double ws = position - s;
+
+    uint32_t n = header.nSizes;
+    uint32_t k = std::upper_bound (sizes, sizes + n, uint32_t (std::min<uint64_t> (nbits, 0xffffffff))) - sizes;
+    double logRate;
+    const float *low = values + uint64_t (s) * n;
+    const float *high = low + n;
+    if (k == 0 || k == n)
+      {
+        // Below the first or above the last size: scale the nearest one
+        uint32_t nearest = k == 0 ? 0 : n - 1;
+        double atSize = (1 - ws) * low[nearest] + ws * high[nearest];
+        logRate = atSize * nbits / sizes[nearest];
+      }
+    else
+      {
+        double wk = double (nbits - sizes[k - 1]) / (sizes[k] - sizes[k - 1]);
+        double atLow = (1 - wk) * low[k - 1] + wk * low[k];
+        double atHigh = (1 - wk) * high[k - 1] + wk * high[k];
+        logRate = (1 - ws) * atLow + ws * atHigh;
+      }
+    return std::exp (logRate);
+  }
+
+  virtual double DoGetChunkSuccessRate (WifiMode mode, WifiTxVector txVector, double snr, uint64_t nbits) const override
+  {
+    if (m_table == 0)
+      {
+        m_table = &Map (m_filename);
+      }
+    if (mode.GetUid () >= m_modes.size ())
+      {
+        m_modes.resize (mode.GetUid () + 1, 0);
+        m_known.resize (mode.GetUid () + 1, false);
+      }
+    if (!m_known[mode.GetUid ()])
+      {
+        std::map<std::string, const float *>::const_iterator found = m_table->modes.find (mode.GetUniqueName ());
+        m_modes[mode.GetUid ()] = found == m_table->modes.end () ? 0 : found->second;
+        m_known[mode.GetUid ()] = true;
+      }
+    const float *values = m_modes[mode.GetUid ()];
+    if (values == 0 || snr <= 0)
+      {
+        if (m_fallback == 0)
+          {
+            m_fallback = CreateObject<YansErrorRateModel> ();
+          }
+        return m_fallback->GetChunkSuccessRate (mode, txVector, snr, nbits);
+      }
+    return Interpolate (*m_table->header, m_table->sizes, values, 10 * std::log10 (snr), nbits);
+  }
+
+  std::string m_filename;
+  mutable Ptr<ErrorRateModel> m_fallback;
+  mutable const Table *m_table;
+  mutable std::vector<const float *> m_modes;  //!< Values of each mode, by uid
+  mutable std::vector<bool> m_known;           //!< Whether the mode of each uid was looked up
+};
+
+NS_OBJECT_ENSURE_REGISTERED (PerTableErrorModel);
+
+} // namespace ns3
+
+#endif /* PER_TABLE_ERROR_MODEL_H */
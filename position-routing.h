@@ -0,0 +1,430 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+  Static routes for the Wi-Fi scenario computed from the node positions, used
+  instead of OLSR in the large runs.
+ */
+
+#ifndef POSITION_ROUTING_H
+#define POSITION_ROUTING_H
+
+#include "ns3/simulator.h"
+#include "ns3/node-container.h"
+#include "ns3/mobility-model.h"
+#include "ns3/ipv4.h"
+#include "ns3/ipv4-static-routing.h"
+#include "ns3/ipv4-static-routing-helper.h"
+#include "ns3/fatal-error.h"
+#include "ns3/simple-ref-count.h"
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <utility>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * Shortest-path (hop count) routes between the nodes of an ad-hoc network,
+ * where two nodes are linked when they are within range of each other.
+ *
+ * Every node gets a host route to every reachable node through interface
+ * 1, installed in its Ipv4StaticRouting, which must be part of the routing
+ * protocol of the node. The positions are checked periodically; a node
+ * that moved more than the hysteresis since its links were last evaluated
+ * gets its links evaluated again, against its current neighbours and the
+ * nodes of the grid cells, one range wide, around it. A breadth-first tree
+ * toward a destination is only computed again when a new link joins two
+ * nodes more than one hop apart from it, or a link of the tree disappeared
+ * and the node below it has no other neighbour one hop nearer; otherwise
+ * the tree is repaired in place or left as it is. Only the tables of the
+ * nodes whose next hops changed are rewritten.
+ */
+class PositionRouting : public SimpleRefCount<PositionRouting>
+{
+public:
+  static constexpr uint32_t NO_ROUTE = 0xffffffff;
+
+  PositionRouting (NodeContainer nodes, double range)
+    : m_nodes (nodes),
+      m_range (range),
+      m_hysteresis (range / 20),
+      m_recomputations (0),
+      m_recomputedTrees (0),
+      m_rewrittenTables (0)
+  {
+    if (range <= 0)
+      {
+        NS_FATAL_ERROR ("The link range must be positive");
+      }
+  }
+
+  /**
+   * \returns the distance at which the power received under a
+   * LogDistancePropagationLossModel falls to the threshold
+   */
+  static double LogDistanceRange (double txPowerDbm, double thresholdDbm, double exponent,
+                                  double referenceLossDb, double referenceDistance = 1)
+  {
+    return referenceDistance * std::pow (10, (txPowerDbm - thresholdDbm - referenceLossDb) / (10 * exponent));
+  }
+
+  /**
+   * Compute the routes from the current positions, install them and check
+   * the positions every interval from then on
+   */
+  void Install (Time checkInterval)
+  {
+    uint32_t n = m_nodes.GetN ();
+    m_positions.resize (n);
+    m_cells.resize (n);
+    m_neighbours.assign (n, std::vector<uint32_t> ());
+    m_nextHop.assign (n, std::vector<uint32_t> (n, NO_ROUTE));
+    m_hops.assign (n, std::vector<uint32_t> (n, NO_ROUTE));
+    for (uint32_t i = 0; i < n; i++)
+      {
+        Ptr<Ipv4> ipv4 = m_nodes.Get (i)->GetObject<Ipv4> ();
+        m_addresses.push_back (ipv4->GetAddress (1, 0).GetLocal ());
+        m_routing.push_back (Ipv4StaticRoutingHelper ().GetStaticRouting (ipv4));
+        if (m_routing.back () == 0)
+          {
+            NS_FATAL_ERROR ("Node " << i << " has no static routing");
+          }
+        m_positions[i] = m_nodes.Get (i)->GetObject<MobilityModel> ()->GetPosition ();
+        m_cells[i] = GetCell (m_positions[i]);
+        m_grid[m_cells[i]].push_back (i);
+      }
+    for (uint32_t i = 0; i < n; i++)
+      {
+        std::vector<uint32_t> candidates = GetNearby (i);
+        for (uint32_t k = 0; k < candidates.size (); k++)
+          {
+            if (candidates[k] > i && InRange (i, candidates[k]))
+              {
+                m_neighbours[i].push_back (candidates[k]);
+                m_neighbours[candidates[k]].push_back (i);
+              }
+          }
+      }
+    m_recomputations++;
+    std::vector<bool> dirty (n, false);
+    for (uint32_t destination = 0; destination < n; destination++)
+      {
+        ComputeTree (destination, dirty);
+      }
+    WriteTables (dirty);
+    if (!checkInterval.IsZero ())
+      {
+        m_interval = checkInterval;
+        Simulator::Schedule (checkInterval, &PositionRouting::CheckPositions, this);
+      }
+  }
+
+  /**
+   * Set how far a node has to move before its links are evaluated again
+   */
+  void SetHysteresis (double distance)
+  {
+    m_hysteresis = distance;
+  }
+
+  /**
+   * \returns the number of times the routes were updated, including the
+   * first time
+   */
+  uint32_t GetRecomputations (void) const
+  {
+    return m_recomputations;
+  }
+
+  /**
+   * \returns the number of trees computed, one per destination the first
+   * time and one per affected destination afterwards
+   */
+  uint64_t GetRecomputedTrees (void) const
+  {
+    return m_recomputedTrees;
+  }
+
+  /**
+   * \returns the number of routing tables written, including the first ones
+   */
+  uint64_t GetRewrittenTables (void) const
+  {
+    return m_rewrittenTables;
+  }
+
+private:
+  typedef std::pair<int64_t, int64_t> Cell;
+
+  struct LinkChange
+  {
+    uint32_t a;
+    uint32_t b;
+    bool up;
+  };
+
+  bool InRange (uint32_t i, uint32_t j) const
+  {
+    return CalculateDistance (m_positions[i], m_positions[j]) <= m_range;
+  }
+
+  Cell GetCell (const Vector &position) const
+  {
+    return Cell (int64_t (std::floor (position.x / m_range)), int64_t (std::floor (position.y / m_range)));
+  }
+
+  /**
+   * \returns the other nodes of the cells around the one of a node, which
+   * hold every node within range of it
+   */
+  std::vector<uint32_t> GetNearby (uint32_t node) const
+  {
+    std::vector<uint32_t> nearby;
+    for (int64_t dx = -1; dx <= 1; dx++)
+      {
+        for (int64_t dy = -1; dy <= 1; dy++)
+          {
+            std::map<Cell, std::vector<uint32_t> >::const_iterator cell =
+              m_grid.find (Cell (m_cells[node].first + dx, m_cells[node].second + dy));
+            if (cell == m_grid.end ())
+              {
+                continue;
+              }
+            for (uint32_t k = 0; k < cell->second.size (); k++)
+              {
+                if (cell->second[k] != node)
+                  {
+                    nearby.push_back (cell->second[k]);
+                  }
+              }
+          }
+      }
+    return nearby;
+  }
+
+  bool IsLinked (uint32_t i, uint32_t j) const
+  {
+    return std::find (m_neighbours[i].begin (), m_neighbours[i].end (), j) != m_neighbours[i].end ();
+  }
+
+  static void Erase (std::vector<uint32_t> &nodes, uint32_t node)
+  {
+    std::vector<uint32_t>::iterator it = std::find (nodes.begin (), nodes.end (), node);
+    *it = nodes.back ();
+    nodes.pop_back ();
+  }
+
+  void CheckPositions (void)
+  {
+    std::vector<LinkChange> changes;
+    for (uint32_t i = 0; i < m_nodes.GetN (); i++)
+      {
+        Vector position = m_nodes.Get (i)->GetObject<MobilityModel> ()->GetPosition ();
+        if (CalculateDistance (position, m_positions[i]) <= m_hysteresis)
+          {
+            continue;
+          }
+        m_positions[i] = position;
+        Cell cell = GetCell (position);
+        if (cell != m_cells[i])
+          {
+            Erase (m_grid[m_cells[i]], i);
+            m_cells[i] = cell;
+            m_grid[cell].push_back (i);
+          }
+
+        // The current neighbours may be out of range now, the new ones are
+        // in the cells around
+        std::vector<uint32_t> candidates = GetNearby (i);
+        candidates.insert (candidates.end (), m_neighbours[i].begin (), m_neighbours[i].end ());
+        for (uint32_t k = 0; k < candidates.size (); k++)
+          {
+            uint32_t j = candidates[k];
+            bool linked = IsLinked (i, j);
+            if (linked == InRange (i, j))
+              {
+                continue;
+              }
+            if (linked)
+              {
+                Erase (m_neighbours[i], j);
+                Erase (m_neighbours[j], i);
+              }
+            else
+              {
+                m_neighbours[i].push_back (j);
+                m_neighbours[j].push_back (i);
+              }
+            LinkChange change = { i, j, !linked };
+            changes.push_back (change);
+          }
+      }
+    if (!changes.empty ())
+      {
+        UpdateRoutes (changes);
+      }
+    Simulator::Schedule (m_interval, &PositionRouting::CheckPositions, this);
+  }
+
+  /**
+   * Repair or compute again the trees the link changes affect, then rewrite
+   * the tables whose next hops changed
+   */
+  void UpdateRoutes (const std::vector<LinkChange> &changes)
+  {
+    m_recomputations++;
+    uint32_t n = m_nodes.GetN ();
+    std::vector<bool> dirty (n, false);
+    std::vector<uint32_t> orphans;
+    for (uint32_t destination = 0; destination < n; destination++)
+      {
+        const std::vector<uint32_t> &hops = m_hops[destination];
+        bool recompute = false;
+        orphans.clear ();
+        for (uint32_t c = 0; c < changes.size () && !recompute; c++)
+          {
+            uint32_t a = changes[c].a;
+            uint32_t b = changes[c].b;
+            if (changes[c].up)
+              {
+                // A link between nodes at the same or consecutive hop counts
+                // shortens no path
+                recompute = hops[a] != hops[b] && (std::max (hops[a], hops[b]) == NO_ROUTE
+                                                   || std::max (hops[a], hops[b]) - std::min (hops[a], hops[b]) > 1);
+              }
+            else if (m_nextHop[a][destination] == b)
+              {
+                orphans.push_back (a);
+              }
+            else if (m_nextHop[b][destination] == a)
+              {
+                orphans.push_back (b);
+              }
+          }
+        // A node that lost its next hop keeps its hop count if another
+        // neighbour is one hop nearer; when they all do, no hop count changes
+        for (uint32_t o = 0; o < orphans.size () && !recompute; o++)
+          {
+            uint32_t node = orphans[o];
+            uint32_t hop = NO_ROUTE;
+            for (uint32_t k = 0; k < m_neighbours[node].size () && hop == NO_ROUTE; k++)
+              {
+                if (hops[m_neighbours[node][k]] + 1 == hops[node])
+                  {
+                    hop = m_neighbours[node][k];
+                  }
+              }
+            if (hop == NO_ROUTE)
+              {
+                recompute = true;
+              }
+            else
+              {
+                m_nextHop[node][destination] = hop;
+                dirty[node] = true;
+              }
+          }
+        if (recompute)
+          {
+            ComputeTree (destination, dirty);
+          }
+      }
+    WriteTables (dirty);
+  }
+
+  /**
+   * Breadth-first search from a destination, marking the sources whose next
+   * hop to it changed
+   */
+  void ComputeTree (uint32_t destination, std::vector<bool> &dirty)
+  {
+    m_recomputedTrees++;
+    uint32_t n = m_nodes.GetN ();
+    std::vector<uint32_t> parent (n, NO_ROUTE);
+    std::vector<uint32_t> &hops = m_hops[destination];
+    hops.assign (n, NO_ROUTE);
+    parent[destination] = destination;
+    hops[destination] = 0;
+    std::vector<uint32_t> queue;
+    queue.reserve (n);
+    queue.push_back (destination);
+    for (uint32_t head = 0; head < queue.size (); head++)
+      {
+        uint32_t node = queue[head];
+        for (uint32_t k = 0; k < m_neighbours[node].size (); k++)
+          {
+            uint32_t next = m_neighbours[node][k];
+            if (parent[next] == NO_ROUTE)
+              {
+                parent[next] = node;
+                hops[next] = hops[node] + 1;
+                queue.push_back (next);
+              }
+          }
+      }
+    for (uint32_t source = 0; source < n; source++)
+      {
+        uint32_t hop = source == destination ? NO_ROUTE : parent[source];
+        if (m_nextHop[source][destination] != hop)
+          {
+            m_nextHop[source][destination] = hop;
+            dirty[source] = true;
+          }
+      }
+  }
+
+  void WriteTables (const std::vector<bool> &dirty)
+  {
+    for (uint32_t i = 0; i < dirty.size (); i++)
+      {
+        if (dirty[i])
+          {
+            WriteTable (i);
+          }
+      }
+  }
+
+  /**
+   * Replace the host routes of a node, keeping its network routes
+   */
+  void WriteTable (uint32_t node)
+  {
+    m_rewrittenTables++;
+    Ptr<Ipv4StaticRouting> routing = m_routing[node];
+    for (uint32_t r = routing->GetNRoutes (); r > 0; r--)
+      {
+        if (routing->GetRoute (r - 1).IsHost ())
+          {
+            routing->RemoveRoute (r - 1);
+          }
+      }
+    for (uint32_t destination = 0; destination < m_nodes.GetN (); destination++)
+      {
+        uint32_t hop = m_nextHop[node][destination];
+        if (hop != NO_ROUTE)
+          {
+            routing->AddHostRouteTo (m_addresses[destination], m_addresses[hop], 1);
+          }
+      }
+  }
+
+  NodeContainer m_nodes;
+  double m_range;
+  double m_hysteresis;
+  Time m_interval;
+  std::vector<Ipv4Address> m_addresses;
+  std::vector<Ptr<Ipv4StaticRouting> > m_routing;
+  std::vector<Vector> m_positions;               //!< Positions the links were evaluated at
+  std::vector<Cell> m_cells;                     //!< Grid cell of each evaluated position
+  std::map<Cell, std::vector<uint32_t> > m_grid; //!< Nodes of each grid cell
+  std::vector<std::vector<uint32_t> > m_neighbours;
+  std::vector<std::vector<uint32_t> > m_nextHop; //!< Next hop of each source to each destination
+  std::vector<std::vector<uint32_t> > m_hops;    //!< Hop count of each node, by destination tree
+  uint32_t m_recomputations;
+  uint64_t m_recomputedTrees;
+  uint64_t m_rewrittenTables;
+};
+
+} // namespace ns3
+
+#endif /* POSITION_ROUTING_H */
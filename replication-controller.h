@@ -0,0 +1,293 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+  Sequential stopping rule: replications of a configuration are added until
+  the confidence interval of the target metric is narrow enough.
+ */
+
+#ifndef REPLICATION_CONTROLLER_H
+#define REPLICATION_CONTROLLER_H
+
+#include "ns3/fatal-error.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * Online mean and variance of the replications of a metric, with
+ * Welford's algorithm
+ */
+struct ReplicationMetric
+{
+  std::string name;
+  uint32_t n;
+  double mean;
+  double m2;
+
+  double GetVariance (void) const
+  {
+    return n > 1 ? m2 / (n - 1) : 0;
+  }
+};
+
+/**
+ * Decides how many replications a configuration needs.
+ *
+ * Every replication records one value per metric. The controller asks for
+ * more until at least minRuns were made and the half width of the
+ * Student-t confidence interval of the target metric is at most
+ * relativeHalfWidth times the absolute value of its mean, or until maxRuns
+ * were made. The interval of a metric whose mean is 0 only closes when its
+ * half width is 0. The caller runs replication i with RngRun = first run
+ * + i, so the replications are independent.
+ */
+class ReplicationController
+{
+public:
+  ReplicationController (double relativeHalfWidth, double confidence, uint32_t minRuns, uint32_t maxRuns)
+    : m_relativeHalfWidth (relativeHalfWidth),
+      m_confidence (confidence),
+      m_minRuns (std::max<uint32_t> (minRuns, 2)),
+      m_maxRuns (maxRuns),
+      m_target (0),
+      m_runs (0)
+  {
+    if (confidence <= 0 || confidence >= 1)
+      {
+        NS_FATAL_ERROR ("The confidence level must be in (0, 1)");
+      }
+    if (m_maxRuns < m_minRuns)
+      {
+        m_maxRuns = m_minRuns;
+      }
+  }
+
+  /**
+   * \returns the index of a new metric
+   */
+  uint32_t AddMetric (std::string name)
+  {
+    ReplicationMetric metric;
+    metric.name = name;
+    metric.n = 0;
+    metric.mean = 0;
+    metric.m2 = 0;
+    m_metrics.push_back (metric);
+    return m_metrics.size () - 1;
+  }
+
+  /**
+   * Set the metric whose interval decides when to stop
+   */
+  void SetTarget (std::string name)
+  {
+    m_target = Find (name);
+  }
+
+  void Record (std::string name, double value)
+  {
+    ReplicationMetric &metric = m_metrics[Find (name)];
+    metric.n++;
+    double delta = value - metric.mean;
+    metric.mean += delta / metric.n;
+    metric.m2 += delta * (value - metric.mean);
+  }
+
+  /**
+   * Count a replication, once all its metrics were recorded
+   */
+  void EndReplication (void)
+  {
+    m_runs++;
+  }
+
+  /**
+   * \returns true once no more replications are needed
+   */
+  bool Done (void) const
+  {
+    if (m_runs < m_minRuns)
+      {
+        return false;
+      }
+    if (m_runs >= m_maxRuns)
+      {
+        return true;
+      }
+    const ReplicationMetric &target = m_metrics[m_target];
+    return GetHalfWidth (m_target) <= m_relativeHalfWidth * std::abs (target.mean);
+  }
+
+  /**
+   * \returns true if the interval of the target reached the requested width
+   */
+  bool Converged (void) const
+  {
+    const ReplicationMetric &target = m_metrics[m_target];
+    return m_runs >= 2 && GetHalfWidth (m_target) <= m_relativeHalfWidth * std::abs (target.mean);
+  }
+
+  uint32_t GetRuns (void) const
+  {
+    return m_runs;
+  }
+
+  uint32_t GetNMetrics (void) const
+  {
+    return m_metrics.size ();
+  }
+
+  const ReplicationMetric &GetMetric (uint32_t i) const
+  {
+    return m_metrics[i];
+  }
+
+  /**
+   * \returns the half width of the confidence interval of a metric
+   */
+  double GetHalfWidth (uint32_t i) const
+  {
+    const ReplicationMetric &metric = m_metrics[i];
+    if (metric.n < 2)
+      {
+        return std::numeric_limits<double>::infinity ();
+      }
+    return StudentQuantile ((1 + m_confidence) / 2, metric.n - 1) * std::sqrt (metric.GetVariance () / metric.n);
+  }
+
+  /**
+   * \returns the quantile p of the standard normal distribution, with the
+   * rational approximation of Acklam (relative error below 1.2e-9)
+   */
+  static double NormalQuantile (double p)
+  {
+    static const double a[] = { -3.969683028665376e+01, 2.209460984245205e+02, -2.759285104469687e+02,
+                                1.383577518672690e+02, -3.066479806614716e+01, 2.506628277459239e+00 };
+    static const double b[] = { -5.447609879822406e+01, 1.615858368580409e+02, -1.556989798598866e+02,
+                                6.680131188771972e+01, -1.328068155288572e+01 };
+    static const double c[] = { -7.784894002430293e-03, -3.223964580411365e-01, -2.400758277161838e+00,
+                                -2.549732539343734e+00, 4.374664141464968e+00, 2.938163982698783e+00 };
+    static const double d[] = { 7.784695709041462e-03, 3.224671290700398e-01, 2.445134137142996e+00,
+                                3.754408661907416e+00 };
+    double q;
+    if (p < 0.02425)
+      {
+        q = std::sqrt (-2 * std::log (p));
+        return (((((c[0] * q + c[1]) * q + c[2]) * q + c[3]) * q + c[4]) * q + c[5])
+          / ((((d[0] * q + d[1]) * q + d[2]) * q + d[3]) * q + 1);
+      }
+    if (p > 1 - 0.02425)
+      {
+        q = std::sqrt (-2 * std::log (1 - p));
+        return -(((((c[0] * q + c[1]) * q + c[2]) * q + c[3]) * q + c[4]) * q + c[5])
+          / ((((d[0] * q + d[1]) * q + d[2]) * q + d[3]) * q + 1);
+      }
+    q = p - 0.5;
+    double r = q * q;
+    return (((((a[0] * r + a[1]) * r + a[2]) * r + a[3]) * r + a[4]) * r + a[5]) * q
+      / (((((b[0] * r + b[1]) * r + b[2]) * r + b[3]) * r + b[4]) * r + 1);
+  }
+
+  /**
+   * \returns the probability that a Student t variable with df degrees of
+   * freedom is below t, from the finite series of Abramowitz and Stegun
+   * (26.7.3 and 26.7.4) for integer degrees of freedom
+   */
+  static double StudentCdf (double t, uint32_t df)
+  {
+    double theta = std::atan (std::abs (t) / std::sqrt (double (df)));
+    double c2 = std::cos (theta) * std::cos (theta);
+    double term = 1;
+    double sum = 1;
+    double a;
+    if (df % 2 == 1)
+      {
+        for (uint32_t k = 3; k + 2 <= df; k += 2)
+          {
+            term *= c2 * (k - 1) / k;
+            sum += term;
+          }
+        a = 2 / M_PI * (theta + (df > 1 ? std::sin (theta) * std::cos (theta) * sum : 0));
+      }
+    else
+      {
+        for (uint32_t k = 2; k + 2 <= df; k += 2)
+          {
+            term *= c2 * (k - 1) / k;
+            sum += term;
+          }
+        a = std::sin (theta) * sum;
+      }
+    // a is the probability of |T| < |t|
+    return t < 0 ? (1 - a) / 2 : (1 + a) / 2;
+  }
+
+  /**
+   * \returns the quantile p of the Student t distribution with df degrees
+   * of freedom. One and two degrees of freedom have closed forms; above
+   * that the Cornish-Fisher expansion around the normal quantile, which is
+   * 0.8% off at three degrees of freedom and p = 0.995, is refined with
+   * Newton steps on StudentCdf to the precision of a double.
+   */
+  static double StudentQuantile (double p, uint32_t df)
+  {
+    if (df == 1)
+      {
+        return std::tan (M_PI * (p - 0.5));
+      }
+    if (df == 2)
+      {
+        double alpha = 4 * p * (1 - p);
+        return 2 * (p - 0.5) * std::sqrt (2 / alpha);
+      }
+    double z = NormalQuantile (p);
+    double z2 = z * z;
+    double v = df;
+    double t = z
+      + z * (z2 + 1) / (4 * v)
+      + z * ((5 * z2 + 16) * z2 + 3) / (96 * v * v)
+      + z * (((3 * z2 + 19) * z2 + 17) * z2 - 15) / (384 * v * v * v)
+      + z * ((((79 * z2 + 776) * z2 + 1482) * z2 - 1920) * z2 - 945) / (92160 * v * v * v * v);
+    double logNorm = std::lgamma ((v + 1) / 2) - std::lgamma (v / 2) - 0.5 * std::log (v * M_PI);
+    for (uint32_t i = 0; i < 8; i++)
+      {
+        double density = std::exp (logNorm - (v + 1) / 2 * std::log1p (t * t / v));
+        double step = (StudentCdf (t, df) - p) / density;
+        t -= step;
+        if (std::abs (step) <= 1e-12 * std::abs (t))
+          {
+            break;
+          }
+      }
+    return t;
+  }
+
+private:
+  uint32_t Find (std::string name) const
+  {
+    for (uint32_t i = 0; i < m_metrics.size (); i++)
+      {
+        if (m_metrics[i].name == name)
+          {
+            return i;
+          }
+      }
+    NS_FATAL_ERROR ("Unknown metric " << name);
+    return 0;
+  }
+
+  double m_relativeHalfWidth;
+  double m_confidence;
+  uint32_t m_minRuns;
+  uint32_t m_maxRuns;
+  uint32_t m_target;
+  uint32_t m_runs;
+  std::vector<ReplicationMetric> m_metrics;
+};
+
+} // namespace ns3
+
+#endif /* REPLICATION_CONTROLLER_H */
@@ -0,0 +1,163 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+  Store of the metrics of finished runs keyed by the hash of their
+  configuration, so a restarted sweep doesn't simulate them again.
+ */
+
+#ifndef RESULT_STORE_H
+#define RESULT_STORE_H
+
+#include "config-hash.h"
+#include "ns3/fatal-error.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace ns3 {
+
+/**
+ * One text file per configuration in a directory.
+ *
+ * The file of a configuration is named after its hash. Its first line is
+ * the hashed text, which is compared on lookup so a collision reads as a
+ * miss, and every other line holds the name and the value of a metric.
+ * Files are written under a temporary name and renamed, so processes
+ * sharing the directory never read a partial record.
+ *
+ * The key of a run has to hold everything its result depends on; GetBuild
+ * identifies the code, so a rebuilt scenario never reuses the results of
+ * the previous one. It is the SCENARIO_VERSION macro when the build defines
+ * it, such as -DSCENARIO_VERSION="\"$(git describe --always --dirty)\"",
+ * and otherwise a hash of the path, size and modification time of the
+ * program and of every shared library it has mapped, the ns-3 modules
+ * included, so rebuilding any of them changes it.
+ */
+class ResultStore
+{
+public:
+  ResultStore (std::string directory)
+    : m_directory (directory)
+  {
+    if (mkdir (directory.c_str (), 0755) != 0 && errno != EEXIST)
+      {
+        NS_FATAL_ERROR ("Can't create the result store " << directory);
+      }
+  }
+
+  static std::string GetBuild (void)
+  {
+#ifdef SCENARIO_VERSION
+    return SCENARIO_VERSION;
+#else
+    static std::string build;
+    if (build.empty ())
+      {
+        std::set<std::string> files;
+        char exe[4096];
+        ssize_t length = readlink ("/proc/self/exe", exe, sizeof (exe) - 1);
+        if (length > 0)
+          {
+            files.insert (std::string (exe, length));
+          }
+        // The executable mappings: address, permissions, offset, device, inode, path
+        std::ifstream maps ("/proc/self/maps");
+        std::string line;
+        while (std::getline (maps, line))
+          {
+            std::istringstream fields (line);
+            std::string address, permissions, offset, device, inode, path;
+            fields >> address >> permissions >> offset >> device >> inode >> path;
+            if (permissions.size () > 2 && permissions[2] == 'x' && !path.empty () && path[0] == '/')
+              {
+                files.insert (path);
+              }
+          }
+        ConfigHash hash;
+        for (std::set<std::string>::const_iterator f = files.begin (); f != files.end (); f++)
+          {
+            struct stat info;
+            if (stat (f->c_str (), &info) == 0)
+              {
+                std::ostringstream identity;
+                identity << info.st_size << " " << info.st_mtim.tv_sec << "." << info.st_mtim.tv_nsec;
+                hash.Add (*f, identity.str ());
+              }
+          }
+        build = hash.GetHex ();
+      }
+    return build;
+#endif
+  }
+
+  /**
+   * \returns true if the configuration has a record, which is read into
+   * values. A record with a line that isn't a name and a value is a miss.
+   */
+  bool Lookup (const ConfigHash &key, std::map<std::string, double> &values) const
+  {
+    std::ifstream in (GetFilename (key).c_str ());
+    std::string line;
+    if (!in || !std::getline (in, line) || line != "# " + key.GetText ())
+      {
+        return false;
+      }
+    values.clear ();
+    while (std::getline (in, line))
+      {
+        // strtod reads back the nan and inf that Store writes, >> doesn't
+        std::istringstream fields (line);
+        std::string name, text, extra;
+        char *end;
+        if (!(fields >> name >> text) || fields >> extra)
+          {
+            values.clear ();
+            return false;
+          }
+        double value = std::strtod (text.c_str (), &end);
+        if (*end != '\0')
+          {
+            values.clear ();
+            return false;
+          }
+        values[name] = value;
+      }
+    return true;
+  }
+
+  void Store (const ConfigHash &key, const std::map<std::string, double> &values) const
+  {
+    std::ostringstream temporary;
+    temporary << GetFilename (key) << ".tmp" << getpid ();
+    std::ofstream out (temporary.str ().c_str (), std::ios::trunc);
+    out.precision (17);
+    out << "# " << key.GetText () << "\n";
+    for (std::map<std::string, double>::const_iterator i = values.begin (); i != values.end (); i++)
+      {
+        out << i->first << " " << i->second << "\n";
+      }
+    out.close ();
+    if (!out || std::rename (temporary.str ().c_str (), GetFilename (key).c_str ()) != 0)
+      {
+        NS_FATAL_ERROR ("Can't write the result " << GetFilename (key));
+      }
+  }
+
+  std::string GetFilename (const ConfigHash &key) const
+  {
+    return m_directory + "/" + key.GetHex () + ".txt";
+  }
+
+private:
+  std::string m_directory;
+};
+
+} // namespace ns3
+
+#endif /* RESULT_STORE_H */
@@ -0,0 +1,232 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+  Arena for the bookkeeping of one run of a scenario, with free lists per
+  size class, given back at once when the run ends.
+ */
+
+#ifndef RUN_ARENA_H
+#define RUN_ARENA_H
+
+#include "ns3/assert.h"
+#include <algorithm>
+#include <cstddef>
+#include <new>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * Monotonic arena with free lists per size class.
+ *
+ * Blocks are rounded up to ALIGNMENT and carved from CHUNK_SIZE chunks by
+ * bumping a pointer. A freed block is pushed on the free list of its size,
+ * which is where the next block of that size comes from, so the nodes of a
+ * container that is filled and emptied all run long reuse the same memory.
+ * Each container type has its own node size, hence in practice its own free
+ * list. Blocks over MAX_BLOCK go to the heap.
+ *
+ * Release ends the run: it drops the free lists and every chunk but the
+ * first, which the next run starts from. Nothing allocated from the arena
+ * may be alive by then.
+ */
+class RunArena
+{
+public:
+  static const size_t ALIGNMENT = 16;
+  static const size_t MAX_BLOCK = 512;
+  static const size_t CHUNK_SIZE = 1 << 20;
+
+  static RunArena &Get (void)
+  {
+    static RunArena arena;
+    return arena;
+  }
+
+  ~RunArena ()
+  {
+    for (size_t i = 0; i < m_chunks.size (); i++)
+      {
+        ::operator delete (m_chunks[i]);
+      }
+  }
+
+  void *Allocate (size_t size)
+  {
+    if (size > MAX_BLOCK)
+      {
+        return ::operator new (size);
+      }
+    size_t sizeClass = GetSizeClass (size);
+    m_inUse += (sizeClass + 1) * ALIGNMENT;
+    m_peak = std::max (m_peak, m_inUse);
+    FreeBlock *&head = m_freeLists[sizeClass];
+    if (head)
+      {
+        FreeBlock *block = head;
+        head = block->next;
+        return block;
+      }
+    size_t bytes = (sizeClass + 1) * ALIGNMENT;
+    if (m_next + bytes > m_end)
+      {
+        NextChunk ();
+      }
+    void *block = m_next;
+    m_next += bytes;
+    return block;
+  }
+
+  void Deallocate (void *p, size_t size)
+  {
+    if (size > MAX_BLOCK)
+      {
+        ::operator delete (p);
+        return;
+      }
+    size_t sizeClass = GetSizeClass (size);
+    m_inUse -= (sizeClass + 1) * ALIGNMENT;
+    FreeBlock *block = static_cast<FreeBlock *> (p);
+    block->next = m_freeLists[sizeClass];
+    m_freeLists[sizeClass] = block;
+  }
+
+  /**
+   * Give the memory of the run back, keeping the first chunk
+   */
+  void Release (void)
+  {
+    NS_ASSERT_MSG (m_inUse == 0, "Blocks of the run arena are still in use");
+    for (size_t i = 1; i < m_chunks.size (); i++)
+      {
+        ::operator delete (m_chunks[i]);
+      }
+    m_chunks.resize (std::min<size_t> (m_chunks.size (), 1));
+    m_current = 0;
+    m_next = m_chunks.empty () ? 0 : m_chunks[0];
+    m_end = m_chunks.empty () ? 0 : m_chunks[0] + CHUNK_SIZE;
+    for (size_t i = 0; i < N_CLASSES; i++)
+      {
+        m_freeLists[i] = 0;
+      }
+    m_peak = 0;
+  }
+
+  /**
+   * \returns the most bytes in use at once since the last Release
+   */
+  size_t GetPeakBytes (void) const
+  {
+    return m_peak;
+  }
+
+  /**
+   * \returns the bytes of the chunks the arena holds
+   */
+  size_t GetReservedBytes (void) const
+  {
+    return m_chunks.size () * CHUNK_SIZE;
+  }
+
+private:
+  static const size_t N_CLASSES = MAX_BLOCK / ALIGNMENT;
+
+  struct FreeBlock
+  {
+    FreeBlock *next;
+  };
+
+  RunArena ()
+    : m_current (0),
+      m_next (0),
+      m_end (0),
+      m_inUse (0),
+      m_peak (0)
+  {
+    for (size_t i = 0; i < N_CLASSES; i++)
+      {
+        m_freeLists[i] = 0;
+      }
+  }
+
+  static size_t GetSizeClass (size_t size)
+  {
+    return size == 0 ? 0 : (size - 1) / ALIGNMENT;
+  }
+
+  /**
+   * Move to the next chunk, reusing the ones kept by Release
+   */
+  void NextChunk (void)
+  {
+    if (!m_chunks.empty ())
+      {
+        m_current++;
+      }
+    if (m_current == m_chunks.size ())
+      {
+        m_chunks.push_back (static_cast<char *> (::operator new (CHUNK_SIZE)));
+      }
+    m_next = m_chunks[m_current];
+    m_end = m_next + CHUNK_SIZE;
+  }
+
+  std::vector<char *> m_chunks;
+  size_t m_current;                     //!< Chunk the blocks are carved from
+  char *m_next;
+  char *m_end;
+  FreeBlock *m_freeLists[N_CLASSES];
+  size_t m_inUse;
+  size_t m_peak;
+};
+
+/**
+ * Standard allocator drawing from the run arena, for the containers of the
+ * per-run bookkeeping
+ */
+template <typename T>
+class RunArenaAllocator
+{
+public:
+  typedef T value_type;
+
+  template <typename U>
+  struct rebind
+  {
+    typedef RunArenaAllocator<U> other;
+  };
+
+  RunArenaAllocator ()
+  {
+  }
+
+  template <typename U>
+  RunArenaAllocator (const RunArenaAllocator<U> &)
+  {
+  }
+
+  T *allocate (size_t n)
+  {
+    return static_cast<T *> (RunArena::Get ().Allocate (n * sizeof (T)));
+  }
+
+  void deallocate (T *p, size_t n)
+  {
+    RunArena::Get ().Deallocate (p, n * sizeof (T));
+  }
+};
+
+template <typename T, typename U>
+bool operator== (const RunArenaAllocator<T> &, const RunArenaAllocator<U> &)
+{
+  return true;
+}
+
+template <typename T, typename U>
+bool operator!= (const RunArenaAllocator<T> &, const RunArenaAllocator<U> &)
+{
+  return false;
+}
+
+} // namespace ns3
+
+#endif /* RUN_ARENA_H */
@@ -0,0 +1,446 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+  Profiler for the LoRaWAN and Wi-Fi scenarios: events per type and node and
+  timed trace callbacks, written as a JSON report at the end of each run.
+ */
+
+#ifndef SCENARIO_PROFILER_H
+#define SCENARIO_PROFILER_H
+
+#include "ns3/scheduler.h"
+#include "ns3/simulator.h"
+#include "ns3/object-factory.h"
+#include "ns3/type-id.h"
+#include "ns3/event-impl.h"
+#include "ns3/map-scheduler.h"
+#include <sys/resource.h>
+#include <cxxabi.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <typeinfo>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace ns3 {
+
+/**
+ * Cheapest available monotonic tick counter: the time stamp counter on x86,
+ * the steady clock in nanoseconds elsewhere.
+ */
+inline uint64_t
+ProfilerTicks (void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc ();
+#else
+  return std::chrono::duration_cast<std::chrono::nanoseconds> (
+    std::chrono::steady_clock::now ().time_since_epoch ()).count ();
+#endif
+}
+
+/**
+ * Scheduler that forwards everything to another scheduler and counts the
+ * events it hands to the simulator, by event type and by context.
+ */
+class ProfilingScheduler : public Scheduler
+{
+public:
+  static TypeId GetTypeId (void)
+  {
+    static TypeId tid = TypeId ("ns3::ProfilingScheduler")
+      .SetParent<Scheduler> ()
+      .SetGroupName ("Core")
+      .AddConstructor<ProfilingScheduler> ()
+      .AddAttribute ("InnerScheduler", "The scheduler that actually keeps the events",
+                     TypeIdValue (MapScheduler::GetTypeId ()),
+                     MakeTypeIdAccessor (&ProfilingScheduler::SetInnerScheduler),
+                     MakeTypeIdChecker ());
+    return tid;
+  }
+
+  ProfilingScheduler ()
+    : m_cancelled (0)
+  {
+    GetCurrent () = this;
+  }
+
+  virtual ~ProfilingScheduler ()
+  {
+    if (GetCurrent () == this)
+      {
+        GetCurrent () = 0;
+      }
+  }
+
+  /**
+   * \returns the scheduler of the current simulation, if it is profiled
+   */
+  static ProfilingScheduler *&GetCurrent (void)
+  {
+    static ProfilingScheduler *current = 0;
+    return current;
+  }
+
+  void SetInnerScheduler (TypeId tid)
+  {
+    ObjectFactory factory;
+    factory.SetTypeId (tid);
+    Ptr<Scheduler> inner = factory.Create<Scheduler> ();
+    while (m_inner && !m_inner->IsEmpty ())
+      {
+        inner->Insert (m_inner->RemoveNext ());
+      }
+    m_inner = inner;
+  }
+
+  virtual void Insert (const Event &ev)
+  {
+    m_inner->Insert (ev);
+  }
+
+  virtual bool IsEmpty (void) const
+  {
+    return m_inner->IsEmpty ();
+  }
+
+  virtual Event PeekNext (void) const
+  {
+    return m_inner->PeekNext ();
+  }
+
+  virtual Event RemoveNext (void)
+  {
+    Event ev = m_inner->RemoveNext ();
+    if (ev.impl->IsCancelled ())
+      {
+        m_cancelled++;
+      }
+    else
+      {
+        m_byType[&typeid (*ev.impl)]++;
+        m_byContext[ev.key.m_context]++;
+      }
+    return ev;
+  }
+
+  virtual void Remove (const Event &ev)
+  {
+    m_inner->Remove (ev);
+  }
+
+  const std::unordered_map<const std::type_info *, uint64_t> &GetEventsByType (void) const
+  {
+    return m_byType;
+  }
+
+  const std::unordered_map<uint32_t, uint64_t> &GetEventsByContext (void) const
+  {
+    return m_byContext;
+  }
+
+  uint64_t GetCancelledEvents (void) const
+  {
+    return m_cancelled;
+  }
+
+private:
+  Ptr<Scheduler> m_inner;
+  std::unordered_map<const std::type_info *, uint64_t> m_byType;
+  std::unordered_map<uint32_t, uint64_t> m_byContext;
+  uint64_t m_cancelled;
+};
+
+NS_OBJECT_ENSURE_REGISTERED (ProfilingScheduler);
+
+/**
+ * Collects the measurements of one Experiment::Run and writes them as JSON.
+ *
+ * A run goes through BeginRun (start of the setup), EndSetup (just before
+ * Simulator::Run) and EndRun (just after it, before Simulator::Destroy).
+ * Nothing is measured unless the profiler is enabled.
+ */
+class ScenarioProfiler
+{
+public:
+  static ScenarioProfiler &Get (void)
+  {
+    static ScenarioProfiler profiler;
+    return profiler;
+  }
+
+  void Enable (std::string scenario, std::string outputPrefix)
+  {
+    m_enabled = true;
+    m_scenario = scenario;
+    m_outputPrefix = outputPrefix;
+  }
+
+  bool IsEnabled (void) const
+  {
+    return m_enabled;
+  }
+
+  /**
+   * Select the scheduler wrapped by the profiling scheduler
+   */
+  void SetInnerScheduler (TypeId tid)
+  {
+    m_innerScheduler = tid;
+  }
+
+  void BeginRun (std::string label)
+  {
+    if (!m_enabled)
+      {
+        return;
+      }
+    m_run++;
+    m_label = label;
+    for (std::vector<Section>::iterator it = m_sections.begin (); it != m_sections.end (); ++it)
+      {
+        it->calls = 0;
+        it->ticks = 0;
+      }
+
+    ObjectFactory factory;
+    factory.SetTypeId (ProfilingScheduler::GetTypeId ());
+    factory.Set ("InnerScheduler", TypeIdValue (m_innerScheduler));
+    Simulator::SetScheduler (factory);
+
+    m_setupStart = std::chrono::steady_clock::now ();
+    m_setupEnd = m_setupStart;
+  }
+
+  void EndSetup (void)
+  {
+    if (!m_enabled)
+      {
+        return;
+      }
+    m_setupEnd = std::chrono::steady_clock::now ();
+    m_runStartTicks = ProfilerTicks ();
+    m_runStartEvents = Simulator::GetEventCount ();
+  }
+
+  /**
+   * Collect the measurements of the run and write the report. Must be called
+   * before Simulator::Destroy, while the scheduler still exists.
+   */
+  void EndRun (void)
+  {
+    if (!m_enabled)
+      {
+        return;
+      }
+    std::chrono::steady_clock::time_point runEnd = std::chrono::steady_clock::now ();
+    uint64_t runTicks = ProfilerTicks () - m_runStartTicks;
+    double setupSeconds = std::chrono::duration<double> (m_setupEnd - m_setupStart).count ();
+    double runSeconds = std::chrono::duration<double> (runEnd - m_setupEnd).count ();
+    double simulatedSeconds = Simulator::Now ().GetSeconds ();
+    uint64_t events = Simulator::GetEventCount () - m_runStartEvents;
+    double ticksPerNs = runSeconds > 0 ? runTicks / (runSeconds * 1e9) : 1;
+
+    ProfilingScheduler *scheduler = ProfilingScheduler::GetCurrent ();
+    struct rusage usage;
+    getrusage (RUSAGE_SELF, &usage);
+
+    std::string filename = m_outputPrefix + "-" + std::to_string (m_run) + ".json";
+    std::ofstream out (filename.c_str ());
+    out << "{\n"
+        << "  \"scenario\": \"" << Escape (m_scenario) << "\",\n"
+        << "  \"run\": " << m_run << ",\n"
+        << "  \"label\": \"" << Escape (m_label) << "\",\n"
+        << "  \"scheduler\": \"" << Escape (m_innerScheduler.GetName ()) << "\",\n"
+        << "  \"setup_wall_s\": " << setupSeconds << ",\n"
+        << "  \"run_wall_s\": " << runSeconds << ",\n"
+        << "  \"simulated_s\": " << simulatedSeconds << ",\n"
+        << "  \"events\": " << events << ",\n"
+        << "  \"events_per_s\": " << (runSeconds > 0 ? events / runSeconds : 0) << ",\n"
+        << "  \"sim_s_per_wall_s\": " << (runSeconds > 0 ? simulatedSeconds / runSeconds : 0) << ",\n"
+        << "  \"peak_rss_kb\": " << usage.ru_maxrss << ",\n"
+        << "  \"ticks_per_ns\": " << ticksPerNs << ",\n";
+
+    if (scheduler)
+      {
+        out << "  \"cancelled_events\": " << scheduler->GetCancelledEvents () << ",\n";
+        WriteEventTypes (out, scheduler->GetEventsByType ());
+        WriteEventSources (out, scheduler->GetEventsByContext ());
+      }
+
+    out << "  \"sections\": [";
+    for (size_t i = 0; i < m_sections.size (); i++)
+      {
+        const Section &section = m_sections[i];
+        double totalNs = section.ticks / ticksPerNs;
+        out << (i ? ",\n" : "\n")
+            << "    {\"name\": \"" << Escape (section.name) << "\", \"calls\": " << section.calls
+            << ", \"total_ns\": " << totalNs
+            << ", \"mean_ns\": " << (section.calls ? totalNs / section.calls : 0) << "}";
+      }
+    out << "\n  ]\n}\n";
+  }
+
+  /**
+   * Register a timed section, such as a trace callback
+   *
+   * \returns the index to pass to Record
+   */
+  uint32_t RegisterSection (std::string name)
+  {
+    Section section;
+    section.name = name;
+    section.calls = 0;
+    section.ticks = 0;
+    m_sections.push_back (section);
+    return m_sections.size () - 1;
+  }
+
+  void Record (uint32_t section, uint64_t ticks)
+  {
+    m_sections[section].calls++;
+    m_sections[section].ticks += ticks;
+  }
+
+private:
+  struct Section
+  {
+    std::string name;
+    uint64_t calls;
+    uint64_t ticks;
+  };
+
+  ScenarioProfiler ()
+    : m_enabled (false),
+      m_innerScheduler (MapScheduler::GetTypeId ()),
+      m_run (0),
+      m_runStartTicks (0),
+      m_runStartEvents (0)
+  {
+  }
+
+  static std::string Escape (std::string text)
+  {
+    std::string escaped;
+    for (std::string::iterator c = text.begin (); c != text.end (); ++c)
+      {
+        if (*c == '"' || *c == '\\')
+          {
+            escaped += '\\';
+          }
+        escaped += *c;
+      }
+    return escaped;
+  }
+
+  static std::string Demangle (const char *name)
+  {
+    int status = 0;
+    char *demangled = abi::__cxa_demangle (name, 0, 0, &status);
+    std::string result = status == 0 ? demangled : name;
+    std::free (demangled);
+    return result;
+  }
+
+  template <typename K>
+  static std::vector<std::pair<uint64_t, K> > SortByCount (const std::unordered_map<K, uint64_t> &counts)
+  {
+    std::vector<std::pair<uint64_t, K> > sorted;
+    for (typename std::unordered_map<K, uint64_t>::const_iterator it = counts.begin (); it != counts.end (); ++it)
+      {
+        sorted.push_back (std::make_pair (it->second, it->first));
+      }
+    std::sort (sorted.rbegin (), sorted.rend ());
+    return sorted;
+  }
+
+  void WriteEventTypes (std::ostream &out, const std::unordered_map<const std::type_info *, uint64_t> &byType) const
+  {
+    std::vector<std::pair<uint64_t, const std::type_info *> > sorted = SortByCount (byType);
+    out << "  \"event_types\": [";
+    for (size_t i = 0; i < sorted.size (); i++)
+      {
+        out << (i ? ",\n" : "\n")
+            << "    {\"type\": \"" << Escape (Demangle (sorted[i].second->name ()))
+            << "\", \"count\": " << sorted[i].first << "}";
+      }
+    out << "\n  ],\n";
+  }
+
+  void WriteEventSources (std::ostream &out, const std::unordered_map<uint32_t, uint64_t> &byContext) const
+  {
+    // Only the busiest nodes: there is one source per device
+    const size_t topSources = 20;
+    std::vector<std::pair<uint64_t, uint32_t> > sorted = SortByCount (byContext);
+    out << "  \"event_sources\": {\"distinct\": " << sorted.size () << ", \"top\": [";
+    for (size_t i = 0; i < sorted.size () && i < topSources; i++)
+      {
+        out << (i ? ", " : "") << "{\"context\": ";
+        if (sorted[i].second == Simulator::NO_CONTEXT)
+          {
+            out << "\"none\"";
+          }
+        else
+          {
+            out << sorted[i].second;
+          }
+        out << ", \"count\": " << sorted[i].first << "}";
+      }
+    out << "]},\n";
+  }
+
+  bool m_enabled;
+  std::string m_scenario;
+  std::string m_outputPrefix;
+  std::string m_label;
+  TypeId m_innerScheduler;
+  uint32_t m_run;
+  std::chrono::steady_clock::time_point m_setupStart;
+  std::chrono::steady_clock::time_point m_setupEnd;
+  uint64_t m_runStartTicks;
+  uint64_t m_runStartEvents;
+  std::vector<Section> m_sections;
+};
+
+/**
+ * Times the enclosing scope when the profiler is enabled
+ */
+class ProfileScope
+{
+public:
+  ProfileScope (uint32_t section)
+    : m_section (section),
+      m_start (ScenarioProfiler::Get ().IsEnabled () ? ProfilerTicks () : 0)
+  {
+  }
+
+  ~ProfileScope ()
+  {
+    if (m_start)
+      {
+        ScenarioProfiler::Get ().Record (m_section, ProfilerTicks () - m_start);
+      }
+  }
+
+private:
+  uint32_t m_section;
+  uint64_t m_start;
+};
+
+} // namespace ns3
+
+/**
+ * Time the rest of the enclosing block under the given name
+ */
+#define SCENARIO_PROFILE_SCOPE(name)                                    \
+  static const uint32_t scenarioProfileSection =                        \
+    ns3::ScenarioProfiler::Get ().RegisterSection (name);               \
+  ns3::ProfileScope scenarioProfileScope (scenarioProfileSection)
+
+#endif /* SCENARIO_PROFILER_H */
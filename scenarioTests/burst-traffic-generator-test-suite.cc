@@ -0,0 +1,108 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+  Tests of the alarm storm generator with the retries of a burst falling
+  after the senders stop.
+ */
+
+#include "ns3/test.h"
+#include "ns3/simulator.h"
+#include "ns3/uinteger.h"
+#include "ns3/nstime.h"
+#include "ns3/node-container.h"
+#include "ns3/mobility-helper.h"
+#include "ns3/propagation-loss-model.h"
+#include "ns3/propagation-delay-model.h"
+#include "ns3/lora-channel.h"
+#include "ns3/lora-helper.h"
+#include "ns3/lora-phy-helper.h"
+#include "ns3/lorawan-mac-helper.h"
+#include "../loraSimulation/burst-traffic-generator.h"
+
+// A scratch program is built from the sources of its own directory only
+#include "../loraSimulation/burst-traffic-generator.cc"
+
+using namespace ns3;
+using namespace lorawan;
+
+namespace {
+
+void
+RecordPendingSends (Ptr<BurstTrafficGenerator> generator, bool *pending)
+{
+  *pending = generator->HasPendingSends ();
+}
+
+} // namespace
+
+/**
+ * A burst fired before the senders stop still has its retry to send when
+ * they stop, and the generator reports it until it is sent
+ */
+class BurstTrafficGeneratorRetryTestCase : public TestCase
+{
+public:
+  BurstTrafficGeneratorRetryTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+BurstTrafficGeneratorRetryTestCase::BurstTrafficGeneratorRetryTestCase ()
+  : TestCase ("A retry after the senders stop is pending until sent")
+{
+}
+
+void
+BurstTrafficGeneratorRetryTestCase::DoRun (void)
+{
+  NodeContainer endDevices;
+  endDevices.Create (1);
+  MobilityHelper mobility;
+  mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+  mobility.Install (endDevices);
+
+  Ptr<LoraChannel> channel = CreateObject<LoraChannel> (CreateObject<LogDistancePropagationLossModel> (),
+                                                        CreateObject<ConstantSpeedPropagationDelayModel> ());
+  LoraPhyHelper phyHelper = LoraPhyHelper ();
+  phyHelper.SetChannel (channel);
+  phyHelper.SetDeviceType (LoraPhyHelper::ED);
+  LorawanMacHelper macHelper = LorawanMacHelper ();
+  macHelper.SetDeviceType (LorawanMacHelper::ED_A);
+  LoraHelper helper = LoraHelper ();
+  helper.Install (phyHelper, macHelper, endDevices);
+
+  // The retry comes after the off time of the first send at SF12, so the
+  // duty cycle doesn't postpone it
+  Ptr<BurstTrafficGenerator> generator = CreateObject<BurstTrafficGenerator> ();
+  generator->SetDevices (endDevices);
+  generator->SetAttribute ("Jitter", TimeValue (Seconds (0)));
+  generator->SetAttribute ("Retries", UintegerValue (1));
+  generator->SetAttribute ("RetryInterval", TimeValue (Seconds (300)));
+  generator->ScheduleBurst (Seconds (10));
+
+  Time appStopTime = Seconds (20);
+  bool pendingAtStop = false;
+  Simulator::Schedule (appStopTime, &RecordPendingSends, generator, &pendingAtStop);
+  Simulator::Stop (Seconds (1000));
+  Simulator::Run ();
+
+  NS_TEST_ASSERT_MSG_EQ (pendingAtStop, true, "The retry at 310 s is pending when the senders stop");
+  NS_TEST_ASSERT_MSG_EQ (generator->GetBurstCount (), 1, "One burst was scheduled");
+  NS_TEST_ASSERT_MSG_EQ (generator->GetSentPackets (), 2, "The first send and its retry were made");
+  NS_TEST_ASSERT_MSG_EQ (generator->HasPendingSends (), false, "Nothing is left to send");
+  Simulator::Destroy ();
+}
+
+class BurstTrafficGeneratorTestSuite : public TestSuite
+{
+public:
+  BurstTrafficGeneratorTestSuite ();
+};
+
+BurstTrafficGeneratorTestSuite::BurstTrafficGeneratorTestSuite ()
+  : TestSuite ("burst-traffic-generator", UNIT)
+{
+  AddTestCase (new BurstTrafficGeneratorRetryTestCase, TestCase::QUICK);
+}
+
+static BurstTrafficGeneratorTestSuite g_burstTrafficGeneratorTestSuite;
@@ -0,0 +1,146 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+  Tests of the hexagonal gateway layout.
+ */
+
+#include "ns3/test.h"
+#include "../loraSimulation/gateway-deployment.h"
+#include <cmath>
+#include <limits>
+
+// A scratch program is built from the sources of its own directory only
+#include "../loraSimulation/gateway-deployment.cc"
+
+using namespace ns3;
+using namespace lorawan;
+
+/**
+ * Full rings: the centre, 6 gateways at one spacing and 12 at two spacings
+ * or sqrt(3) spacings, each with its nearest neighbour at one spacing
+ */
+class HexagonalLayoutTestCase : public TestCase
+{
+public:
+  HexagonalLayoutTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+HexagonalLayoutTestCase::HexagonalLayoutTestCase ()
+  : TestCase ("Gateways fill the rings of a hexagonal grid")
+{
+}
+
+void
+HexagonalLayoutTestCase::DoRun (void)
+{
+  double spacing = 1000;
+  Ptr<GatewayDeployment> deployment = CreateObject<GatewayDeployment> ();
+  deployment->SetHexagonal (19, spacing);
+  NS_TEST_ASSERT_MSG_EQ (deployment->GetN (), 19, "Wrong number of gateways");
+
+  uint32_t ring1 = 0;
+  uint32_t ring2 = 0;
+  for (uint32_t i = 0; i < deployment->GetN (); i++)
+    {
+      Vector position = deployment->GetPosition (i);
+      NS_TEST_ASSERT_MSG_EQ (position.z, 15, "Gateway " << i << " isn't at the default height");
+      double radius = std::sqrt (position.x * position.x + position.y * position.y);
+      if (i == 0)
+        {
+          NS_TEST_ASSERT_MSG_EQ_TOL (radius, 0, 1e-9, "The first gateway is at the centre");
+        }
+      else if (i < 7)
+        {
+          NS_TEST_ASSERT_MSG_EQ_TOL (radius, spacing, 1e-6, "Gateway " << i << " is off the first ring");
+          ring1++;
+        }
+      else
+        {
+          NS_TEST_ASSERT_MSG_EQ (std::abs (radius - 2 * spacing) < 1e-6 || std::abs (radius - std::sqrt (3.0) * spacing) < 1e-6,
+                                 true, "Gateway " << i << " is off the second ring, at " << radius);
+          ring2++;
+        }
+
+      double nearest = std::numeric_limits<double>::infinity ();
+      for (uint32_t j = 0; j < deployment->GetN (); j++)
+        {
+          if (j != i)
+            {
+              nearest = std::min (nearest, CalculateDistance (position, deployment->GetPosition (j)));
+            }
+        }
+      NS_TEST_ASSERT_MSG_EQ_TOL (nearest, spacing, 1e-6, "Gateway " << i << " isn't on the grid");
+    }
+  NS_TEST_ASSERT_MSG_EQ (ring1, 6, "The first ring has 6 gateways");
+  NS_TEST_ASSERT_MSG_EQ (ring2, 12, "The second ring has 12 gateways");
+
+  // The allocator hands the positions out in slot order
+  Ptr<ListPositionAllocator> allocator = deployment->GetPositionAllocator ();
+  for (uint32_t i = 0; i < deployment->GetN (); i++)
+    {
+      Vector position = allocator->GetNext ();
+      NS_TEST_ASSERT_MSG_EQ_TOL (CalculateDistance (position, deployment->GetPosition (i)), 0, 1e-9,
+                                 "The allocator changed the order of slot " << i);
+    }
+}
+
+/**
+ * A partial ring is filled in order and the covering spacing gives the
+ * cells the area of the disc
+ */
+class HexagonalSpacingTestCase : public TestCase
+{
+public:
+  HexagonalSpacingTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+HexagonalSpacingTestCase::HexagonalSpacingTestCase ()
+  : TestCase ("Partial rings and the covering spacing")
+{
+}
+
+void
+HexagonalSpacingTestCase::DoRun (void)
+{
+  Ptr<GatewayDeployment> deployment = CreateObject<GatewayDeployment> ();
+  deployment->SetHexagonal (10, 500);
+  NS_TEST_ASSERT_MSG_EQ (deployment->GetN (), 10, "Wrong number of gateways");
+  for (uint32_t i = 0; i < 10; i++)
+    {
+      for (uint32_t j = 0; j < i; j++)
+        {
+          NS_TEST_ASSERT_MSG_GT (CalculateDistance (deployment->GetPosition (i), deployment->GetPosition (j)),
+                                 500 - 1e-6, "Gateways " << j << " and " << i << " are too close");
+        }
+    }
+  deployment->SetHexagonal (0, 500);
+  NS_TEST_ASSERT_MSG_EQ (deployment->GetN (), 0, "No gateway was asked for");
+
+  for (uint32_t n = 1; n <= 64; n *= 4)
+    {
+      double radius = 6400;
+      double spacing = GatewayDeployment::GetCoveringSpacing (n, radius);
+      NS_TEST_ASSERT_MSG_EQ_TOL (n * std::sqrt (3.0) / 2 * spacing * spacing, M_PI * radius * radius,
+                                 1e-6 * radius * radius, "The cells of " << n << " gateways don't cover the disc");
+    }
+}
+
+class GatewayDeploymentTestSuite : public TestSuite
+{
+public:
+  GatewayDeploymentTestSuite ();
+};
+
+GatewayDeploymentTestSuite::GatewayDeploymentTestSuite ()
+  : TestSuite ("gateway-deployment", UNIT)
+{
+  AddTestCase (new HexagonalLayoutTestCase, TestCase::QUICK);
+  AddTestCase (new HexagonalSpacingTestCase, TestCase::QUICK);
+}
+
+static GatewayDeploymentTestSuite g_gatewayDeploymentTestSuite;
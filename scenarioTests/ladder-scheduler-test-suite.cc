@@ -0,0 +1,208 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+  Tests of the ladder queue scheduler against the (time stamp, uid) order
+  of a sorted set.
+ */
+
+#include "ns3/test.h"
+#include "../loraSimulation/ladder-scheduler.h"
+#include <set>
+#include <utility>
+
+// A scratch program is built from the sources of its own directory only
+#include "../loraSimulation/ladder-scheduler.cc"
+
+using namespace ns3;
+using namespace lorawan;
+
+namespace {
+
+Scheduler::Event
+MakeEvent (uint64_t ts, uint32_t uid)
+{
+  Scheduler::Event ev;
+  ev.impl = 0;
+  ev.key.m_ts = ts;
+  ev.key.m_uid = uid;
+  ev.key.m_context = 0;
+  return ev;
+}
+
+/**
+ * Deterministic generator, so a failure can be replayed
+ */
+class Lcg
+{
+public:
+  Lcg (uint64_t seed)
+    : m_state (seed)
+  {
+  }
+
+  uint64_t Next (uint64_t n)
+  {
+    m_state = m_state * 6364136223846793005ULL + 1442695040888963407ULL;
+    return (m_state >> 33) % n;
+  }
+
+private:
+  uint64_t m_state;
+};
+
+} // namespace
+
+/**
+ * Events of the same time stamp leave in the order of their uid, after
+ * every earlier event, whatever the order they were inserted in
+ */
+class LadderSchedulerTiesTestCase : public TestCase
+{
+public:
+  LadderSchedulerTiesTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+LadderSchedulerTiesTestCase::LadderSchedulerTiesTestCase ()
+  : TestCase ("Events at the same time leave in uid order")
+{
+}
+
+void
+LadderSchedulerTiesTestCase::DoRun (void)
+{
+  Ptr<LadderScheduler> scheduler = CreateObject<LadderScheduler> ();
+  // More ties than Threshold, so the bucket can't be split by time
+  for (uint32_t uid = 200; uid-- > 0;)
+    {
+      scheduler->Insert (MakeEvent (1000 + (uid % 2) * 1000, uid));
+    }
+  scheduler->Insert (MakeEvent (500, 300));
+
+  NS_TEST_ASSERT_MSG_EQ (scheduler->RemoveNext ().key.m_uid, 300, "The earliest event has to leave first");
+  for (uint32_t i = 0; i < 200; i++)
+    {
+      Scheduler::Event ev = scheduler->RemoveNext ();
+      NS_TEST_ASSERT_MSG_EQ (ev.key.m_ts, i < 100 ? 1000 : 2000, "Events left out of time order");
+      NS_TEST_ASSERT_MSG_EQ (ev.key.m_uid, i < 100 ? 2 * i : 2 * (i - 100) + 1, "Ties left out of uid order");
+    }
+  NS_TEST_ASSERT_MSG_EQ (scheduler->IsEmpty (), true, "The scheduler should be empty");
+}
+
+/**
+ * Random inserts, removals and cancellations checked against a sorted set,
+ * with time profiles that exercise Top, the rungs and Bottom
+ */
+class LadderSchedulerOrderTestCase : public TestCase
+{
+public:
+  LadderSchedulerOrderTestCase ();
+
+private:
+  virtual void DoRun (void);
+
+  /**
+   * \returns the delay of a new event after the last one removed
+   */
+  static uint64_t GetDelay (Lcg &random, uint32_t profile);
+};
+
+LadderSchedulerOrderTestCase::LadderSchedulerOrderTestCase ()
+  : TestCase ("Events leave in (time, uid) order")
+{
+}
+
+uint64_t
+LadderSchedulerOrderTestCase::GetDelay (Lcg &random, uint32_t profile)
+{
+  switch (profile)
+    {
+    case 0:
+      // Spread over a period
+      return random.Next (1000000);
+    case 1:
+      // Bursts at the same instant, a fixed offset ahead and just after now
+      if (random.Next (4) == 0)
+        {
+          return 0;
+        }
+      return random.Next (2) ? 1000000 + random.Next (10) : random.Next (50);
+    case 2:
+      // Few distinct time stamps
+      return random.Next (100) * 10000;
+    default:
+      // Deliveries within microseconds ahead of a ladder of later sends
+      if (random.Next (8) == 0)
+        {
+          return 1000000000 + random.Next (1000000);
+        }
+      return random.Next (44000);
+    }
+}
+
+void
+LadderSchedulerOrderTestCase::DoRun (void)
+{
+  for (uint32_t trial = 0; trial < 40; trial++)
+    {
+      Lcg random (trial + 1);
+      uint32_t profile = trial % 4;
+      Ptr<LadderScheduler> scheduler = CreateObject<LadderScheduler> ();
+      std::set<std::pair<uint64_t, uint32_t> > expected;
+      uint32_t uid = 0;
+      uint64_t now = 0;
+      for (uint32_t step = 0; step < 20000; step++)
+        {
+          uint64_t operation = random.Next (10);
+          if (operation < 5 || expected.empty ())
+            {
+              // A send delivered to every PHY at once, enough deliveries
+              // for Bottom to be spread over a new rung
+              uint32_t count = (profile == 3 && random.Next (300) == 0) ? 300 : 1;
+              for (uint32_t i = 0; i < count; i++)
+                {
+                  Scheduler::Event ev = MakeEvent (now + GetDelay (random, profile), uid++);
+                  scheduler->Insert (ev);
+                  expected.insert (std::make_pair (ev.key.m_ts, ev.key.m_uid));
+                }
+            }
+          else if (operation < 9)
+            {
+              Scheduler::Event ev = scheduler->RemoveNext ();
+              NS_TEST_ASSERT_MSG_EQ (ev.key.m_ts, expected.begin ()->first, "Wrong time stamp, trial " << trial);
+              NS_TEST_ASSERT_MSG_EQ (ev.key.m_uid, expected.begin ()->second, "Wrong uid, trial " << trial);
+              expected.erase (expected.begin ());
+              now = ev.key.m_ts;
+            }
+          else
+            {
+              std::set<std::pair<uint64_t, uint32_t> >::iterator it = expected.begin ();
+              std::advance (it, random.Next (expected.size ()));
+              scheduler->Remove (MakeEvent (it->first, it->second));
+              expected.erase (it);
+            }
+          NS_TEST_ASSERT_MSG_EQ (scheduler->IsEmpty (), expected.empty (), "Wrong size, trial " << trial);
+          if (!expected.empty ())
+            {
+              NS_TEST_ASSERT_MSG_EQ (scheduler->PeekNext ().key.m_uid, expected.begin ()->second,
+                                     "Wrong next event, trial " << trial);
+            }
+        }
+    }
+}
+
+class LadderSchedulerTestSuite : public TestSuite
+{
+public:
+  LadderSchedulerTestSuite ();
+};
+
+LadderSchedulerTestSuite::LadderSchedulerTestSuite ()
+  : TestSuite ("ladder-scheduler", UNIT)
+{
+  AddTestCase (new LadderSchedulerTiesTestCase, TestCase::QUICK);
+  AddTestCase (new LadderSchedulerOrderTestCase, TestCase::QUICK);
+}
+
+static LadderSchedulerTestSuite g_ladderSchedulerTestSuite;
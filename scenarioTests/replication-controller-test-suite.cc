@@ -0,0 +1,141 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+  Tests of the replication controller: the Student t quantiles against the
+  tables and the stopping rule on known replications.
+ */
+
+#include "ns3/test.h"
+#include "../replication-controller.h"
+
+using namespace ns3;
+
+/**
+ * The quantiles against the tables, including the small degrees of freedom
+ * where the Cornish-Fisher expansion alone is off
+ */
+class StudentQuantileTestCase : public TestCase
+{
+public:
+  StudentQuantileTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+StudentQuantileTestCase::StudentQuantileTestCase ()
+  : TestCase ("Student t quantiles match the tables")
+{
+}
+
+void
+StudentQuantileTestCase::DoRun (void)
+{
+  NS_TEST_ASSERT_MSG_EQ_TOL (ReplicationController::NormalQuantile (0.975), 1.959964, 1e-6, "Normal quantile");
+  NS_TEST_ASSERT_MSG_EQ_TOL (ReplicationController::NormalQuantile (0.005), -2.575829, 1e-6, "Normal quantile");
+
+  struct
+  {
+    double p;
+    uint32_t df;
+    double quantile;
+  } table[] = {
+    { 0.975, 1, 12.706205 },
+    { 0.975, 2, 4.302653 },
+    { 0.975, 3, 3.182446 },
+    { 0.995, 3, 5.840909 },
+    { 0.995, 4, 4.604095 },
+    { 0.975, 5, 2.570582 },
+    { 0.025, 5, -2.570582 },
+    { 0.975, 9, 2.262157 },
+    { 0.95, 30, 1.697261 },
+    { 0.975, 1000, 1.962339 },
+  };
+  for (uint32_t i = 0; i < sizeof (table) / sizeof (table[0]); i++)
+    {
+      double quantile = ReplicationController::StudentQuantile (table[i].p, table[i].df);
+      NS_TEST_ASSERT_MSG_EQ_TOL (quantile, table[i].quantile, 1e-6 * std::abs (table[i].quantile),
+                                 "Quantile " << table[i].p << " with " << table[i].df << " degrees of freedom");
+      NS_TEST_ASSERT_MSG_EQ_TOL (ReplicationController::StudentCdf (quantile, table[i].df), table[i].p, 1e-9,
+                                 "The distribution function should invert the quantile");
+    }
+}
+
+/**
+ * The mean and the interval of the recorded values, and when the
+ * controller stops asking for replications
+ */
+class ReplicationStoppingTestCase : public TestCase
+{
+public:
+  ReplicationStoppingTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+ReplicationStoppingTestCase::ReplicationStoppingTestCase ()
+  : TestCase ("Replications stop once the interval is narrow enough")
+{
+}
+
+void
+ReplicationStoppingTestCase::DoRun (void)
+{
+  // Mean 10, sample variance 2.5, half width t(0.975, 4) sqrt(2.5 / 5)
+  double values[] = { 8, 9, 10, 11, 12 };
+  double halfWidth = 2.776445 * std::sqrt (0.5);
+
+  ReplicationController narrow (halfWidth / 10 * 0.99, 0.95, 3, 100);
+  narrow.AddMetric ("pdr");
+  narrow.SetTarget ("pdr");
+  ReplicationController wide (halfWidth / 10 * 1.01, 0.95, 3, 100);
+  wide.AddMetric ("pdr");
+  wide.SetTarget ("pdr");
+  for (uint32_t i = 0; i < 5; i++)
+    {
+      NS_TEST_ASSERT_MSG_EQ (wide.Done (), false, "Stopped before the interval was narrow enough");
+      narrow.Record ("pdr", values[i]);
+      narrow.EndReplication ();
+      wide.Record ("pdr", values[i]);
+      wide.EndReplication ();
+    }
+  NS_TEST_ASSERT_MSG_EQ_TOL (wide.GetMetric (0).mean, 10, 1e-12, "Wrong mean");
+  NS_TEST_ASSERT_MSG_EQ_TOL (wide.GetMetric (0).GetVariance (), 2.5, 1e-12, "Wrong variance");
+  NS_TEST_ASSERT_MSG_EQ_TOL (wide.GetHalfWidth (0), halfWidth, 1e-5, "Wrong half width");
+  NS_TEST_ASSERT_MSG_EQ (wide.Done (), true, "The interval is narrow enough");
+  NS_TEST_ASSERT_MSG_EQ (wide.Converged (), true, "The interval is narrow enough");
+  NS_TEST_ASSERT_MSG_EQ (narrow.Done (), false, "The interval isn't narrow enough yet");
+
+  // The minimum number of runs comes first, the maximum caps the rest
+  ReplicationController bounded (1, 0.95, 4, 6);
+  bounded.AddMetric ("pdr");
+  bounded.SetTarget ("pdr");
+  for (uint32_t i = 0; i < 6; i++)
+    {
+      NS_TEST_ASSERT_MSG_EQ (bounded.Done (), false, "Stopped before the bounds allow it, run " << i);
+      // A mean of 0 with a spread never converges
+      bounded.Record ("pdr", i % 2 ? 1 : -1);
+      bounded.EndReplication ();
+      if (i < 3)
+        {
+          NS_TEST_ASSERT_MSG_EQ (bounded.Done (), false, "Stopped before the minimum runs");
+        }
+    }
+  NS_TEST_ASSERT_MSG_EQ (bounded.Done (), true, "The maximum runs were made");
+  NS_TEST_ASSERT_MSG_EQ (bounded.Converged (), false, "A null mean with a spread can't converge");
+}
+
+class ReplicationControllerTestSuite : public TestSuite
+{
+public:
+  ReplicationControllerTestSuite ();
+};
+
+ReplicationControllerTestSuite::ReplicationControllerTestSuite ()
+  : TestSuite ("replication-controller", UNIT)
+{
+  AddTestCase (new StudentQuantileTestCase, TestCase::QUICK);
+  AddTestCase (new ReplicationStoppingTestCase, TestCase::QUICK);
+}
+
+static ReplicationControllerTestSuite g_replicationControllerTestSuite;
@@ -0,0 +1,147 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+  Tests of the configuration hash and of the store of run results keyed by
+  it.
+ */
+
+#include "ns3/test.h"
+#include "../config-hash.h"
+#include "../result-store.h"
+#include <cmath>
+#include <fstream>
+#include <limits>
+
+using namespace ns3;
+
+/**
+ * The hash is FNV-1a of the "name=value;" text, so it depends on the values
+ * and their order only
+ */
+class ConfigHashTestCase : public TestCase
+{
+public:
+  ConfigHashTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+ConfigHashTestCase::ConfigHashTestCase ()
+  : TestCase ("The configuration hash is stable and order dependent")
+{
+}
+
+void
+ConfigHashTestCase::DoRun (void)
+{
+  NS_TEST_ASSERT_MSG_EQ (ConfigHash ().GetHex (), "cbf29ce484222325", "The empty hash is the FNV-1a offset basis");
+  ConfigHash single;
+  single.Add ("a", "");
+  NS_TEST_ASSERT_MSG_EQ (single.GetText (), "a=;", "Wrong hashed text");
+  NS_TEST_ASSERT_MSG_EQ (single.GetHex (), "e650ea1904923568", "Wrong FNV-1a hash of \"a=;\"");
+
+  ConfigHash first;
+  first.Add ("nDevices", 1000).Add ("radius", 6400.5).Add ("distribution", "exponential");
+  ConfigHash same;
+  same.Add ("nDevices", 1000).Add ("radius", 6400.5).Add ("distribution", "exponential");
+  ConfigHash swapped;
+  swapped.Add ("radius", 6400.5).Add ("nDevices", 1000).Add ("distribution", "exponential");
+  ConfigHash other;
+  other.Add ("nDevices", 1001).Add ("radius", 6400.5).Add ("distribution", "exponential");
+
+  NS_TEST_ASSERT_MSG_EQ (first.GetText (), "nDevices=1000;radius=6400.5;distribution=exponential;",
+                         "Wrong hashed text");
+  NS_TEST_ASSERT_MSG_EQ (first.Get (), same.Get (), "The same parameters should give the same hash");
+  NS_TEST_ASSERT_MSG_NE (first.Get (), swapped.Get (), "The order of the parameters should count");
+  NS_TEST_ASSERT_MSG_NE (first.Get (), other.Get (), "A different value should give another hash");
+  NS_TEST_ASSERT_MSG_EQ (first.GetHex ().size (), 16, "The hex form has 16 digits");
+
+  // Doubles keep all their digits
+  ConfigHash tenth;
+  tenth.Add ("x", 0.1);
+  ConfigHash close;
+  close.Add ("x", 0.1 + 1e-16);
+  NS_TEST_ASSERT_MSG_EQ (tenth.GetText (), "x=0.10000000000000001;", "Doubles are written with 17 digits");
+  NS_TEST_ASSERT_MSG_NE (tenth.Get (), close.Get (), "Doubles one ulp apart should differ");
+}
+
+/**
+ * A stored result reads back with its values, and only for its own
+ * configuration
+ */
+class ResultStoreTestCase : public TestCase
+{
+public:
+  ResultStoreTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+ResultStoreTestCase::ResultStoreTestCase ()
+  : TestCase ("Stored results read back only for their configuration")
+{
+}
+
+void
+ResultStoreTestCase::DoRun (void)
+{
+  ResultStore store (CreateTempDirFilename ("result-store"));
+  ConfigHash key;
+  key.Add ("build", ResultStore::GetBuild ()).Add ("nDevices", 100).Add ("run", 3);
+  ConfigHash otherKey;
+  otherKey.Add ("build", ResultStore::GetBuild ()).Add ("nDevices", 100).Add ("run", 4);
+
+  std::map<std::string, double> values;
+  NS_TEST_ASSERT_MSG_EQ (store.Lookup (key, values), false, "Nothing was stored yet");
+
+  std::map<std::string, double> stored;
+  stored["pdr"] = 0.1234567890123456789;
+  stored["throughput"] = 1e-300;
+  stored["packets"] = 123456789;
+  store.Store (key, stored);
+  NS_TEST_ASSERT_MSG_EQ (store.Lookup (key, values), true, "The result was stored");
+  NS_TEST_ASSERT_MSG_EQ (values.size (), stored.size (), "Wrong number of values");
+  for (std::map<std::string, double>::const_iterator i = stored.begin (); i != stored.end (); i++)
+    {
+      NS_TEST_ASSERT_MSG_EQ (values[i->first], i->second, "The value of " << i->first << " changed");
+    }
+  NS_TEST_ASSERT_MSG_EQ (store.Lookup (otherKey, values), false, "Another configuration has no result");
+
+  // The metrics of a run without packets, whose ratios are 0/0
+  std::map<std::string, double> nonFinite;
+  nonFinite["delay"] = std::numeric_limits<double>::quiet_NaN ();
+  nonFinite["pdr"] = 0.5;
+  nonFinite["rate"] = -std::numeric_limits<double>::infinity ();
+  store.Store (key, nonFinite);
+  NS_TEST_ASSERT_MSG_EQ (store.Lookup (key, values), true, "The result with a NaN was stored");
+  NS_TEST_ASSERT_MSG_EQ (values.size (), nonFinite.size (), "The values after the NaN were dropped");
+  NS_TEST_ASSERT_MSG_EQ (std::isnan (values["delay"]), true, "The NaN didn't read back");
+  NS_TEST_ASSERT_MSG_EQ (values["pdr"], 0.5, "The value after the NaN changed");
+  NS_TEST_ASSERT_MSG_EQ (values["rate"], -std::numeric_limits<double>::infinity (), "The infinity didn't read back");
+
+  // A record with the same file name but another configuration, as a hash
+  // collision would leave, isn't read
+  std::ofstream collision (store.GetFilename (otherKey).c_str ());
+  collision << "# " << key.GetText () << "\npdr 0.5\n";
+  collision.close ();
+  NS_TEST_ASSERT_MSG_EQ (store.Lookup (otherKey, values), false, "The record of another configuration was read");
+
+  NS_TEST_ASSERT_MSG_EQ (ResultStore::GetBuild ().empty (), false, "The build should be identified");
+  NS_TEST_ASSERT_MSG_EQ (ResultStore::GetBuild (), ResultStore::GetBuild (), "The build should not change");
+}
+
+class ResultStoreTestSuite : public TestSuite
+{
+public:
+  ResultStoreTestSuite ();
+};
+
+ResultStoreTestSuite::ResultStoreTestSuite ()
+  : TestSuite ("result-store", UNIT)
+{
+  AddTestCase (new ConfigHashTestCase, TestCase::QUICK);
+  AddTestCase (new ResultStoreTestCase, TestCase::QUICK);
+}
+
+static ResultStoreTestSuite g_resultStoreTestSuite;
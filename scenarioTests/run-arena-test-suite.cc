@@ -0,0 +1,200 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+  Tests of the run arena: free lists per size class, chunk reuse across runs
+  and the allocator of the per-run containers.
+ */
+
+#include "ns3/test.h"
+#include "../run-arena.h"
+#include <algorithm>
+#include <map>
+#include <utility>
+#include <vector>
+
+using namespace ns3;
+
+/**
+ * A freed block is handed out again for any size of its class, and only
+ * for that class
+ */
+class RunArenaFreeListTestCase : public TestCase
+{
+public:
+  RunArenaFreeListTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+RunArenaFreeListTestCase::RunArenaFreeListTestCase ()
+  : TestCase ("Freed blocks are reused by their size class")
+{
+}
+
+void
+RunArenaFreeListTestCase::DoRun (void)
+{
+  RunArena &arena = RunArena::Get ();
+  arena.Release ();
+
+  void *a = arena.Allocate (40);
+  void *b = arena.Allocate (40);
+  NS_TEST_ASSERT_MSG_NE (a, b, "Two live blocks can't share memory");
+  arena.Deallocate (a, 40);
+
+  // 33 to 48 bytes are the same class as 40
+  void *c = arena.Allocate (20);
+  NS_TEST_ASSERT_MSG_NE (c, a, "A block of another class came from the free list");
+  void *d = arena.Allocate (33);
+  NS_TEST_ASSERT_MSG_EQ (d, a, "The freed block of the class wasn't reused");
+
+  // Last in, first out
+  arena.Deallocate (b, 48);
+  arena.Deallocate (d, 40);
+  NS_TEST_ASSERT_MSG_EQ (arena.Allocate (48), d, "The last freed block should come first");
+  NS_TEST_ASSERT_MSG_EQ (arena.Allocate (48), b, "The free list lost a block");
+
+  arena.Deallocate (b, 48);
+  arena.Deallocate (d, 48);
+  arena.Deallocate (c, 20);
+  arena.Release ();
+}
+
+/**
+ * Blocks are aligned and disjoint, the peak counts the rounded sizes and
+ * Release keeps a single chunk that the next run starts from
+ */
+class RunArenaChunkTestCase : public TestCase
+{
+public:
+  RunArenaChunkTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+RunArenaChunkTestCase::RunArenaChunkTestCase ()
+  : TestCase ("Blocks are aligned and chunks are kept across runs")
+{
+}
+
+void
+RunArenaChunkTestCase::DoRun (void)
+{
+  RunArena &arena = RunArena::Get ();
+  arena.Release ();
+
+  // More than a chunk, in every size class
+  std::vector<std::pair<char *, size_t> > blocks;
+  size_t expectedPeak = 0;
+  for (size_t i = 0; expectedPeak <= RunArena::CHUNK_SIZE; i++)
+    {
+      size_t size = 1 + (i * 37) % RunArena::MAX_BLOCK;
+      blocks.push_back (std::make_pair (static_cast<char *> (arena.Allocate (size)), size));
+      expectedPeak += (size + RunArena::ALIGNMENT - 1) / RunArena::ALIGNMENT * RunArena::ALIGNMENT;
+    }
+  NS_TEST_ASSERT_MSG_EQ (arena.GetPeakBytes (), expectedPeak, "The peak should add the rounded sizes");
+  NS_TEST_ASSERT_MSG_EQ (arena.GetReservedBytes (), 2 * RunArena::CHUNK_SIZE, "The arena should hold two chunks");
+
+  std::vector<std::pair<char *, size_t> > sorted (blocks);
+  std::sort (sorted.begin (), sorted.end ());
+  for (size_t i = 0; i < sorted.size (); i++)
+    {
+      NS_TEST_ASSERT_MSG_EQ (reinterpret_cast<uintptr_t> (sorted[i].first) % RunArena::ALIGNMENT, 0,
+                             "Block " << i << " isn't aligned");
+      if (i + 1 < sorted.size ())
+        {
+          NS_TEST_ASSERT_MSG_EQ (sorted[i].first + sorted[i].second <= sorted[i + 1].first, true,
+                                 "Blocks " << i << " and " << i + 1 << " overlap");
+        }
+    }
+
+  // Blocks over MAX_BLOCK come from the heap and aren't counted
+  void *large = arena.Allocate (RunArena::MAX_BLOCK + 1);
+  NS_TEST_ASSERT_MSG_EQ (arena.GetPeakBytes (), expectedPeak, "A large block was counted in the arena");
+  arena.Deallocate (large, RunArena::MAX_BLOCK + 1);
+
+  for (size_t i = 0; i < blocks.size (); i++)
+    {
+      arena.Deallocate (blocks[i].first, blocks[i].second);
+    }
+  arena.Release ();
+  NS_TEST_ASSERT_MSG_EQ (arena.GetPeakBytes (), 0, "Release should reset the peak");
+  NS_TEST_ASSERT_MSG_EQ (arena.GetReservedBytes (), RunArena::CHUNK_SIZE, "Release should keep one chunk");
+
+  // The free lists were dropped: the next run carves from the start of the
+  // kept chunk again
+  void *first = arena.Allocate (blocks[0].second);
+  NS_TEST_ASSERT_MSG_EQ (first, blocks[0].first, "The next run should start at the kept chunk");
+  arena.Deallocate (first, blocks[0].second);
+  arena.Release ();
+}
+
+/**
+ * The nodes of a container using RunArenaAllocator are all given back when
+ * it is emptied, and their memory is reused by the next fill
+ */
+class RunArenaAllocatorTestCase : public TestCase
+{
+public:
+  RunArenaAllocatorTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+RunArenaAllocatorTestCase::RunArenaAllocatorTestCase ()
+  : TestCase ("Containers give their nodes back to the free lists")
+{
+}
+
+void
+RunArenaAllocatorTestCase::DoRun (void)
+{
+  typedef std::map<uint32_t, double, std::less<uint32_t>, RunArenaAllocator<std::pair<const uint32_t, double> > >
+    ArenaMap;
+
+  RunArena &arena = RunArena::Get ();
+  arena.Release ();
+  size_t peak = 0;
+  for (uint32_t run = 0; run < 3; run++)
+    {
+      ArenaMap values;
+      for (uint32_t i = 0; i < 10000; i++)
+        {
+          values[i * 7919] = i;
+        }
+      for (uint32_t i = 0; i < 10000; i += 2)
+        {
+          values.erase (i * 7919);
+        }
+      NS_TEST_ASSERT_MSG_EQ (values.size (), 5000, "Wrong size of the map");
+      NS_TEST_ASSERT_MSG_EQ (values[7919], 1, "Wrong value in the map");
+      if (run == 0)
+        {
+          peak = arena.GetPeakBytes ();
+        }
+      else
+        {
+          NS_TEST_ASSERT_MSG_EQ (arena.GetPeakBytes (), peak, "Refilling the map should reuse the freed nodes");
+        }
+    }
+  // Release asserts that no block is in use any more
+  arena.Release ();
+}
+
+class RunArenaTestSuite : public TestSuite
+{
+public:
+  RunArenaTestSuite ();
+};
+
+RunArenaTestSuite::RunArenaTestSuite ()
+  : TestSuite ("run-arena", UNIT)
+{
+  AddTestCase (new RunArenaFreeListTestCase, TestCase::QUICK);
+  AddTestCase (new RunArenaChunkTestCase, TestCase::QUICK);
+  AddTestCase (new RunArenaAllocatorTestCase, TestCase::QUICK);
+}
+
+static RunArenaTestSuite g_runArenaTestSuite;
@@ -0,0 +1,16 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+  Unit tests of the helpers shared by the LoRaWAN and Wi-Fi scenarios. Built
+  as its own program next to them in the scratch directory, it runs every
+  suite, or the one given with --suite=<name>.
+ */
+
+#include "ns3/test.h"
+
+using namespace ns3;
+
+int
+main (int argc, char *argv[])
+{
+  return TestRunner::Run (argc, argv);
+}
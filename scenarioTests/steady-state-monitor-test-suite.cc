@@ -0,0 +1,138 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+  Tests of the steady-state monitor on ratio metrics with a known warm-up
+  and with windows in which the denominator doesn't move.
+ */
+
+#include "ns3/test.h"
+#include "ns3/simulator.h"
+#include "../steady-state-monitor.h"
+
+using namespace ns3;
+
+namespace {
+
+/**
+ * 10 packets per second, delivered at 50% for 100 s and then at 90%, 2
+ * packets above or below every other 10 s window
+ */
+double
+WarmupSent (void)
+{
+  return 10 * Simulator::Now ().GetSeconds ();
+}
+
+double
+WarmupReceived (void)
+{
+  double t = Simulator::Now ().GetSeconds ();
+  double received = 5 * std::min (t, 100.0) + 9 * std::max (t - 100, 0.0);
+  return received + (int (t / 10) % 2 ? 2 : 0);
+}
+
+/**
+ * Nothing is sent from 100 s to 120 s, while 4 packets sent before still
+ * arrive
+ */
+double
+GapSent (void)
+{
+  double t = Simulator::Now ().GetSeconds ();
+  return t < 100 ? 10 * t : t < 120 ? 1000 : 10 * (t - 20);
+}
+
+double
+GapReceived (void)
+{
+  return 0.8 * GapSent () + (Simulator::Now ().GetSeconds () >= 105 ? 4 : 0);
+}
+
+} // namespace
+
+/**
+ * The transient is cut at its end and the run stops once the delivery
+ * ratio after it is known to the tolerance
+ */
+class SteadyStateWarmupTestCase : public TestCase
+{
+public:
+  SteadyStateWarmupTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+SteadyStateWarmupTestCase::SteadyStateWarmupTestCase ()
+  : TestCase ("The warm-up is truncated and the run stops when steady")
+{
+}
+
+void
+SteadyStateWarmupTestCase::DoRun (void)
+{
+  Ptr<SteadyStateMonitor> monitor = Create<SteadyStateMonitor> (Seconds (10), 0.01);
+  monitor->SetSource (MakeCallback (&WarmupReceived), MakeCallback (&WarmupSent));
+  monitor->SetStopWhenSteady (true);
+  monitor->Start (Seconds (0));
+  Simulator::Stop (Seconds (5000));
+  Simulator::Run ();
+
+  NS_TEST_ASSERT_MSG_EQ (monitor->IsSteady (), true, "The ratio is steady after 100 s");
+  NS_TEST_ASSERT_MSG_EQ_TOL (monitor->GetWarmupEnd ().GetSeconds (), 100, 1e-9, "The warm-up lasts 100 s");
+  NS_TEST_ASSERT_MSG_EQ_TOL (monitor->GetEstimate (), 0.9, 0.002, "Wrong steady-state ratio");
+  NS_TEST_ASSERT_MSG_LT (monitor->GetSteadyTime ().GetSeconds (), 1000, "The run should have stopped early");
+  NS_TEST_ASSERT_MSG_LT (monitor->GetHalfWidth (), 0.01 * monitor->GetEstimate (), "Interval too wide");
+  Simulator::Destroy ();
+}
+
+/**
+ * A window in which nothing was sent is merged into the next one, so what
+ * was received in it still counts
+ */
+class SteadyStateGapTestCase : public TestCase
+{
+public:
+  SteadyStateGapTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+SteadyStateGapTestCase::SteadyStateGapTestCase ()
+  : TestCase ("Windows without a denominator are merged into the next one")
+{
+}
+
+void
+SteadyStateGapTestCase::DoRun (void)
+{
+  Ptr<SteadyStateMonitor> monitor = Create<SteadyStateMonitor> (Seconds (10), 0.01);
+  monitor->SetSource (MakeCallback (&GapReceived), MakeCallback (&GapSent));
+  // Keep sampling the whole run
+  monitor->SetBatches (10, 1000);
+  monitor->Start (Seconds (0));
+  Simulator::Stop (Seconds (300.5));
+  Simulator::Run ();
+  monitor->Finish ();
+
+  NS_TEST_ASSERT_MSG_EQ (monitor->GetWindows (), 28, "The two windows of the gap should be merged");
+  NS_TEST_ASSERT_MSG_EQ_TOL (monitor->GetWarmupEnd ().GetSeconds (), 0, 1e-9, "There is no warm-up");
+  NS_TEST_ASSERT_MSG_EQ_TOL (monitor->GetEstimate (), (0.8 * 2800 + 4) / 2800, 1e-12,
+                             "The packets received during the gap were lost");
+  Simulator::Destroy ();
+}
+
+class SteadyStateMonitorTestSuite : public TestSuite
+{
+public:
+  SteadyStateMonitorTestSuite ();
+};
+
+SteadyStateMonitorTestSuite::SteadyStateMonitorTestSuite ()
+  : TestSuite ("steady-state-monitor", UNIT)
+{
+  AddTestCase (new SteadyStateWarmupTestCase, TestCase::QUICK);
+  AddTestCase (new SteadyStateGapTestCase, TestCase::QUICK);
+}
+
+static SteadyStateMonitorTestSuite g_steadyStateMonitorTestSuite;
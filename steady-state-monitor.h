@@ -0,0 +1,303 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+  Steady-state detection: a ratio metric is sampled in windows, the warm-up is
+  cut with MSER-5 and the run can stop once the batch means converge.
+ */
+
+#ifndef STEADY_STATE_MONITOR_H
+#define STEADY_STATE_MONITOR_H
+
+#include "ns3/simulator.h"
+#include "ns3/callback.h"
+#include "ns3/nstime.h"
+#include "ns3/simple-ref-count.h"
+#include "replication-controller.h"
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * Windowed monitor of a ratio metric, such as received / sent packets, or
+ * received bits / seconds.
+ *
+ * At the end of every window the numerator and denominator callbacks are
+ * read and their increments in the window stored; without a denominator
+ * callback the denominator is the length of the window in seconds. A window
+ * with no increment of the denominator is merged into the next one, so the
+ * numerator counted in it isn't lost.
+ *
+ * The warm-up is found with MSER-5: the windows are grouped five by five
+ * and the truncation point d that minimises the variance of the batches
+ * after d divided by their number squared is chosen, among the first half
+ * of the batches; a minimum in the second half means the metric is not
+ * steady yet. The windows after the warm-up are split into a fixed number
+ * of batches, and the run is steady when the Student-t interval of their
+ * means is narrower than the tolerance times the mean. The estimate is the
+ * ratio of the sums over the windows after the warm-up.
+ */
+class SteadyStateMonitor : public SimpleRefCount<SteadyStateMonitor>
+{
+public:
+  SteadyStateMonitor (Time window, double tolerance)
+    : m_window (window),
+      m_tolerance (tolerance),
+      m_confidence (0.95),
+      m_batches (10),
+      m_minWindows (20),
+      m_stop (false),
+      m_index (0),
+      m_windowBegin (0),
+      m_lastNumerator (0),
+      m_lastDenominator (0),
+      m_steady (false),
+      m_truncated (0),
+      m_estimate (std::numeric_limits<double>::quiet_NaN ()),
+      m_halfWidth (std::numeric_limits<double>::infinity ())
+  {
+  }
+
+  /**
+   * Set the cumulative numerator and denominator of the metric; a null
+   * denominator measures the numerator per second
+   */
+  void SetSource (Callback<double> numerator, Callback<double> denominator)
+  {
+    m_numerator = numerator;
+    m_denominator = denominator;
+  }
+
+  /**
+   * Stop the simulation as soon as the metric is steady
+   */
+  void SetStopWhenSteady (bool stop)
+  {
+    m_stop = stop;
+  }
+
+  /**
+   * Set the number of batches of the interval and the number of windows
+   * needed before checking it
+   */
+  void SetBatches (uint32_t batches, uint32_t minWindows)
+  {
+    m_batches = batches;
+    m_minWindows = minWindows;
+  }
+
+  void Start (Time start)
+  {
+    m_startTime = start;
+    Simulator::Schedule (start, &SteadyStateMonitor::StartSampling, this);
+  }
+
+  /**
+   * Analyse all the windows collected, for the runs that ended before the
+   * metric was steady
+   */
+  void Finish (void)
+  {
+    if (!m_steady)
+      {
+        Analyse ();
+      }
+  }
+
+  bool IsSteady (void) const
+  {
+    return m_steady;
+  }
+
+  /**
+   * \returns the estimate of the metric without the warm-up, NaN if there
+   * were not enough windows
+   */
+  double GetEstimate (void) const
+  {
+    return m_estimate;
+  }
+
+  /**
+   * \returns the half width of the interval of the estimate
+   */
+  double GetHalfWidth (void) const
+  {
+    return m_halfWidth;
+  }
+
+  /**
+   * \returns the time the warm-up ended
+   */
+  Time GetWarmupEnd (void) const
+  {
+    if (m_truncated >= m_windowStart.size ())
+      {
+        return m_startTime;
+      }
+    return m_startTime + Seconds (m_window.GetSeconds () * m_windowStart[m_truncated]);
+  }
+
+  /**
+   * \returns the time the metric was found steady
+   */
+  Time GetSteadyTime (void) const
+  {
+    return m_steadyTime;
+  }
+
+  uint32_t GetWindows (void) const
+  {
+    return m_num.size ();
+  }
+
+private:
+  void StartSampling (void)
+  {
+    m_lastNumerator = m_numerator ();
+    m_lastDenominator = m_denominator.IsNull () ? 0 : m_denominator ();
+    m_index = 0;
+    m_windowBegin = 0;
+    Simulator::Schedule (m_window, &SteadyStateMonitor::Sample, this);
+  }
+
+  void Sample (void)
+  {
+    m_index++;
+    double numerator = m_numerator ();
+    double denominator = m_denominator.IsNull () ? m_lastDenominator + m_window.GetSeconds () : m_denominator ();
+    if (denominator > m_lastDenominator)
+      {
+        m_num.push_back (numerator - m_lastNumerator);
+        m_den.push_back (denominator - m_lastDenominator);
+        m_windowStart.push_back (m_windowBegin);
+        m_lastNumerator = numerator;
+        m_lastDenominator = denominator;
+        m_windowBegin = m_index;
+      }
+
+    if (m_num.size () >= m_minWindows && Analyse ())
+      {
+        m_steady = true;
+        m_steadyTime = Simulator::Now ();
+        if (m_stop)
+          {
+            Simulator::Stop ();
+          }
+        return;
+      }
+    Simulator::Schedule (m_window, &SteadyStateMonitor::Sample, this);
+  }
+
+  /**
+   * Find the warm-up and compute the estimate and its interval
+   *
+   * \returns true if the metric is steady
+   */
+  bool Analyse (void)
+  {
+    uint32_t n = m_num.size ();
+    uint32_t b = n / 5;
+    if (b < 2)
+      {
+        return false;
+      }
+    // MSER-5, with suffix sums of the batch means
+    std::vector<double> z (b);
+    for (uint32_t j = 0; j < b; j++)
+      {
+        double num = 0;
+        double den = 0;
+        for (uint32_t i = 5 * j; i < 5 * j + 5; i++)
+          {
+            num += m_num[i];
+            den += m_den[i];
+          }
+        z[j] = num / den;
+      }
+    double sum = 0;
+    double sumSquares = 0;
+    double best = std::numeric_limits<double>::infinity ();
+    uint32_t bestD = 0;
+    for (uint32_t d = b; d-- > 0;)
+      {
+        sum += z[d];
+        sumSquares += z[d] * z[d];
+        uint32_t remaining = b - d;
+        if (d <= b / 2)
+          {
+            double variance = sumSquares - sum * sum / remaining;
+            double mser = variance / (double (remaining) * remaining);
+            if (mser <= best)
+              {
+                best = mser;
+                bestD = d;
+              }
+          }
+      }
+    m_truncated = 5 * bestD;
+
+    // Batch means of the windows after the warm-up
+    uint32_t m = n - m_truncated;
+    uint32_t size = m / m_batches;
+    double num = 0;
+    double den = 0;
+    for (uint32_t i = m_truncated; i < n; i++)
+      {
+        num += m_num[i];
+        den += m_den[i];
+      }
+    m_estimate = den > 0 ? num / den : std::numeric_limits<double>::quiet_NaN ();
+    if (size < 1 || m_batches < 2)
+      {
+        return false;
+      }
+    double mean = 0;
+    double m2 = 0;
+    for (uint32_t k = 0; k < m_batches; k++)
+      {
+        double batchNum = 0;
+        double batchDen = 0;
+        for (uint32_t i = m_truncated + k * size; i < m_truncated + (k + 1) * size; i++)
+          {
+            batchNum += m_num[i];
+            batchDen += m_den[i];
+          }
+        double y = batchNum / batchDen;
+        double delta = y - mean;
+        mean += delta / (k + 1);
+        m2 += delta * (y - mean);
+      }
+    m_halfWidth = ReplicationController::StudentQuantile ((1 + m_confidence) / 2, m_batches - 1)
+      * std::sqrt (m2 / (m_batches - 1) / m_batches);
+    // A truncation at the end of the allowed range means the transient lasts
+    return bestD < b / 2 && m_halfWidth <= m_tolerance * std::abs (m_estimate);
+  }
+
+  Time m_window;
+  double m_tolerance;
+  double m_confidence;
+  uint32_t m_batches;
+  uint32_t m_minWindows;
+  bool m_stop;
+  Callback<double> m_numerator;
+  Callback<double> m_denominator;
+  Time m_startTime;
+  uint32_t m_index;
+  uint32_t m_windowBegin;               //!< Index of the first window merged into the next stored one
+  double m_lastNumerator;
+  double m_lastDenominator;
+  std::vector<double> m_num;
+  std::vector<double> m_den;
+  std::vector<uint32_t> m_windowStart;  //!< Index of each stored window since the start
+
+  bool m_steady;
+  Time m_steadyTime;
+  uint32_t m_truncated;                 //!< Windows discarded as warm-up
+  double m_estimate;
+  double m_halfWidth;
+};
+
+} // namespace ns3
+
+#endif /* STEADY_STATE_MONITOR_H */
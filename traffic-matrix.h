@@ -0,0 +1,284 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+  Traffic matrix for the Wi-Fi scenario: concurrent source to sink flows
+  chosen from a pattern, with one packet sink per destination node.
+ */
+
+#ifndef TRAFFIC_MATRIX_H
+#define TRAFFIC_MATRIX_H
+
+#include "ns3/simulator.h"
+#include "ns3/node-container.h"
+#include "ns3/application-container.h"
+#include "ns3/on-off-helper.h"
+#include "ns3/packet-sink-helper.h"
+#include "ns3/packet-sink.h"
+#include "ns3/inet-socket-address.h"
+#include "ns3/ipv4.h"
+#include "ns3/boolean.h"
+#include "ns3/random-variable-stream.h"
+#include "ns3/fatal-error.h"
+#include "ns3/simple-ref-count.h"
+#include <algorithm>
+#include <cmath>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * Set of OnOff flows between the nodes of a network.
+ *
+ * The patterns are:
+ *  - single: one flow from the first node to the last one
+ *  - random: distinct source -> sink pairs drawn uniformly
+ *  - all-to-one: flows from distinct random nodes to the last node, every
+ *    other node if the number of flows is 0
+ *  - gravity: every node gets an exponentially distributed mass and the
+ *    pair (i, j) is drawn with probability proportional to m_i * m_j
+ *
+ * A node appears at most once as the source of a flow to a given sink, so
+ * the sink and the source address identify a flow. The matrix counts the
+ * packets sent by every flow; the received ones are only counted per sink,
+ * the per-flow reception is left to FlowStatsExporter.
+ */
+class TrafficMatrix : public SimpleRefCount<TrafficMatrix>
+{
+public:
+  TrafficMatrix (std::string pattern)
+    : m_pattern (pattern),
+      m_rng (CreateObject<UniformRandomVariable> ())
+  {
+    if (pattern != "single" && pattern != "random" && pattern != "all-to-one" && pattern != "gravity")
+      {
+        NS_FATAL_ERROR ("Unknown traffic pattern " << pattern << ", use single, random, all-to-one or gravity");
+      }
+  }
+
+  /**
+   * Fix the stream of the generator that draws the pairs
+   *
+   * \returns the number of streams used
+   */
+  int64_t AssignStreams (int64_t stream)
+  {
+    m_rng->SetStream (stream);
+    return 1;
+  }
+
+  /**
+   * Draw the source -> sink pairs among the given nodes
+   */
+  void Generate (NodeContainer nodes, uint32_t flows)
+  {
+    m_nodes = nodes;
+    m_pairs.clear ();
+    uint32_t n = nodes.GetN ();
+    if (n < 2)
+      {
+        NS_FATAL_ERROR ("A traffic matrix needs at least two nodes");
+      }
+
+    if (m_pattern == "single")
+      {
+        m_pairs.push_back (std::make_pair (0, n - 1));
+      }
+    else if (m_pattern == "all-to-one")
+      {
+        if (flows == 0 || flows > n - 1)
+          {
+            flows = n - 1;
+          }
+        // Partial Fisher-Yates shuffle of the candidate sources
+        std::vector<uint32_t> sources;
+        for (uint32_t i = 0; i < n - 1; i++)
+          {
+            sources.push_back (i);
+          }
+        for (uint32_t f = 0; f < flows; f++)
+          {
+            uint32_t pick = f + m_rng->GetInteger (0, n - 2 - f);
+            std::swap (sources[f], sources[pick]);
+            m_pairs.push_back (std::make_pair (sources[f], n - 1));
+          }
+      }
+    else
+      {
+        uint64_t maxFlows = uint64_t (n) * (n - 1);
+        if (flows == 0 || flows > maxFlows)
+          {
+            NS_FATAL_ERROR ("The " << m_pattern << " pattern needs between 1 and " << maxFlows << " flows");
+          }
+        std::vector<double> cumulative;
+        if (m_pattern == "gravity")
+          {
+            double total = 0;
+            for (uint32_t i = 0; i < n; i++)
+              {
+                total += -std::log (1 - m_rng->GetValue ());
+                cumulative.push_back (total);
+              }
+          }
+        std::set<std::pair<uint32_t, uint32_t> > used;
+        while (m_pairs.size () < flows)
+          {
+            uint32_t source = Draw (cumulative);
+            uint32_t sink = Draw (cumulative);
+            if (source == sink || !used.insert (std::make_pair (source, sink)).second)
+              {
+                continue;
+              }
+            m_pairs.push_back (std::make_pair (source, sink));
+          }
+      }
+  }
+
+  /**
+   * Install a packet sink on every destination and an application built by
+   * the source helper on every source, with its Remote set to the sink
+   */
+  void Install (OnOffHelper source, uint16_t port, Time sourceStart, Time sourceStop, Time sinkStart)
+  {
+    PacketSinkHelper sinkHelper ("ns3::UdpSocketFactory", InetSocketAddress (Ipv4Address::GetAny (), port));
+    sinkHelper.SetAttribute ("EnableSeqTsSizeHeader", BooleanValue (true));
+    std::vector<int32_t> sinkOfNode (m_nodes.GetN (), -1);
+
+    for (uint32_t f = 0; f < m_pairs.size (); f++)
+      {
+        Ptr<Node> sinkNode = m_nodes.Get (m_pairs[f].second);
+        if (sinkOfNode[m_pairs[f].second] < 0)
+          {
+            ApplicationContainer apps = sinkHelper.Install (sinkNode);
+            apps.Start (sinkStart);
+            sinkOfNode[m_pairs[f].second] = m_sinks.size ();
+            m_sinks.push_back (DynamicCast<PacketSink> (apps.Get (0)));
+          }
+        m_flowSink.push_back (sinkOfNode[m_pairs[f].second]);
+
+        Ipv4Address remote = sinkNode->GetObject<Ipv4> ()->GetAddress (1, 0).GetLocal ();
+        source.SetAttribute ("Remote", AddressValue (InetSocketAddress (remote, port)));
+        ApplicationContainer apps = source.Install (m_nodes.Get (m_pairs[f].first));
+        apps.Start (sourceStart);
+        apps.Stop (sourceStop);
+        m_sources.push_back (apps.Get (0));
+        m_txPackets.push_back (0);
+        apps.Get (0)->TraceConnectWithoutContext ("Tx", MakeBoundCallback (&TrafficMatrix::TxTrace, this, f));
+      }
+  }
+
+  uint32_t GetNFlows (void) const
+  {
+    return m_pairs.size ();
+  }
+
+  std::pair<uint32_t, uint32_t> GetPair (uint32_t flow) const
+  {
+    return m_pairs[flow];
+  }
+
+  Ptr<Application> GetSource (uint32_t flow) const
+  {
+    return m_sources[flow];
+  }
+
+  Ptr<PacketSink> GetSink (uint32_t flow) const
+  {
+    return m_sinks[m_flowSink[flow]];
+  }
+
+  /**
+   * \returns the address the packets of a flow come from
+   */
+  Ipv4Address GetSourceAddress (uint32_t flow) const
+  {
+    return m_nodes.Get (m_pairs[flow].first)->GetObject<Ipv4> ()->GetAddress (1, 0).GetLocal ();
+  }
+
+  /**
+   * \returns the distinct sinks
+   */
+  const std::vector<Ptr<PacketSink> > &GetSinks (void) const
+  {
+    return m_sinks;
+  }
+
+  uint64_t GetTxPackets (uint32_t flow) const
+  {
+    return m_txPackets[flow];
+  }
+
+  uint64_t GetTotalTxPackets (void) const
+  {
+    uint64_t total = 0;
+    for (uint32_t f = 0; f < m_txPackets.size (); f++)
+      {
+        total += m_txPackets[f];
+      }
+    return total;
+  }
+
+  /**
+   * \returns the time from the first packet sent by any source to the last
+   * one, zero if there were less than two, which is the interval the
+   * sources were really active in whatever their start and stop times and
+   * the end of the run
+   */
+  Time GetActiveTime (void) const
+  {
+    return m_lastTx - m_firstTx;
+  }
+
+  /**
+   * \returns the bytes received by all the sinks
+   */
+  uint64_t GetTotalRx (void) const
+  {
+    uint64_t total = 0;
+    for (uint32_t s = 0; s < m_sinks.size (); s++)
+      {
+        total += m_sinks[s]->GetTotalRx ();
+      }
+    return total;
+  }
+
+private:
+  static void TxTrace (TrafficMatrix *matrix, uint32_t flow, Ptr<const Packet> packet)
+  {
+    if (matrix->m_lastTx.IsZero ())
+      {
+        matrix->m_firstTx = Simulator::Now ();
+      }
+    matrix->m_lastTx = Simulator::Now ();
+    matrix->m_txPackets[flow]++;
+  }
+
+  /**
+   * Draw a node uniformly, or by its weight when cumulative weights are given
+   */
+  uint32_t Draw (const std::vector<double> &cumulative)
+  {
+    if (cumulative.empty ())
+      {
+        return m_rng->GetInteger (0, m_nodes.GetN () - 1);
+      }
+    double target = m_rng->GetValue (0, cumulative.back ());
+    return std::upper_bound (cumulative.begin (), cumulative.end () - 1, target) - cumulative.begin ();
+  }
+
+  std::string m_pattern;
+  Ptr<UniformRandomVariable> m_rng;
+  NodeContainer m_nodes;
+  std::vector<std::pair<uint32_t, uint32_t> > m_pairs;  //!< Source and sink index of each flow
+  std::vector<Ptr<Application> > m_sources;
+  std::vector<Ptr<PacketSink> > m_sinks;
+  std::vector<uint32_t> m_flowSink;                      //!< Index in m_sinks of each flow
+  std::vector<uint64_t> m_txPackets;
+  Time m_firstTx;
+  Time m_lastTx;
+};
+
+} // namespace ns3
+
+#endif /* TRAFFIC_MATRIX_H */
@@ -24,6 +24,16 @@
 #include "ns3/olsr-helper.h"
 #include "ns3/animation-interface.h"
 #include "ns3/gnuplot.h"
+#include "scenario-profiler.h"
+#include "flight-recorder.h"
+#include "flow-stats-exporter.h"
+#include "traffic-matrix.h"
+#include "position-routing.h"
+#include "grid-spectrum-channel.h"
+#include "per-table-error-model.h"
+#include "replication-controller.h"
+#include "steady-state-monitor.h"
+#include "result-store.h"
 using namespace ns3;
 
 //
@@ -31,10 +41,124 @@ using namespace ns3;
 //
 NS_LOG_COMPONENT_DEFINE("WifiAdHoc");
 
+//
+// Capture settings. The ascii, pcap and NetAnim traces of the whole run are
+// opt-in; by default a flight recorder keeps the last frames of every device
+// in memory and only writes the ones around a throughput drop, a delay spike
+// or an explicit window.
+//
+bool fullTrace = false;
+bool flightRecorder = true;
+uint32_t snapLen = 128;
+uint32_t captureSlots = 0;
+double capturePre = 2;
+double capturePost = 1;
+double captureStart = -1;
+double captureStop = -1;
+double throughputDrop = 0.2;
+double delaySpike = 5;
+uint32_t runNumber = 0;
+
+//
+// Flow statistics. FlowMonitor, with its per-packet state and XML output, is
+// opt-in; by default only the tracked flows are followed with online
+// accumulators and a snapshot is written every interval.
+//
+bool flowMonitorXml = false;
+std::string flowStats = "wifi-adhoc-flows";
+bool flowStatsBinary = false;
+double flowStatsInterval = 1;
+std::string trackFlows = "";
+
+//
+// Traffic matrix: the OnOff flows and how their endpoints are chosen
+//
+std::string trafficPattern = "single";
+uint32_t flows = 1;
+
+//
+// Routing: OLSR, or routes computed from the node positions and installed
+// as static routes, which sends no control traffic
+//
+std::string routing = "olsr";
+double routingRange = 0;
+double linkMargin = 6;
+double routingCheckInterval = 1;
+
+//
+// Channel: the Yans channel delivers every frame to every PHY, the grid
+// channel only to the PHYs within range of the sender
+//
+std::string channelType = "yans";
+
+//
+// Error model: the analytic DSSS error rates of the PHY, or a table of them
+// generated once and mapped by every run
+//
+std::string errorModel = "analytic";
+std::string perTable = "wifi-per-table.bin";
+
+//
+// Replications: each traffic type is repeated with consecutive RngRun values
+// until the confidence interval of ciMetric (throughput, pdr or delay) is
+// narrower than ciWidth times its mean; 0 runs each traffic type once
+//
+double ciWidth = 0;
+double ciConfidence = 0.95;
+std::string ciMetric = "throughput";
+uint32_t minReplications = 3;
+uint32_t maxReplications = 30;
+
+//
+// Steady state: the aggregate throughput is sampled in windows, the warm-up
+// found by MSER-5 is discarded and the run stops once the batch means of the
+// rest converge
+//
+bool steadyState = false;
+double steadyWindow = 1;
+double steadyTolerance = 0.05;
+bool steadyStop = true;
+
+//
+// Result store: a run whose configuration, traffic, seed and build already
+// have a record in the directory is read back instead of simulated, unless
+// forceRun is set; empty disables the store
+//
+std::string resultStore = "";
+bool forceRun = false;
+
+// Metrics of a run
+struct RunMetrics {
+  double throughput;  // Mbps, all the flows
+  double pdr;
+  double delay;       // s, mean over the tracked flows
+};
+
+static double ReceivedMegabits(Ptr<TrafficMatrix> matrix) {
+  return matrix->GetTotalRx() * 8.0 / 1000000;
+}
+
+// Mbps received over the interval the sources were really sending in, which
+// the MaxBytes limit or an early stop can make shorter than the time between
+// their start and stop
+static double AggregateThroughput(Ptr<TrafficMatrix> matrix) {
+  double seconds = matrix->GetActiveTime().GetSeconds();
+  return seconds > 0 ? ReceivedMegabits(matrix) / seconds : 0;
+}
+
+static uint64_t SentBytes(Ptr<TrafficMatrix> matrix, uint32_t packetSize) {
+  return matrix->GetTotalTxPackets() * packetSize;
+}
+
+static void NotifySinkDelay(Ptr<FlightRecorder> recorder, Ptr<const Packet> packet, const Address &from,
+  const Address &to, const SeqTsSizeHeader &header) {
+  recorder->NotifyDelay(Simulator::Now() - header.GetTs());
+}
+
 class Experiment {
   public:
     Experiment();
-    void Run(StringValue onTime, StringValue offTime, uint32_t nodes, uint32_t stopTime, uint32_t packetSizeOnOff, uint32_t radius);
+    RunMetrics Run(StringValue onTime, StringValue offTime, uint32_t nodes, uint32_t stopTime, uint32_t packetSizeOnOff, uint32_t radius);
 };
 
 // void Experiment::ReceivePacket(Ptr<Socket> socket) {
@@ -45,8 +169,10 @@ class Experiment {
 
 Experiment::Experiment() {}
 
-void Experiment::Run(StringValue onTime, StringValue offTime, uint32_t nodes, uint32_t stopTime, uint32_t packetSizeOnOff, uint32_t radius) {
+RunMetrics Experiment::Run(StringValue onTime, StringValue offTime, uint32_t nodes, uint32_t stopTime, uint32_t packetSizeOnOff, uint32_t radius) {
 
+  ScenarioProfiler::Get().BeginRun(offTime.Get());
+  runNumber++;
 
  	//
  	// First, we declare and initialize a few local variables that control some
@@ -77,26 +203,51 @@ void Experiment::Run(StringValue onTime, StringValue offTime, uint32_t nodes, ui
   WifiMacHelper mac;
   mac.SetType("ns3::AdhocWifiMac");
 
-  YansWifiPhyHelper wifiPhy;
+  YansWifiPhyHelper yansPhy;
+  SpectrumWifiPhyHelper spectrumPhy;
+  WifiPhyHelper &wifiPhy = channelType == "grid" ? static_cast<WifiPhyHelper &>(spectrumPhy) : static_cast<WifiPhyHelper &>(yansPhy);
   wifiPhy.SetPcapDataLinkType(WifiPhyHelper::DLT_IEEE802_11_RADIO);
 
-  YansWifiChannelHelper wifiChannel=YansWifiChannelHelper::Default();
-  
-
  	//Wifi channel creation
-  wifiPhy.SetChannel(wifiChannel.Create());
+  Ptr<GridSpectrumChannel> gridChannel;
+  if (channelType == "yans") {
+    YansWifiChannelHelper wifiChannel=YansWifiChannelHelper::Default();
+    yansPhy.SetChannel(wifiChannel.Create());
+  } else if (channelType == "grid") {
+   	// Same propagation as YansWifiChannelHelper::Default, with the range culled
+    gridChannel = CreateObject<GridSpectrumChannel>();
+    gridChannel->AddPropagationLossModel(CreateObject<LogDistancePropagationLossModel>());
+    gridChannel->SetPropagationDelayModel(CreateObject<ConstantSpeedPropagationDelayModel>());
+    spectrumPhy.SetChannel(gridChannel);
+  } else {
+    NS_FATAL_ERROR("Unknown channel " << channelType << ", use yans or grid");
+  }
+
+  if (errorModel == "table") {
+    std::vector<std::string> dsssModes = {"DsssRate1Mbps", "DsssRate2Mbps", "DsssRate5_5Mbps", "DsssRate11Mbps"};
+    double maxError = PerTableErrorModel::EnsureTable(perTable, CreateObject<YansErrorRateModel>(), dsssModes);
+    std::cout << "PER table " << perTable << ", largest error of the success rate: " << maxError << std::endl;
+    wifiPhy.SetErrorRateModel("ns3::PerTableErrorModel", "TableFile", StringValue(perTable));
+  } else if (errorModel != "analytic") {
+    NS_FATAL_ERROR("Unknown error model " << errorModel << ", use analytic or table");
+  }
 
   NetDeviceContainer backboneDevices = wifi.Install(wifiPhy, mac, backbone);
 
  	// We enable OLSR (which will be consulted at a higher priority than
- 	// the global routing) on the backbone ad hoc nodes
-  NS_LOG_INFO("Enabling OLSR routing on all backbone nodes");
+ 	// the global routing) on the backbone ad hoc nodes, unless the routes
+ 	// are computed from the positions, which only needs the static routing
   OlsrHelper olsr;
   Ipv4StaticRoutingHelper staticRouting;
 
   Ipv4ListRoutingHelper list;
   list.Add(staticRouting, 0);
-  list.Add(olsr, 10);
+  if (routing == "olsr") {
+    NS_LOG_INFO("Enabling OLSR routing on all backbone nodes");
+    list.Add(olsr, 10);
+  } else if (routing != "position") {
+    NS_FATAL_ERROR("Unknown routing " << routing << ", use olsr or position");
+  }
 
  	//
  	// Add the IPv4 protocol stack to the nodes in our container
@@ -126,36 +277,44 @@ void Experiment::Run(StringValue onTime, StringValue offTime, uint32_t nodes, ui
     "Pause", StringValue("ns3::ConstantRandomVariable[Constant=0.2]"));
   mobility.Install(backbone);
 
+  Ptr<PositionRouting> positionRouting;
+  if (routing == "position") {
+    double range = routingRange;
+    if (range <= 0) {
+     	// Where the default log distance loss of the channel leaves the
+     	// margin above the sensitivity of the PHY
+      Ptr<WifiPhy> phy = DynamicCast<WifiNetDevice>(backboneDevices.Get(0))->GetPhy();
+      range = PositionRouting::LogDistanceRange(phy->GetTxPowerStart(), phy->GetRxSensitivity() + linkMargin, 3, 46.6777);
+    }
+    NS_LOG_INFO("Computing position based routes with a range of " << range << " m");
+    positionRouting = Create<PositionRouting>(backbone, range);
+    positionRouting->Install(Seconds(routingCheckInterval));
+  }
+
  	//
  	// OnOff Application
  	//
 
-  uint32_t sourceOnOffNode = 0;
-  uint32_t sinkOnOffNode = nodes - 1;
   uint16_t appport = 5000;
- 	
-  Ptr<Node> appSourceOnOff = NodeList::GetNode(sourceOnOffNode);
- 	// We want the sink to be the last node created in the topology.
- 	//
-  Ptr<Node> appSinkOnOff = NodeList::GetNode(sinkOnOffNode);
- 	// Let's fetch the IP address of the last node, which is on Ipv4Interface 1
-  Ipv4Address remoteAddr = appSinkOnOff->GetObject<Ipv4> ()->GetAddress(1, 0).GetLocal();
 
-  OnOffHelper onoff("ns3::UdpSocketFactory", Address(InetSocketAddress(remoteAddr, appport)));
+  OnOffHelper onoff("ns3::UdpSocketFactory", Address());
   onoff.SetAttribute("OffTime", offTime);
   onoff.SetAttribute("OnTime", onTime);
   onoff.SetAttribute("MaxBytes", UintegerValue(10989173));
-  onoff.SetAttribute("DataRate", StringValue("5Mbps"));
+  DataRate sourceRate("5Mbps");
+  onoff.SetAttribute("DataRate", DataRateValue(sourceRate));
   onoff.SetAttribute("PacketSize", UintegerValue(packetSizeOnOff));
-  ApplicationContainer appsOnOff = onoff.Install(appSourceOnOff);
-  appsOnOff.Start(Seconds(3));
-  appsOnOff.Stop(Seconds(stopTime - 1));
-
- 	// Create a packet sink to receive these packets
-  PacketSinkHelper sinkOnOff("ns3::UdpSocketFactory", InetSocketAddress(Ipv4Address::GetAny(), appport));
-  appsOnOff = sinkOnOff.Install(appSinkOnOff);
-  appsOnOff.Start(Seconds(2));
-  Ptr<PacketSink> packetSinkServer = DynamicCast<PacketSink>(appsOnOff.Get(0));
+  // The sequence/timestamp header gives the delays to the flow statistics
+  // and to the flight recorder
+  onoff.SetAttribute("EnableSeqTsSizeHeader", BooleanValue(true));
+
+ 	// Draw the flows and install their sources, and a packet sink on each
+ 	// destination shared by all the flows that end there. The single pattern
+ 	// is the original flow from the first node to the last one.
+  Ptr<TrafficMatrix> matrix = Create<TrafficMatrix>(trafficPattern);
+  matrix->AssignStreams(100);
+  matrix->Generate(backbone, flows);
+  matrix->Install(onoff, appport, Seconds(3), Seconds(stopTime - 1), Seconds(2));
 
  	// Print node positions
   NS_LOG_UNCOND("Node Positions:");
@@ -171,47 +330,270 @@ void Experiment::Run(StringValue onTime, StringValue offTime, uint32_t nodes, ui
 
   NS_LOG_INFO("Configure Tracing.");
 
- 	//
- 	// Let's set up some ns-2-like ascii traces, using another helper class
- 	//
-  AsciiTraceHelper ascii;
-  Ptr<OutputStreamWrapper> stream = ascii.CreateFileStream("mixed-wireless.tr");
-  wifiPhy.EnableAsciiAll(stream);
-  internet.EnableAsciiIpv4All(stream);
+  AnimationInterface *anim = 0;
+  if (fullTrace) {
+   	//
+   	// Let's set up some ns-2-like ascii traces, using another helper class
+   	//
+    AsciiTraceHelper ascii;
+    Ptr<OutputStreamWrapper> stream = ascii.CreateFileStream("mixed-wireless.tr");
+    wifiPhy.EnableAsciiAll(stream);
+    internet.EnableAsciiIpv4All(stream);
 
- 	// pcap captures on the backbone wifi devices
-  wifiPhy.EnablePcap("wifi-adhoc", backboneDevices, false);
+   	// pcap captures on the backbone wifi devices
+    wifiPhy.EnablePcap("wifi-adhoc", backboneDevices, false);
 
-  AnimationInterface anim("wifi-adhoc.xml");
+    anim = new AnimationInterface("wifi-adhoc.xml");
+  }
+
+  Ptr<FlightRecorder> recorder;
+  bool delayTrigger = flightRecorder && delaySpike > 0;
+  if (flightRecorder) {
+    std::string captureFile = "wifi-adhoc-flight-" + std::to_string(runNumber) + ".pcapng";
+    uint32_t slots = captureSlots;
+    if (slots == 0) {
+     	// A device sees at most the frames of all the flows, or as many as the
+     	// PHY rate carries, each with its ACK
+      double framesPerSecond = std::min(sourceRate.GetBitRate() * matrix->GetNFlows(),
+        double(WifiMode(phyMode).GetDataRate(22))) / (8.0 * packetSizeOnOff) * 2;
+      slots = FlightRecorder::GetSlotsFor(framesPerSecond, Seconds(capturePre), Seconds(capturePost));
+    }
+    recorder = Create<FlightRecorder>(captureFile, snapLen, slots);
+    recorder->Install(backboneDevices);
+    recorder->SetWindow(Seconds(capturePre), Seconds(capturePost));
+    if (captureStart >= 0 && captureStop > captureStart) {
+      recorder->AddCaptureWindow(Seconds(captureStart), Seconds(captureStop));
+    }
+    if (throughputDrop > 0) {
+      recorder->MonitorThroughput(MakeCallback(&TrafficMatrix::GetTotalRx, matrix),
+        MakeBoundCallback(&SentBytes, matrix, packetSizeOnOff), Seconds(1), throughputDrop);
+    }
+    if (delayTrigger) {
+      recorder->MonitorDelay(delaySpike);
+      for (uint32_t s = 0; s < matrix->GetSinks().size(); s++) {
+        matrix->GetSinks()[s]->TraceConnectWithoutContext("RxWithSeqTsSize", MakeBoundCallback(&NotifySinkDelay, recorder));
+      }
+    }
+  }
 
  	//                                                                      	//
  	// Run simulation                                                       	//
  	//                                                                      	//
   NS_LOG_INFO("Run Simulation.");
 
- 	// Flow monitor
+ 	// Flow statistics
+  std::string flowStatsFile;
+  if (!flowStats.empty()) {
+    flowStatsFile = flowStats + "-" + std::to_string(runNumber) + (flowStatsBinary ? ".bin" : ".csv");
+  }
+  Ptr<FlowStatsExporter> exporter = Create<FlowStatsExporter>(flowStatsFile, flowStatsBinary);
+  exporter->SetTrackedFlows(FlowStatsExporter::ParseFlowList(trackFlows));
+  for (uint32_t f = 0; f < matrix->GetNFlows(); f++) {
+    exporter->AddFlow(matrix->GetSource(f), matrix->GetSink(f), matrix->GetSourceAddress(f));
+  }
+  exporter->Start(Seconds(flowStatsInterval));
+
   Ptr<FlowMonitor> flowMonitor;
   FlowMonitorHelper flowHelper;
-  flowMonitor = flowHelper.InstallAll();
+  if (flowMonitorXml) {
+    flowMonitor = flowHelper.InstallAll();
+  }
+
+  Ptr<SteadyStateMonitor> throughputMonitor;
+  if (steadyState) {
+    throughputMonitor = Create<SteadyStateMonitor>(Seconds(steadyWindow), steadyTolerance);
+    throughputMonitor->SetSource(MakeBoundCallback(&ReceivedMegabits, matrix), Callback<double>());
+    throughputMonitor->SetStopWhenSteady(steadyStop);
+    // The sources start at 3 s
+    throughputMonitor->Start(Seconds(3));
+  }
 
   Simulator::Stop(Seconds(stopTime));
+  ScenarioProfiler::Get().EndSetup();
   Simulator::Run();
-  Ptr<Ipv4FlowClassifier> classifier = DynamicCast<Ipv4FlowClassifier> (flowHelper.GetClassifier());
-  std::map<FlowId, FlowMonitor::FlowStats > stats = flowMonitor->GetFlowStats();
-  std::cout << std::endl << "***Flow monitor statistics ***" << std::endl;
-  std::cout << "  Tx Packets:   " << stats[1].txPackets << std::endl;
-  std::cout << "  Tx Bytes:   " << stats[1].txBytes << std::endl;
-  std::cout << "  Offered Load: " << stats[1].txBytes *8.0 / (stats[1].timeLastTxPacket.GetSeconds() - stats[1].timeFirstTxPacket.GetSeconds()) / 1000000 << " Mbps" << std::endl;
-  std::cout << "  Rx Packets:   " << stats[1].rxPackets << std::endl;
-  std::cout << "  Rx Bytes:   " << stats[1].rxBytes << std::endl;
-  std::cout << "  Throughput: " << stats[1].rxBytes *8.0 / (stats[1].timeLastRxPacket.GetSeconds() - stats[1].timeFirstRxPacket.GetSeconds()) / 1000000 << " Mbps" << std::endl;
-  std::cout << "  Mean delay:   " << stats[1].delaySum.GetSeconds() / stats[1].rxPackets << std::endl;
-  std::cout << "  Mean jitter:   " << stats[1].jitterSum.GetSeconds() / (stats[1].rxPackets - 1) << std::endl;
-  flowMonitor->SerializeToXmlFile("data.flowmon", true, true);
-  std::cout << "Number of OnOffPackets received: " << packetSinkServer->GetTotalRx() / packetSizeOnOff << std::endl;
-  std::cout << "% of OnOffPackets received: " << (100 * (packetSinkServer->GetTotalRx() / packetSizeOnOff) / stats[1].txPackets) << std::endl;
+  ScenarioProfiler::Get().EndRun();
+  if (recorder) {
+    recorder->Flush();
+    std::cout << "Flight recorder: " << recorder->GetTriggers().size() << " triggers, "
+              << recorder->GetWrittenFrames() << " frames written" << std::endl;
+    for (size_t t = 0; t < recorder->GetTriggers().size(); t++) {
+      std::cout << "  " << recorder->GetTriggers()[t].first.GetSeconds() << " s: " << recorder->GetTriggers()[t].second << std::endl;
+    }
+  }
+  exporter->Flush();
+  if (gridChannel) {
+    std::cout << "Grid channel: " << gridChannel->GetDeliveries() << " signals delivered, "
+              << gridChannel->GetCandidates() << " receivers examined" << std::endl;
+  }
+  if (positionRouting) {
+    std::cout << "Position routing: " << positionRouting->GetRecomputations() << " route updates, "
+              << positionRouting->GetRecomputedTrees() << " trees computed, "
+              << positionRouting->GetRewrittenTables() << " routing tables written" << std::endl;
+  }
+  if (flowMonitorXml) {
+    Ptr<Ipv4FlowClassifier> classifier = DynamicCast<Ipv4FlowClassifier> (flowHelper.GetClassifier());
+    std::map<FlowId, FlowMonitor::FlowStats > stats = flowMonitor->GetFlowStats();
+    std::cout << std::endl << "***Flow monitor statistics ***" << std::endl;
+    std::cout << "  Tx Packets:   " << stats[1].txPackets << std::endl;
+    std::cout << "  Tx Bytes:   " << stats[1].txBytes << std::endl;
+    std::cout << "  Offered Load: " << stats[1].txBytes *8.0 / (stats[1].timeLastTxPacket.GetSeconds() - stats[1].timeFirstTxPacket.GetSeconds()) / 1000000 << " Mbps" << std::endl;
+    std::cout << "  Rx Packets:   " << stats[1].rxPackets << std::endl;
+    std::cout << "  Rx Bytes:   " << stats[1].rxBytes << std::endl;
+    std::cout << "  Throughput: " << stats[1].rxBytes *8.0 / (stats[1].timeLastRxPacket.GetSeconds() - stats[1].timeFirstRxPacket.GetSeconds()) / 1000000 << " Mbps" << std::endl;
+    std::cout << "  Mean delay:   " << stats[1].delaySum.GetSeconds() / stats[1].rxPackets << std::endl;
+    std::cout << "  Mean jitter:   " << stats[1].jitterSum.GetSeconds() / (stats[1].rxPackets - 1) << std::endl;
+    flowMonitor->SerializeToXmlFile("data.flowmon", true, true);
+  } else if (const FlowAccumulator *flow = exporter->GetFlow(1)) {
+    // Application level statistics, the bytes don't include the UDP/IP headers
+    std::cout << std::endl << "***Flow statistics ***" << std::endl;
+    std::cout << "  Tx Packets:   " << flow->txPackets << std::endl;
+    std::cout << "  Tx Bytes:   " << flow->txBytes << std::endl;
+    std::cout << "  Offered Load: " << flow->GetOfferedLoad() / 1000000 << " Mbps" << std::endl;
+    std::cout << "  Rx Packets:   " << flow->rxPackets << std::endl;
+    std::cout << "  Rx Bytes:   " << flow->rxBytes << std::endl;
+    std::cout << "  Lost Packets:   " << flow->GetLostPackets() << std::endl;
+    std::cout << "  Throughput: " << flow->GetThroughput() / 1000000 << " Mbps" << std::endl;
+    std::cout << "  Mean delay:   " << flow->delayMean << std::endl;
+    std::cout << "  Mean jitter:   " << flow->GetMeanJitter() << std::endl;
+  }
+  if (matrix->GetNFlows() > 1) {
+    std::cout << std::endl << "***Traffic matrix (" << trafficPattern << ", " << matrix->GetNFlows() << " flows) ***" << std::endl;
+    for (uint32_t f = 0; f < matrix->GetNFlows(); f++) {
+      const FlowAccumulator *tracked = exporter->GetFlow(f + 1);
+      if (tracked) {
+        std::cout << "  Flow " << f + 1 << " (" << matrix->GetPair(f).first << " -> " << matrix->GetPair(f).second << "): "
+                  << tracked->GetThroughput() / 1000000 << " Mbps, " << tracked->rxPackets << "/" << tracked->txPackets
+                  << " packets, mean delay " << tracked->delayMean << std::endl;
+      }
+    }
+    std::cout << "  Aggregate throughput: " << AggregateThroughput(matrix) << " Mbps over "
+              << matrix->GetActiveTime().GetSeconds() << " s" << std::endl;
+  }
+  std::cout << "Number of OnOffPackets received: " << matrix->GetTotalRx() / packetSizeOnOff << std::endl;
+  if (matrix->GetTotalTxPackets() > 0) {
+    std::cout << "% of OnOffPackets received: " << (100 * (matrix->GetTotalRx() / packetSizeOnOff) / matrix->GetTotalTxPackets()) << std::endl;
+  }
+
+  RunMetrics metrics;
+  metrics.throughput = AggregateThroughput(matrix);
+  metrics.pdr = matrix->GetTotalTxPackets() > 0 ? double(matrix->GetTotalRx() / packetSizeOnOff) / matrix->GetTotalTxPackets() : 0;
+  double delaySum = 0;
+  uint64_t delayPackets = 0;
+  for (uint32_t f = 0; f < matrix->GetNFlows(); f++) {
+    const FlowAccumulator *tracked = exporter->GetFlow(f + 1);
+    if (tracked) {
+      delaySum += tracked->delayMean * tracked->rxPackets;
+      delayPackets += tracked->rxPackets;
+    }
+  }
+  metrics.delay = delayPackets > 0 ? delaySum / delayPackets : 0;
+  if (throughputMonitor) {
+    throughputMonitor->Finish();
+    std::cout << std::endl << "***Steady state: " << (throughputMonitor->IsSteady() ? "reached" : "not reached");
+    if (throughputMonitor->IsSteady()) {
+      std::cout << " at " << throughputMonitor->GetSteadyTime().GetSeconds() << " s";
+    }
+    std::cout << ", warm-up dropped until " << throughputMonitor->GetWarmupEnd().GetSeconds() << " s ***" << std::endl;
+    std::cout << "  Steady throughput: " << throughputMonitor->GetEstimate() << " +- " << throughputMonitor->GetHalfWidth() << " Mbps" << std::endl;
+    metrics.throughput = throughputMonitor->GetEstimate();
+  }
 
   Simulator::Destroy();
+  delete anim;
+  return metrics;
+}
+
+//
+// Run a traffic type once, or read its metrics from the result store
+//
+RunMetrics RunOnce(Experiment &experiment, StringValue onTime, StringValue offTime, uint32_t nodes, uint32_t stopTime, uint32_t packetSize, uint32_t radius) {
+  if (resultStore.empty()) {
+    return experiment.Run(onTime, offTime, nodes, stopTime, packetSize, radius);
+  }
+
+  // A stored run must not depend on the runs made before it in the process
+  RngSeedManager::ResetNextStreamIndex();
+  ConfigHash key;
+  key.Add("scenario", "wifi-adhoc")
+    .Add("build", ResultStore::GetBuild())
+    .Add("onTime", onTime.Get())
+    .Add("offTime", offTime.Get())
+    .Add("nodes", nodes)
+    .Add("stopTime", stopTime)
+    .Add("packetSize", packetSize)
+    .Add("radius", radius)
+    .Add("trafficPattern", trafficPattern)
+    .Add("flows", flows)
+    .Add("routing", routing)
+    .Add("routingRange", routingRange)
+    .Add("linkMargin", linkMargin)
+    .Add("routingCheckInterval", routingCheckInterval)
+    .Add("channel", channelType)
+    .Add("errorModel", errorModel)
+    .Add("trackFlows", trackFlows)
+    .Add("steadyState", steadyState)
+    .Add("steadyWindow", steadyWindow)
+    .Add("steadyTolerance", steadyTolerance)
+    .Add("steadyStop", steadyStop)
+    .Add("seed", RngSeedManager::GetSeed())
+    .Add("run", RngSeedManager::GetRun());
+  if (errorModel == "table") {
+    key.AddFile("perTable", perTable);
+  }
+  ResultStore store(resultStore);
+  std::map<std::string, double> values;
+  RunMetrics metrics;
+  if (!forceRun && store.Lookup(key, values)) {
+    metrics.throughput = values["throughput"];
+    metrics.pdr = values["pdr"];
+    metrics.delay = values["delay"];
+    std::cout << std::endl << "***Stored result " << store.GetFilename(key) << " ***" << std::endl;
+    std::cout << "  Throughput: " << metrics.throughput << " Mbps" << std::endl;
+    std::cout << "  PDR: " << metrics.pdr << std::endl;
+    std::cout << "  Mean delay: " << metrics.delay << " s" << std::endl;
+    return metrics;
+  }
+  metrics = experiment.Run(onTime, offTime, nodes, stopTime, packetSize, radius);
+  values["throughput"] = metrics.throughput;
+  values["pdr"] = metrics.pdr;
+  values["delay"] = metrics.delay;
+  store.Store(key, values);
+  return metrics;
+}
+
+//
+// Run a traffic type once, or as many times as the replication controller
+// asks for, and print the confidence intervals
+//
+void RunConfiguration(Experiment &experiment, StringValue onTime, StringValue offTime, uint32_t nodes, uint32_t stopTime, uint32_t packetSize, uint32_t radius) {
+  if (ciWidth <= 0) {
+    RunOnce(experiment, onTime, offTime, nodes, stopTime, packetSize, radius);
+    return;
+  }
+
+  ReplicationController controller(ciWidth, ciConfidence, minReplications, maxReplications);
+  controller.AddMetric("throughput");
+  controller.AddMetric("pdr");
+  controller.AddMetric("delay");
+  controller.SetTarget(ciMetric);
+  uint32_t firstRun = RngSeedManager::GetRun();
+  while (!controller.Done()) {
+    RngSeedManager::SetRun(firstRun + controller.GetRuns());
+    RunMetrics metrics = RunOnce(experiment, onTime, offTime, nodes, stopTime, packetSize, radius);
+    controller.Record("throughput", metrics.throughput);
+    controller.Record("pdr", metrics.pdr);
+    controller.Record("delay", metrics.delay);
+    controller.EndReplication();
+  }
+  RngSeedManager::SetRun(firstRun);
+
+  std::cout << std::endl << "***Replications: " << controller.GetRuns()
+            << (controller.Converged() ? "" : " (the requested interval was not reached)") << " ***" << std::endl;
+  for (uint32_t i = 0; i < controller.GetNMetrics(); i++) {
+    const ReplicationMetric &metric = controller.GetMetric(i);
+    std::cout << "  " << metric.name << ": " << metric.mean << " +- " << controller.GetHalfWidth(i)
+              << " (" << ciConfidence * 100 << "%)" << std::endl;
+  }
 }
 
 int main(int argc, char *argv[]) {
@@ -220,6 +602,8 @@ int main(int argc, char *argv[]) {
   uint32_t stopTime = 30;
   uint32_t packetSize = 1000;
   uint32_t radius = 10;
+  std::string profile = "";
+  std::string traffic = "all";
 
  	//
  	// For convenience, we add the local variables to the command line argument
@@ -231,6 +615,43 @@ int main(int argc, char *argv[]) {
   cmd.AddValue("stopTime", "Simulation stop time (seconds)", stopTime);
   cmd.AddValue("packetSize", "Packet size (bytes)", packetSize);
   cmd.AddValue("radius", "The radius of the area to simulate", radius);
+  cmd.AddValue("traffic", "Traffic to simulate: all, vod, calls or uniform", traffic);
+  cmd.AddValue("fullTrace", "Whether to write the ascii, pcap and NetAnim traces of the whole run", fullTrace);
+  cmd.AddValue("flightRecorder", "Whether to capture the frames around anomalies", flightRecorder);
+  cmd.AddValue("snapLen", "Bytes kept of each captured frame", snapLen);
+  cmd.AddValue("captureSlots", "Frames kept in memory for each device, 0 sizes them from the traffic and the capture window", captureSlots);
+  cmd.AddValue("capturePre", "Seconds of traffic written before a trigger", capturePre);
+  cmd.AddValue("capturePost", "Seconds of traffic written after a trigger", capturePost);
+  cmd.AddValue("captureStart", "Start of an explicit capture window (s), negative to disable it", captureStart);
+  cmd.AddValue("captureStop", "End of the explicit capture window (s)", captureStop);
+  cmd.AddValue("throughputDrop", "Trigger when the fraction of the sent bytes received in a second falls below this fraction of its average, 0 disables it", throughputDrop);
+  cmd.AddValue("delaySpike", "Trigger when a delay exceeds this multiple of the average delay, 0 disables it", delaySpike);
+  cmd.AddValue("trafficPattern", "How the flows are chosen: single, random, all-to-one or gravity", trafficPattern);
+  cmd.AddValue("flows", "Number of flows of the traffic matrix, 0 for every node in all-to-one", flows);
+  cmd.AddValue("channel", "Wi-Fi channel: yans, or grid to only deliver frames within range", channelType);
+  cmd.AddValue("errorModel", "Error model of the PHY: analytic, or table to look the error rates up", errorModel);
+  cmd.AddValue("perTable", "File of the PER table, generated if it doesn't exist", perTable);
+  cmd.AddValue("routing", "Routing of the ad-hoc network: olsr or position", routing);
+  cmd.AddValue("routingRange", "Link range (m) of the position routing, 0 to derive it from the PHY and the loss model", routingRange);
+  cmd.AddValue("linkMargin", "Margin (dB) above the sensitivity of the links of the position routing", linkMargin);
+  cmd.AddValue("routingCheckInterval", "Seconds between two checks of the positions by the position routing", routingCheckInterval);
+  cmd.AddValue("flowMonitor", "Whether to install FlowMonitor and write data.flowmon", flowMonitorXml);
+  cmd.AddValue("flowStats", "Prefix of the flow statistics time series, empty to disable it", flowStats);
+  cmd.AddValue("flowStatsBinary", "Whether to write the flow statistics as binary records instead of CSV", flowStatsBinary);
+  cmd.AddValue("flowStatsInterval", "Seconds between two flow statistics snapshots", flowStatsInterval);
+  cmd.AddValue("trackFlows", "Comma-separated ids of the flows to track, empty to track all", trackFlows);
+  cmd.AddValue("steadyState", "Whether to drop the warm-up and stop the run once the throughput is steady", steadyState);
+  cmd.AddValue("steadyWindow", "Width of the windows the throughput is sampled in (s)", steadyWindow);
+  cmd.AddValue("steadyTolerance", "Relative half width of the batch means interval of a steady throughput", steadyTolerance);
+  cmd.AddValue("steadyStop", "Whether to stop the run once the throughput is steady", steadyStop);
+  cmd.AddValue("ciWidth", "Relative half width of the confidence interval that stops the replications, 0 runs once", ciWidth);
+  cmd.AddValue("ciConfidence", "Confidence level of the interval", ciConfidence);
+  cmd.AddValue("ciMetric", "Metric whose interval stops the replications: throughput, pdr or delay", ciMetric);
+  cmd.AddValue("minReplications", "Replications made before checking the interval", minReplications);
+  cmd.AddValue("maxReplications", "Replications made at most", maxReplications);
+  cmd.AddValue("resultStore", "Directory of the results reused by the runs with the same configuration, empty to disable it", resultStore);
+  cmd.AddValue("forceRun", "Whether to simulate the runs the result store already holds, replacing their records", forceRun);
+  cmd.AddValue("profile", "Prefix of the JSON profile written after each run, empty to disable profiling", profile);
 
  	//
  	// The system global variables and the local values added to the argument
@@ -238,6 +659,10 @@ int main(int argc, char *argv[]) {
  	//
   cmd.Parse(argc, argv);
 
+  if (!profile.empty()) {
+    ScenarioProfiler::Get().Enable("wifi-adhoc", profile);
+  }
+
   if (stopTime < 10) {
     std::cout << "Use a simulation stop time >= 10 seconds" << std::endl;
     exit(1);
@@ -246,19 +671,26 @@ int main(int argc, char *argv[]) {
   Experiment experiment;
 
   // Based on this paper: http://www.scielo.org.co/pdf/dyna/v84n202/0012-7353-dyna-84-202-00055.pdf
-  NS_LOG_UNCOND("Traffic video on demand");
-  StringValue offTime("ns3::LogNormalRandomVariable[Mu=0.4026|Sigma=0.0352]");
   StringValue onTime("ns3::WeibullRandomVariable[Shape=2|Scale=10]");
-  experiment = Experiment();
-  experiment.Run(onTime, offTime, nodes, stopTime, packetSize, radius);
-
-  NS_LOG_UNCOND("Traffic calls");
-  offTime = StringValue("ns3::ExponentialRandomVariable[Mean=2.0|Bound=10]");
-  experiment = Experiment();
-  experiment.Run(onTime, offTime, nodes, stopTime, packetSize, radius);
-
-  NS_LOG_UNCOND("Traffic Uniform");
-  offTime = StringValue("ns3::UniformRandomVariable[Max=30|Min=0.1]");
-  experiment = Experiment();
-  experiment.Run(onTime, offTime, nodes, stopTime, packetSize, radius);
+  StringValue offTime;
+  if (traffic == "all" || traffic == "vod") {
+    NS_LOG_UNCOND("Traffic video on demand");
+    offTime = StringValue("ns3::LogNormalRandomVariable[Mu=0.4026|Sigma=0.0352]");
+    experiment = Experiment();
+    RunConfiguration(experiment, onTime, offTime, nodes, stopTime, packetSize, radius);
+  }
+
+  if (traffic == "all" || traffic == "calls") {
+    NS_LOG_UNCOND("Traffic calls");
+    offTime = StringValue("ns3::ExponentialRandomVariable[Mean=2.0|Bound=10]");
+    experiment = Experiment();
+    RunConfiguration(experiment, onTime, offTime, nodes, stopTime, packetSize, radius);
+  }
+
+  if (traffic == "all" || traffic == "uniform") {
+    NS_LOG_UNCOND("Traffic Uniform");
+    offTime = StringValue("ns3::UniformRandomVariable[Max=30|Min=0.1]");
+    experiment = Experiment();
+    RunConfiguration(experiment, onTime, offTime, nodes, stopTime, packetSize, radius);
+  }
 }
\ No newline at end of file